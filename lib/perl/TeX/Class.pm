@@ -66,6 +66,8 @@ use warnings;
 ##        :default<string_literal>
 ##
 ##    but the added flexibility is worth this small inconvenience.
+##
+## 7) Optional array-backed objects (see ARRAY-BACKED CLASSES below).
 
 ## NEW ATTRIBUTE TYPES
 ##
@@ -123,6 +125,8 @@ use overload;
 
 use Carp;
 
+use mro;
+
 use Scalar::Util;
 
 use constant CUSTOM_ACCESSOR => '*custom*';
@@ -137,6 +141,17 @@ BEGIN { *ID = \&Scalar::Util::refaddr; }
 
 my (%attribute, %cumulative, %anticumulative, %restricted, %private, %overload);
 
+## Constructors and destructors compiled by __compile_constructor()
+## and __compile_destructor(), by class.  Declaring an attribute or
+## wrapping a method invalidates them.
+
+my (%constructor_of, %destructor_of);
+
+## Packages that asked for array-backed objects, and the number of
+## slots used by each one, including those of its ancestors.
+
+my (%array_backed, %num_slots_of);
+
 my %attribute_by_name;
 my %is_one_of_us;
 
@@ -161,8 +176,19 @@ my @exported_extension_subs = qw(
 );
 
 sub import {
+    my $class = shift;
+    my @flags = @_;
+
     my $caller = caller;
 
+    for my $flag (@flags) {
+        if ($flag eq ':array_backed') {
+            $array_backed{$caller} = 1;
+        } else {
+            croak "Unknown $class import flag '$flag'";
+        }
+    }
+
     no strict 'refs';
 
     *{ "${caller}::ident" } = \&Scalar::Util::refaddr;
@@ -272,6 +298,7 @@ BEGIN {
     *_extract_incr     = _extractor_for_pair_named('incr');
     *_extract_decr     = _extractor_for_pair_named('decr');
     *_extract_trace    = _extractor_for_pair_named('trace');
+    *_extract_slot     = _extractor_for_pair_named('slot', 'raw');
 }
 
 ## This is more or less Class::Std's normal :ATTR
@@ -849,7 +876,7 @@ sub __declare_ARRAY {
                 my ($self, $new_val) = @_;
 
                 if (! eval { $new_val->isa($type) }) {
-                    croak "Incorrect value type in add_$adder";
+                    croak "Incorrect value type in $adder";
                 }
 
                 push @{ $referent->{ID($self)} }, $new_val;
@@ -941,7 +968,7 @@ sub __declare_HASH {
         };
     }
 
-    {
+    if ($gethash ne CUSTOM_ACCESSOR) {
         no strict 'refs';
 
         $spec->{gethash} = *{ "${package}::${gethash}" } = sub {
@@ -1023,6 +1050,277 @@ sub __declare_HASH {
     return $spec;
 }
 
+## ARRAY-BACKED CLASSES
+##
+## A package that says
+##
+##     use TeX::Class qw(:array_backed);
+##
+## gets objects that are blessed arrays instead of blessed scalars.
+## Its attributes are declared as usual, but instead of being stored
+## in the attribute hash (which stays empty), each one is kept in a
+## slot of the array.  The accessors are generated with the slot
+## number built in, so that, e.g., a getter is just
+##
+##     sub { return $_[0]->[N] }
+##
+## This saves both the hash entry per attribute per object and the
+## refaddr() call per access, and DESTROY has nothing to clean up.  It
+## is meant for the classes the interpreter creates by the million.
+##
+## Slots are allocated in declaration order, after those of any
+## array-backed ancestors, unless the declaration says where to put it
+## with :slot<>, which is evaluated in the declaring package, so that
+## the class can use the same constant to get at the attribute
+## directly:
+##
+##     use constant SLOT_TOKENS => 0;
+##
+##     my %tokens_of :ATTR(:slot<SLOT_TOKENS>);
+##
+##     ... $self->[SLOT_TOKENS] ...
+##
+## Ancestors that aren't array-backed keep their attributes in their
+## hashes as usual, since those are keyed by refaddr().  A class that
+## overloads @{} must access its slots under "no overloading '@{}'".
+##
+## :HASH attributes, :trace<> and :default_value<> aren't supported.
+
+sub __inherited_slots {
+    my $package = shift;
+
+    no strict 'refs';
+
+    my $num_slots = 0;
+
+    for my $parent ("${package}::ISA"->@*) {
+        my $inherited = $num_slots_of{$parent} // __inherited_slots($parent);
+
+        $num_slots = $inherited if $inherited > $num_slots;
+    }
+
+    return $num_slots;
+}
+
+sub __is_array_backed {
+    my $class = shift;
+
+    for my $base_class (_hierarchy_of($class)) {
+        return 1 if $array_backed{$base_class};
+    }
+
+    return;
+}
+
+## The source of the accessors generated by __declare_slot() can refer
+## to $parse_boolean.
+
+sub __compile_accessor {
+    my $source = shift;
+
+    my $parse_boolean = \&__parse_boolean;
+
+    return eval qq{ sub { no overloading; $source } };
+}
+
+sub __declare_slot {
+    my $package = shift;
+    my $kind    = shift;
+    my $spec    = shift;
+    my $config  = shift;
+
+    $kind = 'ATTR'    if $kind =~ m{\A ATTRS? \z}smx;
+    $kind = 'COUNTER' if $kind eq 'INT';
+
+    if ($kind eq 'HASH') {
+        croak "HASH attributes aren't supported by array-backed class $package";
+    }
+
+    if (_extract_trace($config) || __nonempty(_extract_default_val($config))) {
+        croak ":trace and :default_value aren't supported by array-backed class $package";
+    }
+
+    my $base = __inherited_slots($package);
+
+    my $slot = _extract_slot($config);
+
+    if (__nonempty($slot)) {
+        my $expr = $slot;
+
+        $slot = eval qq{ package $package; $expr };
+
+        if (! defined $slot || $slot !~ m{\A \d+ \z}smx || $slot < $base) {
+            croak "Invalid :slot<$expr> in $package";
+        }
+    } else {
+        $slot = $num_slots_of{$package} // $base;
+    }
+
+    if ($slot + 1 > ($num_slots_of{$package} // $base)) {
+        $num_slots_of{$package} = $slot + 1;
+    }
+
+    $spec->{slot} = $slot;
+
+    my $name = $spec->{name};
+    my $type = $spec->{type};
+
+    my $typed = $kind ne 'BOOLEAN' && $kind ne 'COUNTER' && __nonempty($type);
+
+    my $slot_ref = "\$_[0]->[$slot]";
+
+    my $install = sub {
+        my $method = shift;
+        my $field  = shift;
+        my $body   = shift;
+
+        return if __empty($method) || $method eq CUSTOM_ACCESSOR;
+
+        my $code = __compile_accessor($body);
+
+        croak "Can't generate $method for $package: $@" unless defined $code;
+
+        no strict 'refs';
+        no warnings 'redefine';
+
+        *{ "${package}::${method}" } = $code;
+
+        $spec->{$field} = $code if defined $field;
+
+        return;
+    };
+
+    my $check_type = sub {
+        my $method = shift;
+        my $value  = shift;
+
+        return "" unless $typed;
+
+        return qq{croak "Incorrect value type in $method" }
+             . qq{if defined($value) && ! eval { $value->isa('$type') };};
+    };
+
+    my $check_index = sub {
+        my $method = shift;
+
+        return qq{croak "Invalid index in ${package}::${method}" unless defined \$_[1];};
+    };
+
+    if ($kind eq 'ATTR') {
+        my $getter = _extract_get($config) || _extract_name($config);
+        my $setter = _extract_set($config) || _extract_name($config);
+
+        if (__nonempty($getter) && $getter ne CUSTOM_ACCESSOR) {
+            $install->("get_$getter", getter => qq{return $slot_ref;});
+        }
+
+        if (__nonempty($setter) && $setter ne CUSTOM_ACCESSOR) {
+            $install->("set_$setter", setter => join "\n",
+                       qq{croak "Missing new value in 'set_$setter'" unless \@_ == 2;},
+                       $check_type->("set_$setter", '$_[1]'),
+                       qq{$slot_ref = \$_[1];},
+                       qq{return;});
+        }
+
+        if (__nonempty(_extract_name($config))) {
+            $install->("delete_$name", delete => qq{my \$value = $slot_ref; $slot_ref = undef; return \$value;});
+        }
+    }
+    elsif ($kind eq 'BOOLEAN') {
+        my $getter = _extract_get($config);
+
+        if (__empty($getter)) {
+            $getter = $name =~ m{\A (do|is|has|needs|no|use|uses|allow)_}smx ? $name : "is_$name";
+        }
+
+        my $setter = _extract_set($config) || "set_$name";
+
+        $install->($getter, getter => qq{return $slot_ref;});
+
+        $install->($setter, setter => join "\n",
+                   qq{croak "Missing new value in '$setter'" unless \@_ == 2;},
+                   qq{$slot_ref = \$parse_boolean->(\$_[1]) ? 1 : 0;},
+                   qq{return;});
+    }
+    elsif ($kind eq 'COUNTER') {
+        my $getter = _extract_get($config)  || $name;
+        my $setter = _extract_set($config)  || "set_$name";
+
+        $install->($getter, getter => qq{return $slot_ref;});
+
+        $install->($setter, setter => join "\n",
+                   qq{croak "Missing new value in '$setter'" unless \@_ == 2;},
+                   qq{croak "Illegal non-integral value '\$_[1]' in $setter"},
+                   qq{    if \$_[1] !~ m{\\A \\s* -? \\s* \\d+ \\z}smx;},
+                   qq{$slot_ref = \$_[1];},
+                   qq{return;});
+
+        $install->(_extract_incr($config) || "incr_$name", incr => qq{return $slot_ref = $slot_ref + 1;});
+        $install->(_extract_decr($config) || "decr_$name", decr => qq{return $slot_ref = $slot_ref - 1;});
+    }
+    elsif ($kind eq 'ARRAY') {
+        my $getter  = _extract_get($config)     || "get_$name";
+        my $setter  = _extract_set($config)     || "set_$name";
+        my $push    = _extract_push($config)    || "push_$name";
+        my $unshift = _extract_unshift($config) || "unshift_$name";
+        my $adder   = _extract_add($config)     || "add_$name";
+
+        my $check_all = sub {
+            my $method = shift;
+
+            return "" unless $typed;
+
+            return join " ", 'for my $new_val (@_[1..$#_]) {',
+                             $check_type->($method, '$new_val'),
+                             '}';
+        };
+
+        $install->(_extract_getarray($config) || "get_${name}s", getarray
+                   => qq{return protect_array_attribute($slot_ref);});
+
+        $install->(_extract_numarray($config) || "num_${name}s", getsize
+                   => qq{return scalar \@{ $slot_ref };});
+
+        $install->(_extract_deleter($config) || "delete_${name}s", deletearray
+                   => qq{my \@values = \@{ $slot_ref }; $slot_ref = []; return \@values;});
+
+        $install->($getter, getter => join "\n",
+                   $check_index->($getter),
+                   qq{return $slot_ref\->[\$_[1]];});
+
+        $install->($setter, undef, join "\n",
+                   qq{croak "Missing index and/or new value in '$setter'" unless \@_ == 3;},
+                   $check_type->($setter, '$_[2]'),
+                   $check_index->($setter),
+                   qq{$slot_ref\->[\$_[1]] = \$_[2];},
+                   qq{return;});
+
+        $install->(_extract_pop($config) || "pop_$name", pop
+                   => qq{return pop \@{ $slot_ref };});
+
+        $install->(_extract_shift($config) || "shift_$name", shift
+                   => qq{return shift \@{ $slot_ref };});
+
+        $install->($push, pusher => join "\n",
+                   $check_all->($push),
+                   qq{my \$self = shift; push \@{ \$self->[$slot] }, \@_;},
+                   qq{return;});
+
+        $install->($unshift, unshift => join "\n",
+                   $check_all->($unshift),
+                   qq{my \$self = shift; unshift \@{ \$self->[$slot] }, \@_;},
+                   qq{return;});
+
+        $install->($adder, adder => join "\n",
+                   qq{croak "Missing new value in '$adder'" unless \@_ == 2;},
+                   $check_type->($adder, '$_[1]'),
+                   qq{push \@{ $slot_ref }, \$_[1];},
+                   qq{return;});
+    }
+
+    return;
+}
+
 sub MODIFY_HASH_ATTRIBUTES {
     my ($package, $referent, @attrs) = @_;
 
@@ -1055,9 +1353,16 @@ sub MODIFY_HASH_ATTRIBUTES {
             next;
         }
 
+        if ($array_backed{$package}) {
+            __declare_slot($package, $type, $spec, $config);
+        }
+
         undef $attr;
 
         push @{ $attribute{$package} }, $spec;
+
+        %constructor_of = ();
+        %destructor_of  = ();
     }
 
     return grep { defined } @attrs;
@@ -1174,6 +1479,16 @@ sub _DUMP {
         my $attr_list_ref = $attribute{$package};
 
         for my $attr_ref ( $attr_list_ref->@* ) {
+            if (defined(my $slot = $attr_ref->{slot})) {
+                next unless $self->isa($package);
+
+                no overloading;
+
+                $dump{$package}{$attr_ref->{name}} = $self->[$slot];
+
+                next;
+            }
+
             next unless exists $attr_ref->{ref}{$id};
 
             $dump{$package}{$attr_ref->{name}} = $attr_ref->{ref}{$id};
@@ -1525,6 +1840,9 @@ sub initialize {
     %anticumulative = ();
     %overload       = ();
 
+    %constructor_of = ();
+    %destructor_of  = ();
+
     return;
 }
 
@@ -1547,153 +1865,295 @@ my sub _mislabelled {
     return "(Did you mislabel one of the args you passed: $arglist?)\n";
 }
 
+## new() used to walk the class hierarchy, copy the argument hash for
+## each class in it, and eval each :default<> specifier afresh, every
+## time an object was created.  Instead, the first time a class is
+## instantiated, we generate a constructor that does the same thing
+## with all of that worked out in advance: the hierarchy is flattened,
+## each attribute's initialization is a line of straight-line code,
+## and the defaults are compiled once.
+##
+## The argument hash is only copied for classes that have BUILD() or
+## START() methods (which are free to modify their copy) or whose name
+## is a key of it.
+##
+## The generated constructor captures the class's hierarchy and its
+## BUILD() and START() methods (and DESTROY() likewise captures the
+## DEMOLISH() methods).  So that defining or redefining one of those
+## methods or changing an @ISA later still takes effect, the compiled
+## code records the sum of mro::get_pkg_gen() over the hierarchy, which
+## goes up whenever a sub is defined in one of its packages or its @ISA
+## changes, and is recompiled if that sum has changed.
+
+my sub __generation {
+    my $generation = 0;
+
+    $generation += mro::get_pkg_gen($_) for @_;
+
+    return $generation;
+}
+
+## Called by a stale constructor in place of itself.
+
+sub __recompile_constructor {
+    my $class = $_[0];
+
+    %_hierarchy_of         = ();
+    %_reverse_hierarchy_of = ();
+
+    delete $constructor_of{$class};
+    delete $destructor_of{$class};
+
+    goto &new;
+}
+
 sub new {
-    my ($class, $arg_ref) = @_;
+    my $class = $_[0];
 
     # Ensure run-time (and mod_perl) setup is done
     TeX::Class::initialize();
 
+    my $constructor = $constructor_of{$class} //= __compile_constructor($class);
+
+    goto &{ $constructor };
+}
+
+## Default values that are literal numbers and strings are copied into
+## the constructor, as are the values of constants.  Everything else is
+## compiled into a closure in the package the attribute was declared
+## in.
+
+my sub __compile_default {
+    my $attr_ref = shift;
+
+    my $default = $attr_ref->{default};
+    my $package = $attr_ref->{package};
+
+    if ($default =~ m{\A \s* (?: -? \d+ (?: \. \d+ )?
+                               | '[^'\\]*'
+                               | "[^"\\\$\@]*" ) \s* \z}smx) {
+        return (literal => $default);
+    }
+
+    if ($default =~ m{\A \s* ( \w+ (?: :: \w+ )* ) \s* \z}smx) {
+        my $name = $1 =~ m{::} ? $1 : "${package}::$1";
+
+        no strict 'refs';
+
+        if (defined &{ $name } && defined prototype($name) && prototype($name) eq '') {
+            my $value = &{ $name }();
+
+            return (value => $value) unless ref $value;
+        }
+    }
+
+    my $code = eval qq{
+        { package $package;
+          sub { return $default; };
+        }
+    };
+
+    if (! defined $code) {
+        (my $error = $@) =~ s/ at .* line .*\n?$//;
+
+        my $name = $attr_ref->{name};
+
+        $code = sub {
+            croak "Can't interpret default value for $name: '$error'";
+        };
+    }
+
+    return (code => $code);
+}
+
+sub __supply_default {
+    my $type = shift;
+
+    if ($is_one_of_us{$type}) {
+        return $type->new({ SUPPLY_DEFAULTS => 1 });
+    }
+
+    if (eval { $type->can("new") }) {
+        return $type->new();
+    }
+
+    return;
+}
+
+sub __code_ref {
+    return defined $_[0] ? \&{ $_[0] } : undef;
+}
+
+sub __compile_constructor {
+    my $class = shift;
+
     no strict 'refs';
 
     croak "Can't find class $class" if ! keys "${class}::"->%*;
 
-    croak "Argument to $class->new() must be hash reference"
-        if @_ > 1 && ref $arg_ref ne 'HASH';
+    ## Everything the generated code refers to is in @env.
 
-    my $new_obj = bless \my($anon_scalar), $class;
-    my $new_obj_id = ID($new_obj);
+    my @env;
 
-    my (@missing_inits, @suss_keys);
+    my $capture = sub {
+        push @env, $_[0];
 
-    $arg_ref ||= {};
+        return "\$env[$#env]";
+    };
 
-    my $supply_defaults = $arg_ref->{SUPPLY_DEFAULTS};
+    my $array_backed = __is_array_backed($class);
 
-    my %arg_set;
+    my @hierarchy = _reverse_hierarchy_of($class);
 
-  BUILD:
-    for my $base_class (_reverse_hierarchy_of($class)) {
-        my $arg_set = $arg_set{$base_class}
-                    = { %{ $arg_ref }, %{ $arg_ref->{$base_class} || {} } };
+    my @code = (q{my ($class, $arg_ref) = @_;},
+                q{croak "Argument to $class->new() must be hash reference"},
+                q{    if @_ > 1 && ref $arg_ref ne 'HASH';},
+                q{$arg_ref ||= {};},
+                $array_backed ? (q{no overloading;},
+                                 q{my $new_obj = bless [], $class;})
+                              : q{my $new_obj = bless \my($anon_scalar), $class;},
+                q{my $id = ID($new_obj);},
+                q{my $supply_defaults = $arg_ref->{SUPPLY_DEFAULTS};},
+        );
 
-        # Apply BUILD() methods...
-        {
-            no warnings 'once';
+    my @start;
 
-            if (my $build_ref = *{ "${base_class}::BUILD" }{CODE}) {
-                $build_ref->($new_obj, $new_obj_id, $arg_set);
-            }
+    ## Until a BUILD() method or a setter has run, none of the
+    ## attributes can have been initialized yet.
+
+    my $maybe_defined = 0;
+
+    my $n = 0;
+
+    for my $base_class (@hierarchy) {
+        my $attributes = $attribute{$base_class} || [];
+
+        no warnings 'once';
+
+        my $build_ref = *{ "${base_class}::BUILD" }{CODE};
+        my $start_ref = *{ "${base_class}::START" }{CODE};
+
+        next unless defined $build_ref || defined $start_ref || @{ $attributes };
+
+        my $args = "\$args_" . $n++;
+
+        my $key = $capture->($base_class);
+
+        my $own_args = "{ %{ \$arg_ref }, %{ \$arg_ref->{$key} || {} } }";
+
+        if (defined $build_ref || defined $start_ref) {
+            push @code, "my $args = $own_args;";
+        } else {
+            push @code, "my $args = exists \$arg_ref->{$key} ? $own_args : \$arg_ref;";
         }
 
-        # Apply init_arg and default for attributes still undefined...
+        if (defined $build_ref) {
+            push @code, $capture->($build_ref) . "->(\$new_obj, \$id, $args);";
 
-      INITIALIZATION:
-        for my $attr_ref ( $attribute{$base_class}->@* ) {
-            next INITIALIZATION if defined $attr_ref->{ref}{$new_obj_id};
+            $maybe_defined = 1;
+        }
 
-            my $lvalue = \$attr_ref->{ref}{$new_obj_id};
+        if (defined $start_ref) {
+            push @start, $capture->($start_ref) . "->(\$new_obj, \$id, $args);";
+        }
 
-            if (defined $attr_ref->{init_arg}
-                && exists $arg_set->{$attr_ref->{init_arg}}) {
+        for my $attr_ref (@{ $attributes }) {
+            my $lvalue = defined $attr_ref->{slot} ? "\$new_obj->[$attr_ref->{slot}]"
+                       : $capture->($attr_ref->{ref}) . "->{\$id}";
 
-                my $init_arg = $attr_ref->{init_arg};
-                my $init_val = $arg_set->{$init_arg};
+            ## Some specs hold the glob the accessor was installed in.
+            ## Copies of a glob bump its package's generation when
+            ## they're freed, so only keep references to the code.
 
-                if (defined(my $setter= $attr_ref->{setter})) {
-                    $new_obj->$setter($init_val);
-                } elsif (defined(my $adder= $attr_ref->{adder})) {
-                    $new_obj->$adder($init_val);
-                } else {
-                    $lvalue->$* = $init_val;
-                }
+            my $setter = __code_ref($attr_ref->{setter});
+            my $adder  = __code_ref($attr_ref->{adder});
 
-                next INITIALIZATION;
-            }
-            elsif (defined $attr_ref->{default}) {
-                # Or use default value specified...
+            my $assign = sub {
+                my $value = shift;
 
-                my $package = $attr_ref->{package};
+                return defined $setter ? $capture->($setter) . "->(\$new_obj, $value);"
+                                       : "$lvalue = $value;";
+            };
 
-                my $default_value = eval qq{
-                    { package $package;
-                      return $attr_ref->{default};
-                    }
-                };
+            my @cases;
 
-                ## If I've thought this through correctly, there's no
-                ## need for the above to fail unless the :default
-                ## specifier really is bogus. [dmj]
+            if (defined(my $init_arg = $attr_ref->{init_arg})) {
+                my $init_val = "$args\->{" . $capture->($init_arg) . "}";
 
-                if ($@) {
-                    (my $error = $@) =~ s/ at .* line .*\n?$//;
+                my $init = defined $setter ? $capture->($setter) . "->(\$new_obj, $init_val);"
+                         : defined $adder  ? $capture->($adder)  . "->(\$new_obj, $init_val);"
+                         :                   "$lvalue = $init_val;";
 
-                    croak "Can't interpret default value for $attr_ref->{name}: '$error'";
-                }
+                push @cases, [ "exists $init_val", $init ];
+            }
 
-                my $setter = $attr_ref->{setter};
+            if (defined $attr_ref->{default}) {
+                my ($kind, $default) = __compile_default($attr_ref);
 
-                if (defined $setter) {
-                    $new_obj->$setter($default_value);
-                } else {
-                    $lvalue->$* = $default_value;
-                }
+                my $value = $kind eq 'literal' ? $default
+                          : $kind eq 'value'   ? $capture->($default)
+                          :                      $capture->($default) . "->()";
 
-                next INITIALIZATION;
+                push @cases, [ undef, $assign->($value) ];
             }
             elsif ($attr_ref->{is_array}) {
-                $lvalue->$* = [];
-
-                next INITIALIZATION;
+                push @cases, [ undef, "$lvalue = [];" ];
             }
             elsif ($attr_ref->{is_hash}) {
-                $lvalue->$* = {};
-
-                next INITIALIZATION;
+                push @cases, [ undef, "$lvalue = {};" ];
             }
-            else {
-                my $type = $attr_ref->{type};
-
-                if ($supply_defaults && __nonempty($type)) {
-                    if ($is_one_of_us{$type}) {
-                        $lvalue->$* = $type->new({ SUPPLY_DEFAULTS => 1 });
-                    } elsif (eval { $type->can("new") }) {
-                        $lvalue->$* = $type->new();
-                    }
-                }
+            elsif (__nonempty(my $type = $attr_ref->{type})) {
+                push @cases, [ "\$supply_defaults",
+                               "$lvalue = __supply_default(" . $capture->($type) . ");" ];
             }
 
-            ## I hate having to specify a :default just because I used
-            ## a :name.  Or because I specified an :init_arg, for that
-            ## matter.
-
-            # if (defined $attr_ref->{init_arg}) {
-            #     # Record missing init_arg...
-            #     push @missing_inits,
-            #          "Missing initializer label for $base_class: "
-            #          . "'$attr_ref->{init_arg}'.\n";
-            #     push @suss_keys, keys %{$arg_set};
-            # }
-        }
-    }
+            next unless @cases;
 
-    croak @missing_inits, _mislabelled(@suss_keys),
-          'Fatal error in constructor call'
-                if @missing_inits;
+            my @branches;
 
-    # START methods run after all BUILD methods complete...
-    for my $base_class (_reverse_hierarchy_of($class)) {
-        my $arg_set = $arg_set{$base_class};
+            for my $case (@cases) {
+                my ($condition, $statement) = @{ $case };
+
+                my $keyword = ! @branches          ? "if"
+                            : defined $condition   ? "} elsif"
+                            :                        "} else";
+
+                if (! defined $condition) {
+                    push @branches, @branches ? ("} else {", $statement)
+                                              : ($statement);
+
+                    last;
+                }
 
-        # Apply START() methods...
-        {
-            no warnings 'once';
-            if (my $init_ref = *{ "${base_class}::START" }{CODE}) {
-                $init_ref->($new_obj, $new_obj_id, $arg_set);
+                push @branches, "$keyword ($condition) {", $statement;
             }
+
+            push @branches, "}" if $branches[0] =~ m{\A if \b}smx;
+
+            if ($maybe_defined) {
+                push @code, "if (! defined $lvalue) {", @branches, "}";
+            } else {
+                push @code, @branches;
+            }
+
+            $maybe_defined = 1 if defined $setter || defined $adder;
         }
     }
 
-    return $new_obj;
+    push @code, @start, q{return $new_obj;};
+
+    my $generation = join " + ", map { "mro::get_pkg_gen('$_')" } @hierarchy;
+
+    unshift @code, "goto &TeX::Class::__recompile_constructor",
+                   "    if $generation != " . __generation(@hierarchy) . ";";
+
+    my $source = join "\n", "sub {", @code, "}";
+
+    my $constructor = eval $source;
+
+    croak "Can't compile constructor for $class: $@" unless defined $constructor;
+
+    return $constructor;
 }
 
 ## This needs to be thoroughly tested.
@@ -1705,7 +2165,8 @@ sub clone {
 
     my $orig_id = ID($orig);
 
-    my $clone = bless \my($anon_scalar), $class;
+    my $clone = __is_array_backed($class) ? bless [], $class
+              :                               bless \my($anon_scalar), $class;
     my $clone_id = ID($clone);
 
     no strict 'refs';
@@ -1719,6 +2180,13 @@ sub clone {
 
       INITIALIZATION:
         for my $attr_ref ( $attribute{$base_class}->@* ) {
+            if (defined(my $slot = $attr_ref->{slot})) {
+                no overloading;
+
+                ($clone->[$slot]) = __clone_values($orig->[$slot]);
+
+                next;
+            }
 
             my $rvalue = $attr_ref->{ref}{$orig_id};
 
@@ -1962,25 +2430,73 @@ sub hash_keys {
     croak "Unknown field '$field_name' in keys for $class";
 }
 
-sub DESTROY {
-    my ($self) = @_;
+## Like the constructors, destructors are compiled once per class: a
+## DEMOLISH() call and a delete for each attribute hash of each class
+## in the hierarchy.  DESTROY() passes them the object's ID as $_[1].
 
-    my $id = ID($self);
+sub __compile_destructor {
+    my $class = shift;
 
-    push @_, $id;
+    my @env;
 
-    for my $base_class (_hierarchy_of(ref $_[0])) {
+    my $capture = sub {
+        push @env, $_[0];
+
+        return "\$env[$#env]";
+    };
+
+    my @hierarchy = _hierarchy_of($class);
+
+    my @code;
+
+    for my $base_class (@hierarchy) {
         no strict 'refs';
         no warnings 'once';
 
-        if (my $demolish_ref = *{ "${base_class}::DEMOLISH" }{CODE}) {
-            &{ $demolish_ref };
+        if (defined(my $demolish_ref = *{ "${base_class}::DEMOLISH" }{CODE})) {
+            push @code, $capture->($demolish_ref) . "->(\@_);";
         }
 
-        for my $attr_ref ( $attribute{$base_class}->@* ) {
-            delete $attr_ref->{ref}{$id};
+        for my $attr_ref (($attribute{$base_class} || [])->@*) {
+            next if defined $attr_ref->{slot};
+
+            push @code, "delete " . $capture->($attr_ref->{ref}) . "->{\$_[1]};";
         }
     }
+
+    my $generation = join " + ", map { "mro::get_pkg_gen('$_')" } @hierarchy;
+
+    unshift @code, "goto &TeX::Class::__recompile_destructor",
+                   "    if $generation != " . __generation(@hierarchy) . ";";
+
+    my $source = join "\n", "sub {", @code, "return;", "}";
+
+    my $destructor = eval $source;
+
+    croak "Can't compile destructor for $class: $@" unless defined $destructor;
+
+    return $destructor;
+}
+
+sub __recompile_destructor {
+    my $class = ref $_[0];
+
+    %_hierarchy_of         = ();
+    %_reverse_hierarchy_of = ();
+
+    delete $constructor_of{$class};
+
+    my $destructor = $destructor_of{$class} = __compile_destructor($class);
+
+    goto &{ $destructor };
+}
+
+sub DESTROY {
+    push @_, ID($_[0]);
+
+    my $destructor = $destructor_of{ref $_[0]} //= __compile_destructor(ref $_[0]);
+
+    goto &{ $destructor };
 }
 
 sub AUTOLOAD {
@@ -185,6 +185,36 @@ my %NODE_PARAMS = (
 
 install node_params => \%NODE_PARAMS;
 
+## Node types.  The first fourteen are the type codes from tex.web;
+## the rest are texml's own.  See TeX::Node::AbstractNode::node_type().
+
+my %NODE_TYPES = (
+    hlist_node                    =>  0,
+    vlist_node                    =>  1,
+    rule_node                     =>  2,
+    ins_node                      =>  3,
+    mark_node                     =>  4,
+    adjust_node                   =>  5,
+    ligature_node                 =>  6,
+    disc_node                     =>  7,
+    whatsit_node                  =>  8,
+    math_node                     =>  9,
+    glue_node                     => 10,
+    kern_node                     => 11,
+    penalty_node                  => 12,
+    unset_node                    => 13,
+    ##
+    char_node                     => 16,
+    unicode_string_node           => 17,
+    xml_node                      => 18,
+    u_template_node               => 19,
+    file_node                     => 20, # open, write and close whatsits
+    language_node                 => 21,
+    token_node                    => 22, # a TeX::Token in a node list
+);
+
+install node_types => \%NODE_TYPES;
+
 ######################################################################
 ##                                                                  ##
 ##                          COMMAND CODES                           ##
@@ -318,6 +348,7 @@ install scanner_statuses => \%SCANNER_STATUSES;
 ## This should really be called token_list_types.
 
 my %TOKEN_TYPES = (
+    parameter          =>  0,
     u_template         =>  1,
     v_template         =>  2,
     backed_up          =>  3,
@@ -0,0 +1,465 @@
+package TeX::FMT::Snapshot;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use strict;
+use warnings;
+
+use version; our $VERSION = qv '1.0.0';
+
+## A TeX::FMT::Snapshot is the part of a format file that
+## TeX::Interpreter::undump_eqtb() cares about, decoded once and
+## stored in a form that can be read back without walking mem.
+##
+## Everything except the control sequences is kept in a handful of
+## small "regions" (arrays of plain Perl data).  The control sequences
+## are kept as a single string (the blob) containing one packed
+## meaning record per csname, plus an index giving the offset and
+## length of each record, in eqtb order.  The interpreter can either
+## decode the whole blob at startup or, in lazy mode, decode records
+## the first time a csname is looked up.
+##
+## Token lists are packed as a sequence of (catcode, datum) pairs; see
+## pack_token_list() and unpack_token_list().
+##
+## Snapshots are cached in files named after the format and keyed by
+## the MD5 checksum of the .fmt file, the snapshot format version and
+## the version of texml itself, so a rebuilt format or a new texml
+## simply produces a new snapshot.
+
+use Carp;
+
+use Digest::MD5;
+
+use Encode qw(encode_utf8);
+
+use File::Basename;
+use File::Path qw(make_path);
+use File::Spec::Functions qw(catdir catfile tmpdir);
+use File::Temp;
+
+use Storable qw(nfreeze thaw);
+
+use TeX::Token qw(:catcodes :factories);
+
+use TeXML::CFG;
+
+use base qw(Exporter);
+
+our %EXPORT_TAGS = (codec => [ qw(pack_token_list unpack_token_list) ],
+                    files => [ qw(write_cache_file read_cache_file) ]);
+
+our @EXPORT_OK = ( @{ $EXPORT_TAGS{codec} }, @{ $EXPORT_TAGS{files} } );
+
+our @EXPORT = ();
+
+use TeX::Class;
+
+use constant SNAPSHOT_MAGIC => "TeXML format snapshot\n";
+
+my %key_of      :ATTR(:name<key>);
+my %fmt_file_of :ATTR(:name<fmt_file>);
+
+my %regions_of :ATTR(:name<regions>); # region name => [ entries ]
+
+my %blob_of  :ATTR(:name<blob> :default<"">);
+my %index_of :ATTR(:name<index>);   # csname, offset, length, ...
+
+## Built on demand from the index for lazy lookups.
+
+my %offsets_of :ATTR(:name<offsets>);
+
+my $CFG = TeXML::CFG->get_cfg();
+
+######################################################################
+##                                                                  ##
+##                           CONSTRUCTOR                            ##
+##                                                                  ##
+######################################################################
+
+sub START {
+    my ($self, $ident, $arg_ref) = @_;
+
+    $regions_of{$ident} //= {};
+    $index_of{$ident}   //= [];
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                           TOKEN LISTS                            ##
+##                                                                  ##
+######################################################################
+
+## Each argument is a [ catcode, datum ] pair.
+
+sub pack_token_list {
+    return pack "(C n/a*)*", map { ($_->[0], encode_utf8($_->[1])) } @_;
+}
+
+sub unpack_token_list( $ ) {
+    my $packed = shift;
+
+    my @fields = unpack "(C n/a*)*", $packed;
+
+    my @tokens;
+
+    while (my ($catcode, $datum) = splice @fields, 0, 2) {
+        utf8::decode($datum);
+
+        if ($catcode == CATCODE_CSNAME) {
+            push @tokens, make_csname_token($datum);
+        } elsif ($catcode == CATCODE_PARAM_REF) {
+            push @tokens, make_param_ref_token($datum);
+        } else {
+            push @tokens, make_character_token($datum, $catcode);
+        }
+    }
+
+    return @tokens;
+}
+
+######################################################################
+##                                                                  ##
+##                             REGIONS                              ##
+##                                                                  ##
+######################################################################
+
+sub add_to_region {
+    my $self = shift;
+
+    my $region = shift;
+
+    push @{ $regions_of{ident $self}->{$region} }, [ @_ ];
+
+    return;
+}
+
+sub get_region_entries {
+    my $self = shift;
+
+    my $region = shift;
+
+    return @{ $regions_of{ident $self}->{$region} || [] };
+}
+
+######################################################################
+##                                                                  ##
+##                        CONTROL SEQUENCES                         ##
+##                                                                  ##
+######################################################################
+
+sub add_csname {
+    my $self = shift;
+
+    my $csname = shift;
+    my $record = shift;
+
+    my $ident = ident $self;
+
+    push @{ $index_of{$ident} }, $csname, length($blob_of{$ident}), length($record);
+
+    $blob_of{$ident} .= $record;
+
+    return;
+}
+
+sub num_csnames {
+    my $self = shift;
+
+    return @{ $index_of{ident $self} } / 3;
+}
+
+## Calls $callback->($csname, $record) for every csname, in eqtb order.
+
+sub for_each_csname {
+    my $self = shift;
+
+    my $callback = shift;
+
+    my $ident = ident $self;
+
+    my $index = $index_of{$ident};
+    my $blob  = \$blob_of{$ident};
+
+    for (my $i = 0; $i < @{ $index }; $i += 3) {
+        my ($csname, $offset, $length) = @{ $index }[$i .. $i + 2];
+
+        $callback->($csname, substr(${ $blob }, $offset, $length));
+    }
+
+    return;
+}
+
+sub has_csname {
+    my $self = shift;
+
+    my $csname = shift;
+
+    return exists $self->__offsets()->{$csname};
+}
+
+sub get_csname_record {
+    my $self = shift;
+
+    my $csname = shift;
+
+    my $entry = $self->__offsets()->{$csname};
+
+    return unless defined $entry;
+
+    return substr($blob_of{ident $self}, $entry->[0], $entry->[1]);
+}
+
+## Returns the record for $csname and forgets it, so that each record
+## is decoded at most once.
+
+sub take_csname_record {
+    my $self = shift;
+
+    my $csname = shift;
+
+    my $entry = delete $self->__offsets()->{$csname};
+
+    return unless defined $entry;
+
+    return substr($blob_of{ident $self}, $entry->[0], $entry->[1]);
+}
+
+sub __offsets {
+    my $self = shift;
+
+    my $ident = ident $self;
+
+    return $offsets_of{$ident} if defined $offsets_of{$ident};
+
+    my %offsets;
+
+    my $index = $index_of{$ident};
+
+    for (my $i = 0; $i < @{ $index }; $i += 3) {
+        $offsets{ $index->[$i] } = [ $index->[$i + 1], $index->[$i + 2] ];
+    }
+
+    return $offsets_of{$ident} = \%offsets;
+}
+
+######################################################################
+##                                                                  ##
+##                              CACHE                               ##
+##                                                                  ##
+######################################################################
+
+## One of "eager", "lazy" or "off".
+
+sub mode {
+    my $class = shift;
+
+    my $mode = $CFG->val(__PACKAGE__, 'mode', 'eager');
+
+    return $mode =~ m{\A (?:eager|lazy|off) \z}smx ? $mode : 'eager';
+}
+
+sub cache_dir {
+    my $class = shift;
+
+    my $dir = $CFG->val(__PACKAGE__, 'cache_dir');
+
+    return $dir if defined $dir && $dir =~ /\S/;
+
+    if (defined $ENV{XDG_CACHE_HOME} && $ENV{XDG_CACHE_HOME} =~ /\S/) {
+        return catdir($ENV{XDG_CACHE_HOME}, "texml");
+    }
+
+    if (defined $ENV{HOME} && -d $ENV{HOME}) {
+        return catdir($ENV{HOME}, ".cache", "texml");
+    }
+
+    return catdir(tmpdir(), "texml-$<");
+}
+
+## The texml version is the $VERSION of the main program (bin/texml),
+## if it has one.
+
+sub __texml_version {
+    my $version = $main::VERSION;
+
+    return "unknown" unless defined $version;
+
+    return $version =~ /\A[\d.]+\z/ ? $version : sprintf("%vd", $version);
+}
+
+sub cache_key {
+    my $class = shift;
+
+    my $fmt_file = shift;
+
+    open(my $fh, "<:raw", $fmt_file) or return;
+
+    my $checksum = Digest::MD5->new()->addfile($fh)->hexdigest();
+
+    close($fh);
+
+    return join ":", $checksum, $VERSION, __texml_version();
+}
+
+sub cache_file {
+    my $class = shift;
+
+    my $fmt_file = shift;
+    my $key      = shift;
+
+    my $name = fileparse($fmt_file, qr{\.fmt});
+
+    my $digest = Digest::MD5::md5_hex($key);
+
+    return catfile($class->cache_dir(), "$name-$digest.snap");
+}
+
+######################################################################
+##                                                                  ##
+##                               I/O                                ##
+##                                                                  ##
+######################################################################
+
+## Cache files (snapshots here, and the package data recordings in
+## TeX::Interpreter::PackageData) start with a line identifying what
+## they hold.  write_cache_file() writes $magic followed by @data to a
+## temporary file and renames it into place so that a concurrent run
+## never sees a partial file; it dies on failure.
+
+sub write_cache_file {
+    my $file  = shift;
+    my $magic = shift;
+
+    make_path(dirname($file));
+
+    my $tmp = File::Temp->new(DIR => dirname($file), UNLINK => 0);
+
+    binmode($tmp, ":raw");
+
+    print { $tmp } $magic, @_;
+
+    close($tmp) or croak "Can't write $tmp: $!";
+
+    chmod(0666 & ~umask(), $tmp->filename());
+
+    rename($tmp->filename(), $file) or do {
+        unlink $tmp->filename();
+
+        croak "Can't rename $tmp to $file: $!";
+    };
+
+    return;
+}
+
+## Returns what follows $magic in $file, or undef if the file can't be
+## read or doesn't start with $magic.  If $mmap is true, the file is
+## read through the :mmap layer, which avoids copying it through stdio
+## buffers.
+
+sub read_cache_file {
+    my $file  = shift;
+    my $magic = shift;
+    my $mmap  = shift;
+
+    my $layers = $mmap ? "<:raw:mmap" : "<:raw";
+
+    open(my $fh, $layers, $file) or return;
+
+    my $data = do { local $/; <$fh> };
+
+    close($fh);
+
+    return unless defined $data;
+
+    my $magic_len = length($magic);
+
+    return unless substr($data, 0, $magic_len) eq $magic;
+
+    return substr($data, $magic_len);
+}
+
+## The file consists of SNAPSHOT_MAGIC, a length-prefixed Storable
+## image of everything except the blob, and then the blob itself.
+
+sub save {
+    my $self = shift;
+
+    my $file = shift;
+
+    my $ident = ident $self;
+
+    my $head = nfreeze({ key      => $key_of{$ident},
+                         fmt_file => $fmt_file_of{$ident},
+                         regions  => $regions_of{$ident},
+                         index    => $index_of{$ident},
+                       });
+
+    write_cache_file($file, SNAPSHOT_MAGIC, pack("N/a*", $head), $blob_of{$ident});
+
+    return;
+}
+
+## Returns undef unless $file holds a snapshot for $key.  $mmap is
+## passed on to read_cache_file(); the records are left undecoded
+## until the interpreter asks for them either way.
+
+sub load {
+    my $class = shift;
+
+    my $file = shift;
+    my $key  = shift;
+    my $mmap = shift;
+
+    my $data = read_cache_file($file, SNAPSHOT_MAGIC, $mmap);
+
+    return unless defined $data;
+
+    my $head_len = unpack("N", substr($data, 0, 4));
+
+    my $head = eval { thaw(substr($data, 4, $head_len)) };
+
+    return unless ref($head) eq 'HASH';
+
+    return unless defined $head->{key} && $head->{key} eq $key;
+
+    return $class->new({ key      => $head->{key},
+                         fmt_file => $head->{fmt_file},
+                         regions  => $head->{regions},
+                         index    => $head->{index},
+                         blob     => substr($data, 4 + $head_len),
+                       });
+}
+
+1;
+
+__END__
@@ -74,14 +74,18 @@ use Carp;
 
 use TeX::Class;
 
+use Digest::MD5;
+
 use Fcntl qw(:seek);
 
 use File::Basename;
 use File::Spec::Functions;
 
+use mro ();
+
 use List::Util qw(none uniq);
 
-use Scalar::Util qw(blessed);
+use Scalar::Util qw(blessed refaddr weaken);
 
 use TeX::Utils::SVG;
 use TeX::Utils::Misc;
@@ -89,12 +93,18 @@ use TeX::Utils::Misc;
 use TeX::Arithmetic qw(:arithmetic :string);
 
 use TeX::FMT::File;
+use TeX::FMT::Snapshot qw(:codec);
 
-use TeX::KPSE qw(kpse_lookup);
+use TeX::KPSE qw(kpse_lookup kpse_tex_file_names);
 
 use TeX::Utils;
 use TeX::Node::Utils qw(nodes_to_string);
 
+use TeX::Output::XML::PrettyPrinter;
+
+use TeX::Interpreter::PackageData;
+use TeX::Interpreter::Profiler;
+
 use TeX::Constants qw(carriage_return
                       null_code
                       var_code
@@ -219,6 +229,44 @@ my %cur_page_of :ARRAY(:name<cur_page>);
 
 my %debug_of :BOOLEAN(:name<debug> :default<0>);
 
+## If a TeX::Interpreter::Profiler is installed, get_x_token() and
+## main_control() report every control sequence they expand or execute
+## to it.  When it isn't, the only cost is a hash lookup per command.
+
+my %profiler_of :ATTR(:name<profiler>);
+
+## If memoize_fragments is set, convert_fragment() and
+## convert_token_list() remember what they produced and hand back a
+## copy the next time they see the same input in the same state.  See
+## ALTERNATE ENTRY POINTS for the details.
+##
+## catcode_state identifies the contents of the lexer's catcode cache:
+## every uncache_catcode() and reset_catcode_cache() moves it to a new,
+## never before used value (last_catcode_state).  side_effects counts
+## everything that can be observed outside of a conversion: global
+## assignments, \aftergroup, \write and \openout, anything written to
+## the terminal or the log file, and running Perl code (see
+## note_perl_command()).
+##
+## While a conversion is being memoized, fragment_reads collects the
+## EQVTs it looks at and the control sequences and active characters
+## it finds undefined.
+
+my %memoize_fragments_of :BOOLEAN(:name<memoize_fragments> :default<false>);
+
+my %catcode_state_of      :COUNTER(:name<catcode_state> :default<0>);
+my %last_catcode_state_of :COUNTER(:name<last_catcode_state> :default<0>);
+
+my %fragment_reads_of :ATTR(:name<fragment_reads>);
+
+my %side_effects_of :COUNTER(:name<side_effects> :default<0>);
+
+## While read_package_data() is interpreting a __DATA__ section for
+## the first time, package_data is the TeX::Interpreter::PackageData
+## that records what it does.
+
+my %package_data_of :ATTR(:name<package_data>);
+
 my %nofiles_of :BOOLEAN(:name<nofiles> :get<nofiles> :default<false>);
 
 my %unicode_input_of :BOOLEAN(:name<unicode_input> :default<false>);
@@ -250,6 +298,8 @@ sub START {
 
     $tex->init_prim();
 
+    $tex->__install_parameter_accessors();
+
     $tex->set_encoding("OT1", MODIFIER_GLOBAL);
 
     return;
@@ -389,9 +439,7 @@ sub input_ln {
 
     $tex->set_context_line($line);
 
-    my @chars = split //, $line;
-
-    $tex->push_char(@chars);
+    $tex->load_line_buffer($line);
 
     return;
 }
@@ -409,9 +457,7 @@ sub pseudo_input_ln {
 
     $tex->set_context_line($line);
 
-    my @chars = split //, $line;
-
-    $tex->push_char(@chars);
+    $tex->load_line_buffer($line);
 
     my $suppress_eol = 0;
 
@@ -523,6 +569,8 @@ sub incr_file_offset {
 sub wterm {
     my $tex = shift;
 
+    $side_effects_of{ident $tex}++;
+
     print { term_out } @_;
 
     return;
@@ -531,6 +579,8 @@ sub wterm {
 sub wterm_ln {
     my $tex = shift;
 
+    $side_effects_of{ident $tex}++;
+
     print { term_out } @_, "\n";
 
     return;
@@ -547,6 +597,8 @@ sub wterm_cr {
 sub wlog {
     my $tex = shift;
 
+    $side_effects_of{ident $tex}++;
+
     my $fh = $tex->get_log_file();
 
     print { $fh } @_;
@@ -557,6 +609,8 @@ sub wlog {
 sub wlog_ln {
     my $tex = shift;
 
+    $side_effects_of{ident $tex}++;
+
     my $fh = $tex->get_log_file();
 
     print { $fh } @_, "\n";
@@ -577,6 +631,12 @@ sub print_ln {
 
     my $selector = $tex->selector();
 
+    if ($selector > no_print && $selector < pseudo) {
+        if (defined(my $package_data = $package_data_of{ident $tex})) {
+            $package_data->note_printed($selector, undef);
+        }
+    }
+
     if ($selector < no_print) {
         print { $tex->get_write_file($selector) } "\n";
     } elsif ( $selector == term_and_log ) {
@@ -626,6 +686,12 @@ sub print_char {
 
     my $char_length = length($char_string);
 
+    if ($selector > no_print && $selector < pseudo) {
+        if (defined(my $package_data = $package_data_of{ident $tex})) {
+            $package_data->note_printed($selector, $char);
+        }
+    }
+
     if ($selector < no_print) {
         print { $tex->get_write_file($selector) } $char_string;
     } elsif ( $selector == term_and_log) {
@@ -867,6 +933,10 @@ sub error {
         $tex->set_history(error_message_issued);
     }
 
+    if (defined(my $package_data = $package_data_of{ident $tex})) {
+        $package_data->note_opaque("error");
+    }
+
     $tex->print_char(".");
 
     $tex->show_context();
@@ -1508,11 +1578,37 @@ sub is_whitespace { ## TBD:
 
 ## Region 1a: active characters
 
-my %active_chars_of :HASH(:name<active_char>);
+my %active_chars_of :HASH(:name<active_char> :get<*custom*>);
+
+sub get_active_char {
+    my $tex = shift;
+
+    my $char = shift;
+
+    my $ident = ident $tex;
+
+    my $eqvt = $active_chars_of{$ident}->{$char};
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_read(active => $char, $eqvt);
+    }
+
+    if (defined(my $reads = $fragment_reads_of{$ident})) {
+        __note_fragment_read($reads, active => $char, $eqvt);
+    }
+
+    return $eqvt;
+}
 
 ## Region 1b + Region 2: single- and multiple-character control sequences
 
-my %csnames_of :HASH(:name<csname>);
+my %csnames_of :HASH(:name<csname> :get<*custom*> :gethash<*custom*>);
+
+## When a format snapshot is loaded in lazy mode, control sequences
+## that haven't been looked up yet live here (see load_fmt_file()).
+## get_csnames() installs them all before returning %csnames_of.
+
+my %lazy_csnames_of :ATTR(:name<lazy_csnames>);
 
 my %text_fonts_of :ARRAY(:name<text_font>); # cf. font_id_base
 my %math_fonts_of :ARRAY(:name<math_font>); # cf. math_font_base
@@ -1547,6 +1643,19 @@ my %tc_codes_of            :HASH(:name<tc_code>);
 
 my %node_registers_of      :HASH(:name<node_registers>);
 
+## The lexer looks up the catcode of every input character, so it
+## keeps its own copy of the catcodes it has seen: a byte vector for
+## code points below 256 (CATCODE_UNCACHED meaning "not known yet")
+## and a hash for the rest.  %catcode_slots_of maps the eqtb slots of
+## the cached catcodes back to their code points so that unsave() can
+## tell when a catcode is restored.  See lexer_catcode().
+
+use constant CATCODE_UNCACHED => 0xFF;
+
+my %catcode_vector_of :ATTR(:name<catcode_vector>);
+my %wide_catcodes_of  :HASH(:name<wide_catcode>);
+my %catcode_slots_of  :HASH(:name<catcode_slot>);
+
 my %token_parameters_of :HASH(:name<token_parameter>);
 
 ## Region 5: Integer parameters
@@ -1578,25 +1687,116 @@ use constant FROZEN_DONT_EXPAND_TOKEN
 use constant FROZEN_CR_TOKEN
     => make_csname_token("cr");
 
+## The kind of a meaning says how get_x_token(), main_control() and
+## friends should treat it.  It's worked out once, when the meaning is
+## stored in an EQVT, so that they can dispatch on an integer instead
+## of trying one isa() after another.
+
+use constant {
+    KIND_UNDEFINED  => 0, # undef, or something that isn't a command
+    KIND_MACRO      => 1, # TeX::Primitive::Macro
+    KIND_EXPANDABLE => 2, # any other TeX::Command::Expandable
+    KIND_PREFIXED   => 3, # TeX::Command::Prefixed
+    KIND_EXECUTABLE => 4, # any other TeX::Command
+    KIND_CODE       => 5, # a CODE ref
+    KIND_TOKEN      => 6, # a TeX::Token, e.g., after \let\foo=a
+};
+
+sub meaning_kind {
+    my $meaning = shift;
+
+    return KIND_UNDEFINED unless defined $meaning;
+
+    return ref($meaning) eq 'CODE' ? KIND_CODE : KIND_UNDEFINED
+        unless blessed($meaning);
+
+    return KIND_MACRO      if $meaning->isa("TeX::Primitive::Macro");
+    return KIND_EXPANDABLE if $meaning->isa("TeX::Command::Expandable");
+    return KIND_PREFIXED   if $meaning->isa("TeX::Command::Prefixed");
+    return KIND_EXECUTABLE if $meaning->isa("TeX::Command");
+    return KIND_TOKEN      if $meaning->isa("TeX::Token");
+
+    return KIND_UNDEFINED;
+}
+
+## eq_define() makes a new EQVT for every assignment, so EQVTs and
+## EQVT::Data are blessed arrays rather than TeX::Class objects.  They
+## support the same accessors.  An EQVT also caches the kind of its
+## equiv (see meaning_kind()).
+##
+## An EQVT is stale while it isn't the current value of its eqtb
+## entry: eq_define() marks the EQVT it replaces as stale and unsave()
+## swaps the flag between the EQVT it removes and the one it restores.
+## The fragment cache uses this to tell whether the values a
+## conversion read are still in force.
+
 package TeX::Interpreter::EQVT {
-    use TeX::Class;
+    use Scalar::Util qw(refaddr);
+
+    use constant {
+        EQVT_EQUIV => 0,
+        EQVT_LEVEL => 1,
+        EQVT_KIND  => 2,
+        EQVT_STALE => 3,
+    };
 
-    my %level_of :COUNTER(:name<level>);
-    my %equiv_of :ATTR(:name<equiv>);
+    use overload
+        q{""}    => \&to_string,
+        q{bool}  => sub { 1 },
+        fallback => 1;
 
-    sub to_string :STRINGIFY {
+    sub new {
+        my $class   = shift;
+        my $arg_ref = shift;
+
+        my $equiv = $arg_ref->{equiv};
+
+        return bless [ $equiv,
+                       $arg_ref->{level} // 0,
+                       TeX::Interpreter::meaning_kind($equiv) ], $class;
+    }
+
+    sub get_equiv { return $_[0]->[EQVT_EQUIV] }
+    sub level     { return $_[0]->[EQVT_LEVEL] }
+    sub kind      { return $_[0]->[EQVT_KIND] }
+
+    sub set_equiv {
+        $_[0]->[EQVT_EQUIV] = $_[1];
+        $_[0]->[EQVT_KIND]  = TeX::Interpreter::meaning_kind($_[1]);
+
+        return;
+    }
+
+    sub set_level { $_[0]->[EQVT_LEVEL] = $_[1]; return }
+
+    sub is_stale  { return $_[0]->[EQVT_STALE] }
+    sub set_stale { $_[0]->[EQVT_STALE] = $_[1]; return }
+
+    sub to_string {
         my $tex = shift;
 
-        return sprintf "EQVT(level=%d, equiv=%s; ident=%s)", $tex->level(), $tex->get_equiv(), ident($tex);
+        return sprintf "EQVT(level=%d, equiv=%s; ident=%s)", $tex->level(), $tex->get_equiv(), refaddr($tex);
     }
 }
 
 package TeX::Interpreter::EQVT::Data {
-    use TeX::Class;
+    use overload
+        q{""}    => \&to_string,
+        q{bool}  => sub { 1 },
+        fallback => 1;
 
-    my %value_of :ATTR(:name<value>);
+    sub new {
+        my $class   = shift;
+        my $arg_ref = shift;
 
-    sub to_string :STRINGIFY {
+        return bless [ $arg_ref->{value} ], $class;
+    }
+
+    sub get_value { return $_[0]->[0] }
+
+    sub set_value { $_[0]->[0] = $_[1]; return }
+
+    sub to_string {
         my $tex = shift;
 
         return sprintf "EQVT::Data(value=%s)", $tex->get_value();
@@ -1628,6 +1828,8 @@ my sub make_eqvt {
 sub init_eqtb {
     my $tex = shift;
 
+    $tex->reset_catcode_cache();
+
     $tex->__init_eqtb_region_1_2();
     $tex->__init_eqtb_region_3();
     $tex->__init_eqtb_region_4();
@@ -2497,63 +2699,100 @@ sub primitive {
 ##                                                                  ##
 ######################################################################
 
-# Most elements of the save_stack are instances of SaveRecord, but
-# hbox, vbox, and scan_spec() put other values on it, so we can't put
-# a :type specifier here.  (We could, of course, move those uses to a
-# different stack.
+## The save stack is kept as four parallel arrays rather than as an
+## array of objects, since new_save_level() and eq_save() push an
+## entry for every group and every local assignment:
+##
+##     save_type  : restore_old_value, restore_zero, insert_token,
+##                  level_boundary, close_tag or SAVED_VALUE
+##     save_level : the level of the saved eqvt (restore_old_value) or
+##                  the enclosing group code (level_boundary)
+##     save_index : the eqvt_ptr, the token (insert_token), the qName
+##                  (close_tag) or the previous boundary
+##                  (level_boundary)
+##     save_value : the saved eqvt (restore_old_value) or the line
+##                  number (level_boundary)
+##
+## hbox, vbox and scan_spec() also use the stack to hold plain values,
+## which push_save_stack() stores as SAVED_VALUE entries.
+
+use constant SAVED_VALUE => -1;
 
-my %save_stack_of :ARRAY(:name<save_stack> :push<__push_save_stack> :pop<__pop_save_stack>);
+my %save_type_of  :ARRAY(:name<save_type>);
+my %save_level_of :ARRAY(:name<save_level>);
+my %save_index_of :ARRAY(:name<save_index>);
+my %save_value_of :ARRAY(:name<save_value>);
 
 my %cur_level_of     :COUNTER(:name<cur_level>);
 my %cur_group_of     :COUNTER(:name<cur_group>);
 my %cur_boundary_of  :COUNTER(:name<cur_boundary>);
 
-package TeX::Interpreter::SaveRecord {
-    use TeX::Class;
+my sub save_entry_string {
+    my ($type, $level, $index, $value) = @_;
+
+    if ($type == SAVED_VALUE) {
+        return $value // "";
+    } elsif ($type == restore_old_value) {
+        return "{ restore_old_value: level = $level }";
+    } elsif ($type == restore_zero) {
+        return "{ restore_zero }";
+    } elsif ($type == insert_token) {
+        return "{ insert_token: $index }";
+    } elsif ($type == close_tag) {
+        return "{ close_tag: $index }";
+    } elsif ($type == level_boundary) {
+        return sprintf("{ level_boundary: group = %s, prev_boundary = %d }",
+                       group_type($level), $index);
+    } else {
+        return "{ SaveRecord: unknown type $type }";
+    }
+}
 
-    use TeX::Constants qw(:save_stack_codes group_type);
+sub push_save_entry {
+    my $tex = shift;
 
-    my %type_of  :ATTR(:name<type>);
-    my %level_of :ATTR(:name<level>);
-    my %index_of :ATTR(:name<index>);
-    my %line_of  :ATTR(:name<line> :default<-1>);
+    my ($type, $level, $index, $value) = @_;
 
-    my %saved_eqvt_of :ATTR(:name<saved_eqvt>);
+    my $ident = ident $tex;
 
-    sub to_string :STRINGIFY {
-        my $self = shift;
+    push @{ $save_type_of{$ident}  }, $type;
+    push @{ $save_level_of{$ident} }, $level;
+    push @{ $save_index_of{$ident} }, $index;
+    push @{ $save_value_of{$ident} }, $value;
 
-        my $type  = $self->get_type();
-        my $level = $self->get_level();
-        my $index = $self->get_index();
-
-        if ($type == restore_old_value) {
-            return "{ restore_old_value: level = $level }";
-        } elsif ($type == restore_zero) {
-            return "{ restore_zero }";
-        } elsif ($type == insert_token) {
-            return "{ insert_token: $index }";
-        } elsif ($type == close_tag) {
-            return "{ close_tag: $index }";
-        } elsif ($type == level_boundary) {
-            return sprintf("{ level_boundary: group = %s, prev_boundary = %d }",
-                           group_type($level), $index);
-        } else {
-            return "{ SaveRecord: unknown type $type }";
-        }
+    if ($tex->tracing_groups() > 1) {
+        my $save_ptr = $tex->save_ptr();
+
+        $tex->DEBUG("push_save_stack:");
+        $tex->DEBUG("  save_stack($save_ptr) = " . save_entry_string(@_));
     }
+
+    return;
 }
 
-my sub new_save_record {
-    my $data = shift;
+## Returns ($type, $level, $index, $value), or an empty list if the
+## save stack is empty.
 
-    return TeX::Interpreter::SaveRecord->new($data);
-}
+sub pop_save_entry {
+    my $tex = shift;
 
-my sub is_save_record {
-    my $obj = shift;
+    my $ident = ident $tex;
+
+    my $save_ptr = $tex->save_ptr();
+
+    return if $save_ptr < 0;
+
+    my @entry = (pop @{ $save_type_of{$ident}  },
+                 pop @{ $save_level_of{$ident} },
+                 pop @{ $save_index_of{$ident} },
+                 pop @{ $save_value_of{$ident} });
+
+    if ($tex->tracing_groups() > 1) {
+        $tex->DEBUG("pop_save_stack:");
+        $tex->DEBUG("  save_stack($save_ptr) = " . save_entry_string(@entry));
+    }
 
-    return blessed $obj && $obj->isa("TeX::Interpreter::SaveRecord");
+    return @entry;
 }
 
 sub push_save_stack {
@@ -2561,16 +2800,7 @@ sub push_save_stack {
 
     my $value = shift;
 
-    $tex->__push_save_stack($value);
-
-    if ($tex->tracing_groups() > 1) {
-        my $save_ptr = $tex->save_ptr();
-
-        $value = $value->to_string() if is_save_record($value);
-
-        $tex->DEBUG("push_save_stack:");
-        $tex->DEBUG("  save_stack($save_ptr) = $value");
-    }
+    $tex->push_save_entry(SAVED_VALUE, level_zero, undef, $value);
 
     return;
 }
@@ -2578,15 +2808,12 @@ sub push_save_stack {
 sub pop_save_stack {
     my $tex = shift;
 
-    my $save_ptr = $tex->save_ptr();
-
-    my $value = $tex->__pop_save_stack();
+    my ($type, undef, undef, $value) = $tex->pop_save_entry();
 
-    if ($tex->tracing_groups() > 1) {
-        my $string = is_save_record($value) ? $value->to_string() : $value;
+    return unless defined $type;
 
-        $tex->DEBUG("pop_save_stack:");
-        $tex->DEBUG("  save_stack($save_ptr) = $string");
+    if ($type != SAVED_VALUE) {
+        $tex->confusion("pop_save_stack");
     }
 
     return $value;
@@ -2605,9 +2832,9 @@ sub init_save_stack {
 sub save_ptr {
     my $tex = shift;
 
-    my $save_stack = $save_stack_of{ident $tex};
+    my $save_types = $save_type_of{ident $tex};
 
-    return scalar @{ $save_stack } - 1;
+    return scalar @{ $save_types } - 1;
 }
 
 sub new_save_level {
@@ -2624,12 +2851,10 @@ sub new_save_level {
 
     my $line_no = $tex->input_line_no();
 
-    my $save_record = new_save_record({ type  => level_boundary,
-                                        level => $tex->cur_group(),
-                                        index => $tex->cur_boundary(),
-                                        line  => $line_no });
-
-    $tex->push_save_stack($save_record);
+    $tex->push_save_entry(level_boundary,
+                          $tex->cur_group(),
+                          $tex->cur_boundary(),
+                          $line_no);
 
     my $save_ptr = $tex->save_ptr();
 
@@ -2646,7 +2871,7 @@ sub new_save_level {
     if ($tex->tracing_groups() > 1) {
         $tex->DEBUG("Updating save_stack:");
 
-        # $tex->DEBUG(" *save_stack($save_ptr) = " . $save_record->to_string());
+        # $tex->DEBUG(" *save_stack($save_ptr) = " . save_entry_string(...));
 
         $tex->DEBUG("  cur_level = " . $tex->cur_level());
         $tex->DEBUG("  cur_group = " . group_type($tex->cur_group()));
@@ -2739,18 +2964,12 @@ sub eq_save {
 
     my $eqvt_level = $eqvt->level();
 
-    my $save_record = new_save_record({ type  => restore_old_value,
-                                        level => $eqvt_level,
-                                        index => $eqvt_ptr });
-
     if ($eqvt_level == level_zero) {
-        $save_record->set_type(restore_zero);
+        $tex->push_save_entry(restore_zero, $eqvt_level, $eqvt_ptr, undef);
     } else {
-        $save_record->set_saved_eqvt($eqvt);
+        $tex->push_save_entry(restore_old_value, $eqvt_level, $eqvt_ptr, $eqvt);
     }
 
-    $tex->push_save_stack($save_record);
-
     return;
 }
 
@@ -2772,6 +2991,16 @@ sub eq_define {
 
     my $level = $global ? level_one : $tex->cur_level();
 
+    my $ident = ident $tex;
+
+    $side_effects_of{$ident}++ if $global;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        if ($package_data->is_lasting($tex, $global)) {
+            $tex->__record_assignment($package_data, $eqvt_ptr, $equiv, $modifier);
+        }
+    }
+
     my $eqvt = $$eqvt_ptr;
 
     ## Is this strictly accurate if we're not defining a control
@@ -2789,6 +3018,8 @@ sub eq_define {
         $tex->eq_save($eqvt_ptr);
     }
 
+    $eqvt->set_stale(1);
+
     $$eqvt_ptr = make_eqvt($equiv, $level);
 
     return;
@@ -2833,11 +3064,17 @@ sub save_for_after {
 
     my $token = shift;
 
-    my $save_record = new_save_record({ type  => insert_token,
-                                        level => level_zero,
-                                        index => $token });
+    my $ident = ident $tex;
+
+    $side_effects_of{$ident}++;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        if ($package_data->is_lasting($tex)) {
+            $package_data->note_opaque("\\aftergroup");
+        }
+    }
 
-    $tex->push_save_stack($save_record);
+    $tex->push_save_entry(insert_token, level_zero, $token, undef);
 
     return;
 }
@@ -2847,18 +3084,14 @@ sub save_for_after {
 ## effectively turns them into a first-in, first-out queue.  When we
 ## close XML tags, they need to be processed in LIFO order, so we
 ## can't use the \aftergroup mechanism for them.  Instead, we
-## introduce a new SaveRecord type, close_tag.
+## introduce a new save stack entry type, close_tag.
 
 sub defer_close_tag {
     my $tex = shift;
 
     my $qName = shift;
 
-    my $save_record = new_save_record({ type  => close_tag,
-                                        level => level_zero,
-                                        index => $qName });
-
-    $tex->push_save_stack($save_record);
+    $tex->push_save_entry(close_tag, level_zero, $qName, undef);
 
     return;
 }
@@ -2875,38 +3108,32 @@ sub unsave {
     my $group_type;
     my $line_no;
 
+    my $ident = ident $tex;
+
+    my $catcode_slots = $catcode_slots_of{$ident};
+
     if ($tex->cur_level() > level_one) {
         $tex->decr_cur_level();
 
-        ## Check if the value is defined not just true so that a raw
-        ## box-related value of 0 on the stack doesn't abort
-        ## prematurely.  (Such a value should never be encountered
-        ## here, but bugs do happen, and failure to check for defined
-        ## values instead of true values hid a bug for a while.)
-
-        while (defined(my $record = $tex->pop_save_stack())) {
-            if (! is_save_record($record)) {
-                croak "'$record' is not a SaveRecord";
+        while (my ($save_type, $level, $index, $value) = $tex->pop_save_entry()) {
+            if ($save_type == SAVED_VALUE) {
+                croak "'" . ($value // "") . "' is not a save record";
             }
 
-            my $save_type = $record->get_type();
-
             if ($tex->tracing_groups() > 1) {
-                $tex->DEBUG("unsave: popping $record");
+                $tex->DEBUG("unsave: popping " . save_entry_string($save_type, $level, $index, $value));
             }
 
             if ($save_type == level_boundary) {
                 $group_type = $tex->cur_group();
-                $line_no    = $record->get_line();
+                $line_no    = $value;
 
-                $tex->set_cur_group($record->get_level());
-                $tex->set_cur_boundary($record->get_index());
+                $tex->set_cur_group($level);
+                $tex->set_cur_boundary($index);
 
                 last;
             }
 
-            my $index = $record->get_index();
-
             if ($save_type == close_tag) { # index = qName
                 $tex->end_xml_element($index);
 
@@ -2919,13 +3146,21 @@ sub unsave {
                 my $saved_eqvt;
 
                 if ($save_type == restore_old_value) {
-                    $saved_eqvt = $record->get_saved_eqvt();
+                    $saved_eqvt = $value;
                 } else { ## restore_zero
                     $saved_eqvt = UNDEFINED_CS;
                 }
 
                 if ( $index->$*->level() != level_one) {
+                    $index->$*->set_stale(1);
+
                     $index->$* = $saved_eqvt;
+
+                    $saved_eqvt->set_stale(0) if $save_type == restore_old_value;
+
+                    if (defined(my $char_code = $catcode_slots->{ident $index})) {
+                        $tex->uncache_catcode($char_code);
+                    }
                 }
             }
         }
@@ -2969,14 +3204,15 @@ sub show_save_stack {
     # $tex->DEBUG("  cur_group = " . group_type($tex->cur_group()));
     # $tex->DEBUG("  cur_boundary = " . $cur_boundary);
 
-    my @stack = $tex->get_save_stacks();
+    my $ident = ident $tex;
 
     # $tex->DEBUG("save stack:");
 
-    for (my $i = 0; $i < @stack; $i++) {
-        my $record = $stack[$i];
-
-        $record = $record->to_string() if is_save_record($record);
+    for (my $i = 0; $i <= $tex->save_ptr(); $i++) {
+        my $record = save_entry_string($save_type_of{$ident}->[$i],
+                                       $save_level_of{$ident}->[$i],
+                                       $save_index_of{$ident}->[$i],
+                                       $save_value_of{$ident}->[$i]);
 
         # if ($i == $cur_boundary) {
         #     $tex->DEBUG(" *save_stack($i) = $record");
@@ -3290,14 +3526,15 @@ sub print_cmd_chr {
 ######################################################################
 
 package TeX::Interpreter::InStateRecord {
-    use TeX::Class;
+    use TeX::Class qw(:array_backed);
 
     use TeX::Constants qw(:file_types);
 
     my %lexer_state_of :COUNTER(:name<lexer_state> :default(-1));
 
     my %lines_of       :ARRAY(:name<line>);
-    my %chars_of       :ARRAY(:name<char>);
+    my %line_buffer_of :ATTR(:name<line_buffer> :default<"">);
+    my %line_pos_of    :COUNTER(:name<line_pos> :default<0>);
     my %line_no_of     :COUNTER(:name<line_no> :default(1));
     my %char_no_of     :COUNTER(:name<char_no> :default(-1));
     my %file_name_of   :ATTR(:name<file_name>);
@@ -3308,6 +3545,8 @@ package TeX::Interpreter::InStateRecord {
 
     my %token_list_of  :ATTR(:name<token_list>    :type<TeX::TokenList>);
     my %token_type_of  :COUNTER(:name<token_type> :default<-1>);
+    my %token_loc_of   :COUNTER(:name<token_loc>  :default<0>);
+    my %param_args_of  :ATTR(:name<param_args>);
 
     sub to_string :STRINGIFY {
         my $self = shift;
@@ -3340,7 +3579,11 @@ my %scanner_status_of :COUNTER(:name<scanner_status> :default<normal>);
 my %lexer_state_of :COUNTER(:name<lexer_state> :default(-1)); # state in tex.web
 
 my %lines_of       :ARRAY(:name<line>);
-my %chars_of       :ARRAY(:name<char>);
+
+## The unread part of the current line is substr($line_buffer, $line_pos).
+
+my %line_buffer_of :ATTR(:name<line_buffer> :default<"">);
+my %line_pos_of    :COUNTER(:name<line_pos> :default<0>);
 my %line_no_of     :COUNTER(:name<input_line_no> :default(1));
 my %char_no_of     :COUNTER(:name<input_char_no> :default(-1));
 my %file_name_of   :ATTR(:name<file_name>);
@@ -3349,8 +3592,15 @@ my %file_type_of   :COUNTER(:name<file_type> :default<terminal>);
 my %eof_hook_of    :ATTR(:name<eof_hook>);
 my %eof_already_seen_of :COUNTER(:name<eof_already_seen>);
 
+## Token lists are read in place: token_loc is the index of the next
+## token to be read (loc in tex.web).  For a macro body, param_args
+## holds the arguments (param_stack in tex.web) that replace the #n's
+## as they are read, so that the expansion is never built.
+
 my %token_list_of :ATTR(:name<token_list> :type<TeX::TokenList>);
 my %token_type_of :COUNTER(:name<token_type> :default<-1>);
+my %token_loc_of  :COUNTER(:name<token_loc>  :default<0>);
+my %param_args_of :ATTR(:name<param_args>);
 
 sub runaway {
     my $tex = shift;
@@ -3445,9 +3695,12 @@ sub push_input {
         eof_already_seen => $tex->eof_already_seen(),
         token_list  => $tex->get_token_list(),
         token_type  => $tex->token_type(),
+        token_loc   => $tex->token_loc(),
+        param_args  => $tex->get_param_args(),
+        line_buffer => $tex->get_line_buffer(),
+        line_pos    => $tex->line_pos(),
                                    });
 
-    $saved->push_char($tex->get_chars());
     $saved->push_line($tex->get_lines());
 
     $tex->push_input_stack($saved);
@@ -3473,11 +3726,14 @@ sub pop_input {
     # if ($prev_lexer_state == token_list) {
         $tex->set_token_list($prev_state->get_token_list());
         $tex->set_token_type($prev_state->token_type());
+        $tex->set_token_loc($prev_state->token_loc());
+        $tex->set_param_args($prev_state->get_param_args());
     # } else {
-        $tex->delete_chars(); # should already be empty, but just in case
         $tex->delete_lines(); # should already be empty, but just in case
 
-        $tex->push_char($prev_state->get_chars());
+        $tex->set_line_buffer($prev_state->get_line_buffer());
+        $tex->set_line_pos($prev_state->line_pos());
+
         $tex->push_line($prev_state->get_lines());
 
         $tex->set_input_line_no($prev_state->line_no());
@@ -3492,6 +3748,9 @@ sub pop_input {
     return;
 }
 
+## back_list() and ins_list() take over $token_list, as in tex.web:
+## the caller mustn't use it again (see adopt_token_list()).
+
 sub back_list {
     my $tex = shift;
 
@@ -3507,7 +3766,7 @@ sub back_list {
         }
     }
 
-    return $tex->begin_token_list($token_list, backed_up);
+    return $tex->adopt_token_list($token_list, backed_up);
 }
 
 sub ins_list {
@@ -3515,28 +3774,82 @@ sub ins_list {
 
     my $token_list = shift;
 
-    return $tex->begin_token_list($token_list, inserted);
+    return $tex->adopt_token_list($token_list, inserted);
+}
+
+## True if the input level that the current one will return to is a
+## token list that has been read to the end, i.e., one that
+## back_input() would discard along with the current level.
+
+sub __next_level_is_exhausted {
+    my $tex = shift;
+
+    my $ident = ident $tex;
+
+    my $saved = $input_stack_of{$ident}->[-1];
+
+    return unless defined $saved && $saved->lexer_state() == token_list;
+
+    my $token_list = $saved->get_token_list();
+
+    return $saved->token_type() != v_template
+        && (! defined $token_list || $saved->token_loc() >= $token_list->length());
 }
 
+## Levels of type backed_up and inserted always own their token lists
+## (begin_token_list() copies, adopt_token_list() takes over), so
+## instead of discarding an exhausted one and starting another level
+## for $token, which would cost a new InStateRecord and TeX::TokenList
+## every time, back_input() puts $token in the last slot of the old
+## one and backs up over it.  That's only done when the old level is
+## the last one that would have been discarded, so the input stack
+## ends up exactly as it would have otherwise.
+
 sub back_input {
     my $tex = shift;
 
     my $token = shift;
 
+    my $ident = ident $tex;
+
+    my $catcode = $token->get_catcode();
+
+    my $slot;
+
     while ( ($tex->lexer_state() == token_list) &&
-            ($tex->get_token_list()->length() == 0) &&
+            $tex->end_of_token_list() &&
             ($tex->token_type() != v_template) ) {
+        my $token_type = $token_type_of{$ident};
+
+        if (($token_type == backed_up || $token_type == inserted)
+            && $token_loc_of{$ident} > 0
+            && ! $tex->__next_level_is_exhausted()) {
+            $slot = --$token_loc_of{$ident};
+
+            last;
+        }
+
         $tex->end_token_list; # {conserve stack space}???
     }
 
-    my $catcode = $token->get_catcode();
-
     if ($catcode == CATCODE_BEGIN_GROUP) {
         $tex->decr_align_state();
     } elsif ($catcode == CATCODE_END_GROUP) {
         $tex->incr_align_state();
     }
 
+    if (defined $slot) {
+        $token_list_of{$ident}->get_tokens()->[$slot] = $token;
+
+        $token_type_of{$ident} = backed_up;
+
+        if (defined(my $profiler = $profiler_of{$ident})) {
+            $profiler->add_tokens(1);
+        }
+
+        return;
+    }
+
     $tex->push_input();
 
     my $token_list = TeX::TokenList->new({ tokens => [ $token ] });
@@ -3544,6 +3857,12 @@ sub back_input {
     $tex->set_lexer_state(token_list);
     $tex->set_token_list($token_list);
     $tex->set_token_type(backed_up);
+    $tex->set_token_loc(0);
+    $tex->delete_param_args();
+
+    if (defined(my $profiler = $profiler_of{ident $tex})) {
+        $profiler->add_tokens(1);
+    }
 
     return;
 }
@@ -3556,10 +3875,17 @@ my @TOKEN_LIST_TYPE = qw(parameter u_template v_template backed_up
                          everydisplay everyhbox everyvbox everyjob
                          everycr mark write);
 
+## begin_token_list() reads a copy of $token_list, so the caller can
+## go on using it.  A caller that has just built the list and has no
+## further use for it should call adopt_token_list() instead, which
+## reads it in place; after that, the list belongs to the input stack
+## and mustn't be changed.
+
 sub begin_token_list {
     my $tex = shift;
 
     my $token_list = shift;
+    my $token_type = shift;
 
     croak unless defined $token_list && ref($token_list);
 
@@ -3567,17 +3893,35 @@ sub begin_token_list {
 
     my $copy = TeX::TokenList->new({ tokens => [ $token_list->get_tokens() ] });
 
+    return $tex->adopt_token_list($copy, $token_type);
+}
+
+sub adopt_token_list {
+    my $tex = shift;
+
+    my $token_list = shift;
+
+    croak unless defined $token_list && ref($token_list);
+
+    return unless $token_list->length();
+
     my $token_type = shift;
 
     if ($token_type !~ m{\A \d+ \z}smx) {
-        confess "begin_token_list called without valid token_type";
+        confess "adopt_token_list called without valid token_type";
     }
 
     $tex->push_input();
 
     $tex->set_lexer_state(token_list);
-    $tex->set_token_list($copy);
+    $tex->set_token_list($token_list);
     $tex->set_token_type($token_type);
+    $tex->set_token_loc(0);
+    $tex->delete_param_args();
+
+    if (defined(my $profiler = $profiler_of{ident $tex})) {
+        $profiler->add_tokens($token_list->length());
+    }
 
     if ($token_type > macro) {
         if ($tex->tracing_macros() & TRACING_MACRO_TOKS) {
@@ -3595,6 +3939,79 @@ sub begin_token_list {
     return;
 }
 
+## Starts reading the replacement text of a macro in place.  $args is
+## the list of arguments, indexed by parameter number, with the token
+## that called the macro in slot 0 (see
+## TeX::Primitive::Macro::scan_arguments()).
+
+sub begin_macro_body {
+    my $tex = shift;
+
+    my $macro_text = shift;
+    my $args       = shift;
+
+    return unless $macro_text->length();
+
+    ## As in tex.web, levels we've finished reading are discarded first
+    ## {conserve stack space}, so a macro that calls itself at the end
+    ## of its body doesn't keep making the input stack deeper.
+
+    while ($tex->lexer_state() == token_list
+           && $tex->token_type() != v_template
+           && $tex->num_input_stacks() > 0) {
+        my $token_list = $tex->get_token_list();
+
+        last if defined $token_list && $tex->token_loc() < $token_list->length();
+
+        $tex->end_token_list();
+    }
+
+    $tex->push_input();
+
+    $tex->set_lexer_state(token_list);
+    $tex->set_token_list($macro_text);
+    $tex->set_token_type(macro);
+    $tex->set_token_loc(0);
+    $tex->set_param_args($args);
+
+    if (defined(my $profiler = $profiler_of{ident $tex})) {
+        $profiler->add_tokens($macro_text->length());
+    }
+
+    return;
+}
+
+## Starts reading a macro argument in place when get_next() reaches
+## a #n in the body of the macro.
+
+sub begin_parameter {
+    my $tex = shift;
+
+    my $arg = shift;
+
+    return unless $arg->length();
+
+    $tex->push_input();
+
+    $tex->set_lexer_state(token_list);
+    $tex->set_token_list($arg);
+    $tex->set_token_type(parameter);
+    $tex->set_token_loc(0);
+    $tex->delete_param_args();
+
+    return;
+}
+
+sub end_of_token_list {
+    my $tex = shift;
+
+    my $ident = ident $tex;
+
+    my $token_list = $token_list_of{$ident};
+
+    return ! defined $token_list || $token_loc_of{$ident} >= $token_list->length();
+}
+
 sub end_token_list { # {leave a token-list input level}
     my $tex = shift;
 
@@ -3606,6 +4023,12 @@ sub end_token_list { # {leave a token-list input level}
         }
     }
 
+    if (defined(my $profiler = $profiler_of{ident $tex})) {
+        if ($tex->token_type() == macro) {
+            $profiler->end_level($tex->num_input_stacks());
+        }
+    }
+
     $tex->pop_input();
 
     return;
@@ -3644,7 +4067,7 @@ sub begin_file_reading {
 
     $tex->set_lexer_state(mid_line);
 
-    $tex->delete_chars();
+    $tex->flush_line_buffer();
     $tex->delete_lines();
     $tex->set_input_line_no(1);
     $tex->set_input_char_no(-1);
@@ -3692,7 +4115,7 @@ sub clear_for_error_prompt {
     while ( ($tex->lexer_state() != token_list) &&
             ($tex->file_type() == terminal) &&
             defined($tex->get_input_stack(0)) &&
-            ($tex->get_token_list()->length() == 0) ) {
+            $tex->end_of_token_list() ) {
         $tex->end_file_reading();
     }
 
@@ -3718,9 +4141,9 @@ sub maybe_check_outer_validity {
 
     my $cur_tok = shift;
 
-    my $cur_cmd = $tex->get_meaning($cur_tok);
+    my ($cur_cmd, $kind) = $tex->peek_meaning_and_kind($cur_tok);
 
-    if (eval { $cur_cmd->isa("TeX::Primitive::Macro") }) {
+    if ($kind == KIND_MACRO) {
         if ($cur_cmd->is_outer()) {
             $tex->check_outer_validity($cur_tok);
         }
@@ -3752,9 +4175,13 @@ sub peek_next_token {
 sub peek_next_char {
     my $tex = shift;
 
-    my $next_char = $tex->get_char(0);
+    my $ident = ident $tex;
+
+    my $pos = $line_pos_of{$ident};
 
-    return $next_char;
+    return if $pos >= length($line_buffer_of{$ident});
+
+    return substr($line_buffer_of{$ident}, $pos, 1);
 }
 
 # Cf. ends_align_template()
@@ -3877,7 +4304,7 @@ sub get_next_from_file {
                         $tex->set_force_eof($eof);
                     }
                 } elsif ($tex->end_line_char_active() && ! $suppress_eol) {
-                    $tex->push_char(chr($tex->end_line_char));
+                    $tex->append_line_buffer(chr($tex->end_line_char));
                 }
             }
 
@@ -3966,11 +4393,17 @@ sub get_next_from_file {
 sub get_next_char {
     my $tex = shift;
 
-    my $char = $tex->shift_char();
+    my $ident = ident $tex;
 
-    return unless defined $char;
+    my $pos = $line_pos_of{$ident};
 
-    my $catcode = $tex->get_catcode(ord($char));
+    return if $pos >= length($line_buffer_of{$ident});
+
+    my $char = substr($line_buffer_of{$ident}, $pos, 1);
+
+    $line_pos_of{$ident} = $pos + 1;
+
+    my $catcode = $tex->lexer_catcode(ord($char));
 
     if ($catcode == CATCODE_SUPERSCRIPT) {
         my $next_char = $tex->peek_next_char();
@@ -3998,11 +4431,105 @@ sub get_next_char {
                 } else {
                     $char = chr(ord($c) - 64);
                 }
+
+                $catcode = $tex->lexer_catcode(ord($char));
             }
         }
     }
 
-    return wantarray ? ($char, $tex->get_catcode(ord($char))) : $char;
+    return wantarray ? ($char, $catcode) : $char;
+}
+
+## Returns the longest string of letters (and, if $other_ok is true,
+## other characters) at the current position in the line buffer and
+## moves past it.  Since it stops at the first superscript character,
+## the caller has to fall back on get_next_char() to see if that
+## starts a ^^ sequence.
+
+sub scan_char_run {
+    my $tex = shift;
+
+    my $other_ok = shift;
+
+    my $ident = ident $tex;
+
+    my $buffer = \$line_buffer_of{$ident};
+    my $vector = \$catcode_vector_of{$ident};
+
+    my $start = my $pos = $line_pos_of{$ident};
+
+    my $length = length(${ $buffer });
+
+    while ($pos < $length) {
+        my $char_code = ord(substr(${ $buffer }, $pos, 1));
+
+        my $catcode = $char_code < 256 ? vec(${ $vector }, $char_code, 8)
+                                       : $wide_catcodes_of{$ident}->{$char_code};
+
+        if (! defined $catcode || $catcode == CATCODE_UNCACHED) {
+            $catcode = $tex->lexer_catcode($char_code);
+        }
+
+        last unless $catcode == CATCODE_LETTER
+            || ($other_ok && $catcode == CATCODE_OTHER);
+
+        $pos++;
+    }
+
+    return "" if $pos == $start;
+
+    $line_pos_of{$ident} = $pos;
+
+    return substr(${ $buffer }, $start, $pos - $start);
+}
+
+## Returns the run of letters and others that the next calls to
+## get_next() would turn into character tokens, or an empty string if
+## we aren't reading straight from the line buffer.
+
+sub read_character_run {
+    my $tex = shift;
+
+    ## Discard any exhausted back_input() levels, as get_next() would.
+
+    while ($tex->lexer_state() == token_list
+           && $tex->token_type() == backed_up
+           && $tex->end_of_token_list()) {
+        $tex->end_token_list();
+    }
+
+    return "" if $tex->lexer_state() == token_list;
+
+    return "" if $tex->tracing_input();
+
+    my $run = $tex->scan_char_run(1);
+
+    $tex->set_lexer_state(mid_line) if length($run);
+
+    return $run;
+}
+
+## Undoes the last get_next_char(), which started at $start.  If that
+## char was the result of a ^^ sequence, the sequence is replaced by
+## the character in the buffer, as in tex.web.
+
+sub back_up_char {
+    my $tex = shift;
+
+    my $start = shift;
+    my $char  = shift;
+
+    my $ident = ident $tex;
+
+    my $end = $line_pos_of{$ident};
+
+    if ($end - $start > 1) {
+        substr($line_buffer_of{$ident}, $start, $end - $start) = $char;
+    }
+
+    $line_pos_of{$ident} = $start;
+
+    return;
 }
 
 sub scan_control_sequence {
@@ -4018,20 +4545,24 @@ sub scan_control_sequence {
         $control_name = $first_char;
 
         if ($first_catcode == CATCODE_LETTER) {
-            my ($next_char, $next_catcode) = $tex->get_next_char();
+            my $ident = ident $tex;
 
             while (1) {
+                $control_name .= $tex->scan_char_run();
+
+                my $start = $line_pos_of{$ident};
+
+                my ($next_char, $next_catcode) = $tex->get_next_char();
+
                 last unless defined $next_char;
 
                 if ($next_catcode == CATCODE_LETTER) {
                     $control_name .= $next_char;
                 } else {
-                    $tex->unshift_char($next_char);
+                    $tex->back_up_char($start, $next_char);
 
                     last;
                 }
-
-                ($next_char, $next_catcode) = $tex->get_next_char();
             }
 
             $tex->set_lexer_state(skip_blanks);
@@ -4046,7 +4577,7 @@ sub scan_control_sequence {
 
     my $cur_tok = make_csname_token($control_name);
 
-    if (! defined($tex->get_meaning($cur_tok))) {
+    if (! defined($tex->peek_meaning($cur_tok))) {
         $tex->define_csname($control_name => UNDEFINED_CS);
     }
 
@@ -4067,10 +4598,33 @@ sub process_active_character {
     return $cur_tok;
 }
 
+sub load_line_buffer {
+    my $tex = shift;
+
+    my $line = shift;
+
+    my $ident = ident $tex;
+
+    $line_buffer_of{$ident} = $line;
+    $line_pos_of{$ident}    = 0;
+
+    return;
+}
+
+sub append_line_buffer {
+    my $tex = shift;
+
+    my $string = shift;
+
+    $line_buffer_of{ident $tex} .= $string;
+
+    return;
+}
+
 sub flush_line_buffer {
     my $tex = shift;
 
-    $tex->delete_chars();
+    $tex->load_line_buffer("");
 
     return;
 }
@@ -4123,19 +4677,24 @@ sub process_space {
 sub get_next_from_token_list {
     my $tex = shift;
 
+    my $ident = ident $tex;
+
     while (1) {
-        ##???
-        my $token_list = $tex->get_token_list();
+        my $token_list = $token_list_of{$ident};
+
+        my $tokens = defined $token_list ? $token_list->get_tokens() : [];
+
+        if ($token_loc_of{$ident} < @{ $tokens }) {
+            my $cur_tok = $tokens->[ $token_loc_of{$ident}++ ];
 
-        if (defined $token_list && defined(my $cur_tok = $token_list->shift())) {
             my $cur_cat = $cur_tok->get_catcode();
 
             if ($cur_cat == CATCODE_CSNAME) {
-                my $cur_cmd = $tex->get_meaning($cur_tok);
+                my ($cur_cmd, $kind) = $tex->peek_meaning_and_kind($cur_tok);
 
                 ## Should we be checking the unexpanded macro here?
 
-                if (eval { $cur_cmd->isa("TeX::Primitive::Macro") }) {
+                if ($kind == KIND_MACRO) {
                     if ($cur_cmd->is_outer()) {
                         $tex->check_outer_validity($cur_tok);
                     }
@@ -4145,9 +4704,21 @@ sub get_next_from_token_list {
                     $tex->incr_align_state();
                 } elsif ($cur_cat == CATCODE_END_GROUP) {
                     $tex->decr_align_state();
-                } elsif ($cur_cat == CATCODE_PARAMETER) {
-                    # NOT USED
-                    # @<Insert macro parameter and |goto restart|@>;
+                } elsif ($cur_cat == CATCODE_PARAM_REF
+                         && defined(my $args = $param_args_of{$ident})) {
+                    ## @<Insert macro parameter and |goto restart|@>
+
+                    my $param_no = $cur_tok->get_param_no();
+
+                    my $arg = $args->[$param_no];
+
+                    if (! defined $arg) {
+                        $tex->fatal_error("Undefined parameter $param_no while expanding $args->[0]");
+                    }
+
+                    $tex->begin_parameter($arg);
+
+                    next;
                 }
             }
 
@@ -4269,12 +4840,30 @@ sub get_x_token {
             return FROZEN_ENDV_TOKEN;
         }
 
-        if (my $cur_cmd = $tex->get_expandable_meaning($cur_tok)) {
+        my ($cur_cmd, $kind) = $tex->get_meaning_and_kind($cur_tok);
+
+        if ($kind == KIND_MACRO || $kind == KIND_EXPANDABLE) {
             if ($respect_protected && $cur_cmd->is_protected()) {
                 return $cur_tok;
             }
 
-            $cur_cmd->expand($tex, $cur_tok);
+            $tex->note_perl_command($cur_cmd) if $memoize_fragments_of{ident $tex};
+
+            if (defined(my $profiler = $profiler_of{ident $tex})) {
+                my $frame = $profiler->enter($cur_tok, $cur_cmd);
+
+                $cur_cmd->expand($tex, $cur_tok);
+
+                if ($tex->lexer_state() == token_list
+                    && $tex->token_type() == macro
+                    && $tex->token_loc() == 0) {
+                    $profiler->leave_at_end_of_level($frame, $tex->num_input_stacks());
+                } else {
+                    $profiler->leave($frame);
+                }
+            } else {
+                $cur_cmd->expand($tex, $cur_tok);
+            }
         } else {
             return $cur_tok;
         }
@@ -4501,7 +5090,7 @@ sub scan_delimited_parameter {
 
                 $tex->back_list($partial_delim);
 
-                $partial_delim->clear();
+                $partial_delim = new_token_list();
 
                 $token = $tex->get_next();
             }
@@ -5957,6 +6546,8 @@ sub scan_toks {
                     } elsif (eval { $cur_cmd->isa("TeX::Primitive::the") }) {
                         $token_list->push($tex->the_toks($cur_tok));
                     } else {
+                        $tex->note_perl_command($cur_cmd);
+
                         $cur_cmd->expand($tex, $cur_tok);
                     }
                 }
@@ -6076,7 +6667,7 @@ sub read_toks {
         }
 
         if ($tex->end_line_char_active()) {
-            $tex->push_char(chr($tex->end_line_char));
+            $tex->append_line_buffer(chr($tex->end_line_char));
         }
 
         $tex->set_lexer_state(new_line);
@@ -6089,7 +6680,7 @@ sub read_toks {
             if ($tex->align_state() < ALIGN_NO_COLUMN) {
                 # unmatched } aborts the line
 
-                $tex->delete_chars();
+                $tex->flush_line_buffer();
 
                 $tex->set_align_state(ALIGN_NO_COLUMN);
 
@@ -6500,12 +7091,16 @@ sub make_output_record {
     return TeX::Interpreter::OutputRecord->new($data);
 }
 
+## See TeX::Output::XML::run_hooks() for the meaning of $priority and
+## $selectors.
+
 sub add_output_hook {
     my $tex = shift;
 
     my $hook = shift;
 
-    my $priority = shift // 0;
+    my $priority  = shift // 0;
+    my $selectors = shift;
 
     ## We defer creating the output handle as long as possible so
     ## that, for example, we can use \setXMLroot and \setXMLdoctype.
@@ -6514,9 +7109,9 @@ sub add_output_hook {
     ## ensure_output_open().
 
     if (defined(my $handle = $tex->get_output_handle())) {
-        $handle->push_hook([ $priority, $hook ]);
+        $handle->push_hook([ $priority, $hook, $selectors ]);
     } else {
-        $tex->push_output_hook([ $priority, $hook ]);
+        $tex->push_output_hook([ $priority, $hook, $selectors ]);
     }
 
     return;
@@ -6728,18 +7323,30 @@ sub find_file_path {
 
     my $file_name = shift;
 
-    return $file_name if -e $file_name;
+    if (defined(my $package_data = $package_data_of{ident $tex})) {
+        $package_data->note_opaque("file access ($file_name)");
+    }
+
+    ## Like kpathsea, try $file_name.tex before $file_name.
 
-    my $path = kpse_lookup($file_name);
+    my @names = kpse_tex_file_names($file_name);
 
-    if (empty($path)) {
-        $path = kpse_lookup("$file_name.tex");
+    for my $name (@names) {
+        return $name if -e $name;
+    }
+
+    my $path;
+
+    for my $name (@names) {
+        $path = kpse_lookup($name);
+
+        last if nonempty($path);
     }
 
     if (empty($path)) {
         my $dir = dirname($tex->get_job_name());
 
-        for my $f ($file_name, "$file_name.tex") {
+        for my $f (@names) {
             if (-e "$dir/$f") {
                 $path = "$dir/$f";
 
@@ -6845,7 +7452,7 @@ sub start_input {
     $tex->input_ln($fh);
 
     if ($tex->end_line_char_active()) {
-        $tex->push_char(chr($tex->end_line_char));
+        $tex->append_line_buffer(chr($tex->end_line_char));
     }
 
     return;
@@ -7008,6 +7615,12 @@ sub ship_out {
     return;
 }
 
+## If pretty_print is set, the XML is indented as it is written (see
+## TeX::Output::XML::PrettyPrinter) rather than by bin/texml's xml_pp
+## pass afterwards.  bin/texml sets it unless -nobuiltin_pp is given.
+
+my %pretty_print_of :BOOLEAN(:name<pretty_print> :default<0>);
+
 ## finish_output_file() replaces finish_dvi_file()
 
 sub finish_output_file {
@@ -7022,7 +7635,15 @@ sub finish_output_file {
     if (defined $dom) {
         if (nonempty(my $output_file_name = $tex->get_output_file_name())) {
             if ($output_file_name ne DEV_NULL) {
-                eval { $dom->toFile($output_file_name, 1) };
+                eval {
+                    if ($tex->is_pretty_print() && $dom->isa('XML::LibXML::Document')) {
+                        TeX::Output::XML::PrettyPrinter->new()->write_document($dom, $output_file_name);
+                    } else {
+                        $dom->toFile($output_file_name, 1);
+                    }
+
+                    $fh->complete_output_file($output_file_name);
+                };
 
                 if ($@) {
                     $tex->set_termination_message("Could not create $output_file_name: $@");
@@ -8548,27 +9169,29 @@ sub main_control {
         if (   $cur_cat == CATCODE_CSNAME
             || $cur_cat == CATCODE_ACTIVE
             || $cur_cat == CATCODE_ANONYMOUS) {
-            my $cur_cmd = $tex->get_meaning($cur_tok);
+            my ($cur_cmd, $kind) = $tex->get_meaning_and_kind($cur_tok);
+
+            my $profiler = $profiler_of{ident $tex};
 
-            use Scalar::Util qw(reftype);
+            my $frame = defined $profiler ? $profiler->enter($cur_tok, $cur_cmd) : undef;
 
-            # TRACE "ref($cur_cmd) = ", ref($cur_cmd), " :: ", reftype($cur_cmd), "\n";
+            $tex->note_perl_command($cur_cmd) if $memoize_fragments_of{ident $tex};
 
-            if (! defined $cur_cmd) {
-                $tex->handle_undefined_command($cur_tok, '<undef>');
-            } elsif (eval { $cur_cmd->isa("TeX::Token") }) {
+            if ($kind == KIND_TOKEN) {
                 $tex->back_input($cur_cmd);
-            } elsif (reftype($cur_cmd) eq 'CODE')  {
+            } elsif ($kind == KIND_CODE)  {
                 $cur_cmd->($tex, $cur_tok);
-            } elsif (eval { $cur_cmd->isa("TeX::Command::Prefixed") }) {
+            } elsif ($kind == KIND_PREFIXED) {
                 $tex->prefixed_command($cur_cmd, $cur_tok);
-            } elsif (eval { $cur_cmd->isa("TeX::Command") }) {
+            } elsif ($kind != KIND_UNDEFINED) {
                 $cur_cmd->execute($tex, $cur_tok);
             }
             else {
-                $tex->handle_undefined_command($cur_tok, $cur_cmd);
+                $tex->handle_undefined_command($cur_tok, $cur_cmd // '<undef>');
             }
 
+            $profiler->leave($frame) if defined $profiler;
+
             next;
         }
 
@@ -8683,7 +9306,21 @@ sub scan_word {
 
     my @buffer = ($left_code);
 
-    while (my ($next_code, $next_enc) = $tex->get_next_character()) {
+    ## Letters and others read straight from the input file are in
+    ## the current encoding, so if that's the encoding of this word
+    ## we can take them a run at a time.
+
+    my $batch_ok = $encoding eq $tex->get_encoding();
+
+    while (1) {
+        if ($batch_ok) {
+            push @buffer, map { ord } split //, $tex->read_character_run();
+        }
+
+        my ($next_code, $next_enc) = $tex->get_next_character();
+
+        last unless defined $next_code;
+
         if ($next_enc eq $encoding) {
             push @buffer, $next_code;
 
@@ -10069,6 +10706,8 @@ sub prefixed_command {
     }
 
     if (eval { $cur_cmd->isa("TeX::Command::Executable::Assignment") }) {
+        $tex->note_perl_command($cur_cmd);
+
         $cur_cmd->execute($tex, $cur_tok, $prefix);
     } else {
         $tex->confusion("prefix");
@@ -10277,6 +10916,10 @@ sub shift_case {
 
             my $char_code = ord($char);
 
+            if (defined(my $package_data = $package_data_of{$ident})) {
+                $package_data->note_code_read(case => $char_code);
+            }
+
             my $shifted = $table->{$char_code};
 
             if (! defined $shifted) {
@@ -10310,6 +10953,17 @@ sub shift_case {
 
 my %format_ident_of :ATTR(:name<format_ident>);
 
+## After a format has been undumped once, we save the result as a
+## TeX::FMT::Snapshot (see TeX/FMT/Snapshot.pm) so that later runs can
+## skip TeX::FMT::File altogether.  The [TeX::FMT::Snapshot] section of
+## the config file controls this:
+##
+##     mode = eager    decode the whole snapshot at startup (the default)
+##     mode = lazy     decode control sequences the first time they're used
+##     mode = off      always read the fmt file
+##
+##     cache_dir = ... where to keep snapshots
+
 sub load_fmt_file {
     my $tex = shift;
 
@@ -10345,13 +10999,42 @@ sub load_fmt_file {
     # $tex->print_char(" ");
     $tex->update_terminal();
 
-    my $fmt = TeX::FMT::File->new({ file_name => $path, debug_mode => 0 });
+    my $mode = TeX::FMT::Snapshot->mode();
+
+    my $snapshot;
+
+    my ($key, $cache_file);
+
+    if ($mode ne 'off') {
+        $key = TeX::FMT::Snapshot->cache_key($path);
+
+        if (defined $key) {
+            $cache_file = TeX::FMT::Snapshot->cache_file($path, $key);
+
+            $snapshot = TeX::FMT::Snapshot->load($cache_file, $key, $mode eq 'lazy');
+        }
+    }
+
+    if (! defined $snapshot) {
+        my $fmt = TeX::FMT::File->new({ file_name => $path, debug_mode => 0 });
+
+        $fmt->open('r');
+
+        $fmt->load_through_eqtb();
 
-    $fmt->open('r');
+        $snapshot = $tex->snapshot_eqtb($fmt);
 
-    $fmt->load_through_eqtb();
+        if (defined $cache_file) {
+            $snapshot->set_key($key);
+            $snapshot->set_fmt_file($path);
+
+            ## Failing to cache the snapshot shouldn't stop the job.
+
+            eval { $snapshot->save($cache_file) };
+        }
+    }
 
-    $tex->undump_eqtb($fmt);
+    $tex->install_snapshot($snapshot, $mode eq 'lazy');
 
     $tex->set_fmt_file($path);
 
@@ -10367,10 +11050,22 @@ sub undump_eqtb {
 
     my $fmt = shift;
 
+    $tex->install_snapshot($tex->snapshot_eqtb($fmt));
+
+    return;
+}
+
+sub snapshot_eqtb {
+    my $tex = shift;
+
+    my $fmt = shift;
+
     my $params = $fmt->get_params();
     my $eqtb   = $fmt->get_eqtb();
     my $mem    = $fmt->get_mem();
 
+    my $snapshot = TeX::FMT::Snapshot->new();
+
     ## REGION 1
 
     for my $eqtb_ptr ($params->active_base() .. $params->single_base() - 1) {
@@ -10380,9 +11075,7 @@ sub undump_eqtb {
 
         my $char_code = $eqtb_ptr - $params->active_base();
 
-        my $char = chr($char_code);
-
-        $tex->define_active_char($char, $meaning);
+        $snapshot->add_to_region(active => $char_code, $meaning);
     }
 
     for my $eqtb_ptr ($params->single_base() .. $params->null_cs() - 1) {
@@ -10392,9 +11085,7 @@ sub undump_eqtb {
 
         my $char_code = $eqtb_ptr - $params->single_base();
 
-        my $csname = chr($char_code);
-
-        $tex->define_csname($csname, $meaning);
+        $snapshot->add_to_region(single => $char_code, $meaning);
     }
 
     ## REGION 2
@@ -10414,7 +11105,7 @@ sub undump_eqtb {
 
         next unless defined $meaning;
 
-        $tex->define_csname($csname, $meaning);
+        $snapshot->add_csname($csname, $meaning);
     }
 
     ## REGION 3
@@ -10428,9 +11119,7 @@ sub undump_eqtb {
 
         my $ptr = $eqtb->get_word($glue_base + $equiv_code)->get_equiv();
 
-        my $value = $mem->get_glue($ptr);
-
-        $tex->get_glue_parameter($param)->get_equiv()->set_value($value);
+        $snapshot->add_to_region(glue_param => $param, __extract_glue($mem, $ptr));
     }
 
     my $skip_base = $params->skip_base();
@@ -10438,25 +11127,28 @@ sub undump_eqtb {
     for my $index (0..$params->number_regs() - 1) {
         my $ptr = $eqtb->get_word($skip_base + $index)->get_equiv();
 
-        my $value = $mem->get_glue($ptr);
-
-        my $eqvt_ptr = $tex->find_skip_register($index);
-
-        ${ $eqvt_ptr }->get_equiv()->set_value($value);
+        $snapshot->add_to_region(skip => $index, __extract_glue($mem, $ptr));
     }
 
     ## REGION 4
 
-    $tex->extract_token_parameter($fmt, 'every_par',     $fmt->every_par_loc);
-    $tex->extract_token_parameter($fmt, 'every_math',    $fmt->every_math_loc);
-    $tex->extract_token_parameter($fmt, 'every_display', $fmt->every_display_loc);
-    $tex->extract_token_parameter($fmt, 'every_hbox',    $fmt->every_hbox_loc);
-    $tex->extract_token_parameter($fmt, 'every_vbox',    $fmt->every_vbox_loc);
-    $tex->extract_token_parameter($fmt, 'every_job',     $fmt->every_job_loc);
-    $tex->extract_token_parameter($fmt, 'every_cr',      $fmt->every_cr_loc);
+    for my $param (qw(every_par every_math every_display every_hbox
+                      every_vbox every_job every_cr)) {
+        my $loc = "${param}_loc";
+
+        my $toks = $tex->extract_toks_list($fmt, $fmt->$loc);
+
+        next unless defined $toks;
+
+        $snapshot->add_to_region(token_param => $param, $toks);
+    }
 
     for my $index (0..255) {
-        $tex->extract_token_register($fmt, $index);
+        my $toks = $tex->extract_toks_list($fmt, $fmt->toks_base + $index);
+
+        next unless defined $toks;
+
+        $snapshot->add_to_region(toks => $index, $toks);
     }
 
     my $cat_base  = $params->cat_code_base();
@@ -10474,19 +11166,12 @@ sub undump_eqtb {
     $last_char_code = 127 if $last_char_code > 127;
 
     for my $char_code ($params->first_text_char() .. $last_char_code) {
-        # $tex->initialize_char_codes($char_code);
-
-        my $catcode  = $eqtb->get_word($cat_base  + $char_code)->get_equiv();
-        my $lccode   = $eqtb->get_word($lc_base   + $char_code)->get_equiv();
-        my $uccode   = $eqtb->get_word($uc_base   + $char_code)->get_equiv();
-        my $sfcode   = $eqtb->get_word($sf_base   + $char_code)->get_equiv();
-        my $mathcode = $eqtb->get_word($math_base + $char_code)->get_equiv();
-
-        $tex->set_catcode($char_code,  $catcode);
-        $tex->set_lccode($char_code,   $lccode);
-        $tex->set_uccode($char_code,   $uccode);
-        $tex->set_sfcode($char_code,   $sfcode);
-        $tex->set_mathcode($char_code, $mathcode);
+        $snapshot->add_to_region(codes => $char_code,
+                                 $eqtb->get_word($cat_base  + $char_code)->get_equiv(),
+                                 $eqtb->get_word($lc_base   + $char_code)->get_equiv(),
+                                 $eqtb->get_word($uc_base   + $char_code)->get_equiv(),
+                                 $eqtb->get_word($sf_base   + $char_code)->get_equiv(),
+                                 $eqtb->get_word($math_base + $char_code)->get_equiv());
     }
 
     ## REGION 5
@@ -10500,7 +11185,7 @@ sub undump_eqtb {
 
         my $value = $eqtb->get_word($int_base + $equiv_code)->get_equiv();
 
-        $tex->get_integer_parameter($param)->get_equiv()->set_value($value);
+        $snapshot->add_to_region(int_param => $param, $value);
     }
 
     my $count_base = $params->count_base();
@@ -10508,9 +11193,7 @@ sub undump_eqtb {
     for my $index (0..$params->number_regs() - 1) {
         my $value = $eqtb->get_word($count_base + $index)->get_equiv();
 
-        my $eqvt_ptr = $tex->find_count_register($index);
-
-        ${ $eqvt_ptr }->get_equiv()->set_value($value);
+        $snapshot->add_to_region(count => $index, $value);
     }
 
     ## REGION 6
@@ -10520,168 +11203,316 @@ sub undump_eqtb {
     for my $index (0..$params->number_regs() - 1) {
         my $value = $eqtb->get_word($scaled_base + $index)->get_equiv();
 
-        my $eqvt_ptr = $tex->find_dimen_register($index);
-
-        ${ $eqvt_ptr }->get_equiv()->set_value($value);
+        $snapshot->add_to_region(dimen => $index, $value);
     }
 
-    return;
+    return $snapshot;
 }
 
-my %REGISTER = (count  => int_val,
-                dimen  => dimen_val,
-                muskip => mu_val,
-                skip   => glue_val,
-                toks   => tok_val);
-
-my %CHARACTER = (left_brace  => CATCODE_BEGIN_GROUP,
-                 right_brace => CATCODE_END_GROUP,
-                 math_shift  => CATCODE_MATH_SHIFT,
-                 tab_mark    => CATCODE_ALIGNMENT,
-                 mac_param   => CATCODE_PARAMETER,
-                 sup_mark    => CATCODE_SUPERSCRIPT,
-                 sub_mark    => CATCODE_SUBSCRIPT,
-                 spacer      => CATCODE_SPACE,
-                 letter      => CATCODE_LETTER,
-                 other_char  => CATCODE_OTHER,
-    );
+sub __extract_glue {
+    my $mem = shift;
+    my $ptr = shift;
 
-my %MACRO = (call            => 0,
-             long_call       => MODIFIER_LONG,
-             outer_call      => MODIFIER_OUTER,
-             long_outer_call => MODIFIER_LONG | MODIFIER_OUTER,
-    );
+    return ($mem->get_width($ptr),
+            $mem->get_stretch($ptr), $mem->get_stretch_order($ptr),
+            $mem->get_shrink($ptr),  $mem->get_shrink_order($ptr));
+}
 
-sub extract_token_parameter {
+sub install_snapshot {
     my $tex = shift;
 
-    my $fmt             = shift;
-    my $token_parameter = shift;
-    my $eqtb_index      = shift;
+    my $snapshot = shift;
+    my $lazy     = shift;
 
-    if (defined (my $toks = $tex->extract_toks_list($fmt, $eqtb_index))) {
-        $tex->set_toks_list($token_parameter, $toks);
+    ## REGION 1
 
-        $token_parameter =~ s{_}{}g;
-    }
+    for my $entry ($snapshot->get_region_entries('active')) {
+        my ($char_code, $record) = @{ $entry };
 
-    return;
-}
+        my $meaning = $tex->unpack_meaning($record);
 
-sub extract_token_register {
-    my $tex = shift;
+        next unless defined $meaning;
 
-    my $fmt   = shift;
-    my $index = shift;
+        $tex->define_active_char(chr($char_code), $meaning);
+    }
 
-    my $eqtb_index = $fmt->toks_base + $index;
+    for my $entry ($snapshot->get_region_entries('single')) {
+        my ($char_code, $record) = @{ $entry };
 
-    if (defined (my $toks = $tex->extract_toks_list($fmt, $eqtb_index))) {
-        my $registers = $toks_registers_of{ident $tex};
+        my $meaning = $tex->unpack_meaning($record);
 
-        $tex->eq_define(\$registers->{$index}, $toks);
-    }
+        next unless defined $meaning;
 
-    return;
-}
+        $tex->define_csname(chr($char_code), $meaning);
+    }
 
-sub extract_toks_list {
-    my $tex = shift;
+    ## REGION 2
 
-    my $fmt        = shift;
-    my $eqtb_index = shift;
+    if ($lazy) {
+        ## Control sequences that already exist (the primitives) have
+        ## to be overridden now, since get_csname() only consults the
+        ## snapshot for names it doesn't know.
 
-    my $eqtb   = $fmt->get_eqtb();
-    my $mem    = $fmt->get_mem();
+        for my $csname (sort keys %{ $csnames_of{ident $tex} }) {
+            my $record = $snapshot->take_csname_record($csname);
 
-    my $eqtb_entry = $eqtb->get_word($eqtb_index);
+            next unless defined $record;
 
-    my $equiv = $eqtb_entry->get_equiv();
+            my $meaning = $tex->unpack_meaning($record, $csname);
 
-    return unless defined $equiv && $equiv != $fmt->null_ptr;
+            $tex->define_csname($csname, $meaning) if defined $meaning;
+        }
 
-    my $toks = new_token_list();
+        $tex->set_lazy_csnames($snapshot);
+    } else {
+        $snapshot->for_each_csname(sub {
+            my ($csname, $record) = @_;
 
-    for (my $ptr = $mem->get_link($equiv);
-         $ptr != $fmt->null_ptr;
-         $ptr = $mem->get_link($ptr)) {
-        my $token = $tex->extract_token($fmt, $ptr);
+            my $meaning = $tex->unpack_meaning($record, $csname);
 
-        $toks->push($token);
+            $tex->define_csname($csname, $meaning) if defined $meaning;
+        });
     }
 
-    return $toks;
-}
+    ## REGION 3
 
-sub extract_meaning {
-    my $tex = shift;
+    for my $entry ($snapshot->get_region_entries('glue_param')) {
+        my ($param, @glue) = @{ $entry };
 
-    my $fmt      = shift;
-    my $eqtb_ptr = shift;
+        $tex->get_glue_parameter($param)->get_equiv()->set_value(__make_glue(@glue));
+    }
 
-    my $csname = shift;
+    for my $entry ($snapshot->get_region_entries('skip')) {
+        my ($index, @glue) = @{ $entry };
 
-    my $params = $fmt->get_params();
-    my $eqtb   = $fmt->get_eqtb();
+        my $eqvt_ptr = $tex->find_skip_register($index);
 
-    my $eqtb_entry = $eqtb->get_word($eqtb_ptr);
+        ${ $eqvt_ptr }->get_equiv()->set_value(__make_glue(@glue));
+    }
 
-    my $eq_level = $eqtb_entry->get_eq_level();
-    my $eq_type  = $eqtb_entry->get_eq_type();
-    my $equiv    = $eqtb_entry->get_equiv();
+    ## REGION 4
 
-    my ($type, $subtype) = $params->interpret_cmd_chr($eq_type, $equiv);
+    for my $entry ($snapshot->get_region_entries('token_param')) {
+        my ($param, $packed) = @{ $entry };
 
-    return unless defined $type;
+        $tex->set_toks_list($param, new_token_list(unpack_token_list($packed)));
+    }
 
-    return if $type eq 'UNKNOWN';
+    my $registers = $toks_registers_of{ident $tex};
 
-    if (defined(my $cat_code = $CHARACTER{$type})) {
-        return make_character_token(chr($equiv), $cat_code);
-    }
+    for my $entry ($snapshot->get_region_entries('toks')) {
+        my ($index, $packed) = @{ $entry };
 
-    if (defined (my $level = $REGISTER{$type}) && defined $subtype) {
-        return TeX::Primitive::Register->new({ level => $level,
-                                               index => $subtype });
+        my $toks = new_token_list(unpack_token_list($packed));
+
+        $tex->eq_define(\$registers->{$index}, $toks);
+    }
+
+    for my $entry ($snapshot->get_region_entries('codes')) {
+        my ($char_code, $catcode, $lccode, $uccode, $sfcode, $mathcode) = @{ $entry };
+
+        # $tex->initialize_char_codes($char_code);
+
+        $tex->set_catcode($char_code,  $catcode);
+        $tex->set_lccode($char_code,   $lccode);
+        $tex->set_uccode($char_code,   $uccode);
+        $tex->set_sfcode($char_code,   $sfcode);
+        $tex->set_mathcode($char_code, $mathcode);
+    }
+
+    ## REGION 5
+
+    for my $entry ($snapshot->get_region_entries('int_param')) {
+        my ($param, $value) = @{ $entry };
+
+        $tex->get_integer_parameter($param)->get_equiv()->set_value($value);
+    }
+
+    for my $entry ($snapshot->get_region_entries('count')) {
+        my ($index, $value) = @{ $entry };
+
+        my $eqvt_ptr = $tex->find_count_register($index);
+
+        ${ $eqvt_ptr }->get_equiv()->set_value($value);
+    }
+
+    ## REGION 6
+
+    for my $entry ($snapshot->get_region_entries('dimen')) {
+        my ($index, $value) = @{ $entry };
+
+        my $eqvt_ptr = $tex->find_dimen_register($index);
+
+        ${ $eqvt_ptr }->get_equiv()->set_value($value);
+    }
+
+    return;
+}
+
+sub __make_glue {
+    my ($width, $stretch, $stretch_order, $shrink, $shrink_order) = @_;
+
+    return make_glue_spec($width,
+                          [ $stretch, $stretch_order ],
+                          [ $shrink,  $shrink_order ]);
+}
+
+my %REGISTER = (count  => int_val,
+                dimen  => dimen_val,
+                muskip => mu_val,
+                skip   => glue_val,
+                toks   => tok_val);
+
+my %CHARACTER = (left_brace  => CATCODE_BEGIN_GROUP,
+                 right_brace => CATCODE_END_GROUP,
+                 math_shift  => CATCODE_MATH_SHIFT,
+                 tab_mark    => CATCODE_ALIGNMENT,
+                 mac_param   => CATCODE_PARAMETER,
+                 sup_mark    => CATCODE_SUPERSCRIPT,
+                 sub_mark    => CATCODE_SUBSCRIPT,
+                 spacer      => CATCODE_SPACE,
+                 letter      => CATCODE_LETTER,
+                 other_char  => CATCODE_OTHER,
+    );
+
+my %MACRO = (call            => 0,
+             long_call       => MODIFIER_LONG,
+             outer_call      => MODIFIER_OUTER,
+             long_outer_call => MODIFIER_LONG | MODIFIER_OUTER,
+    );
+
+## The meanings in a snapshot are packed into strings.  The first
+## character of each string says what kind of meaning it is; the rest
+## is the data needed to reconstruct it:
+##
+##     T  character token       packed token list of length 1
+##     R  register              level, index
+##     K  \chardef              value (and encoding)
+##     M  \mathchardef          value
+##     F  font identifier       font number
+##     A  parameter             name of the primitive
+##     D  macro                 flags, parameter text, replacement text
+##     P  any other primitive   command name and modifier
+##
+## pack_meaning() uses the same encoding for the meanings recorded by
+## read_package_data() (see TeX::Interpreter::PackageData), which can
+## also be
+##
+##     U  undefined
+##     L  whatever the control sequence (kind "csname") or active
+##        character (kind "active") with the given name means
+
+use constant {
+    MEANING_TOKEN     => 'T',
+    MEANING_REGISTER  => 'R',
+    MEANING_CHARDEF   => 'K',
+    MEANING_MATHCHAR  => 'M',
+    MEANING_FONT      => 'F',
+    MEANING_PARAMETER => 'A',
+    MEANING_MACRO     => 'D',
+    MEANING_PRIMITIVE => 'P',
+    MEANING_UNDEFINED => 'U',
+    MEANING_ALIAS     => 'L',
+};
+
+sub __pack_tokens {
+    return pack_token_list(map { [ $_->get_catcode(), $_->get_datum() ] } @_);
+}
+
+sub extract_toks_list {
+    my $tex = shift;
+
+    my $fmt        = shift;
+    my $eqtb_index = shift;
+
+    my $eqtb   = $fmt->get_eqtb();
+    my $mem    = $fmt->get_mem();
+
+    my $eqtb_entry = $eqtb->get_word($eqtb_index);
+
+    my $equiv = $eqtb_entry->get_equiv();
+
+    return unless defined $equiv && $equiv != $fmt->null_ptr;
+
+    my @tokens;
+
+    for (my $ptr = $mem->get_link($equiv);
+         $ptr != $fmt->null_ptr;
+         $ptr = $mem->get_link($ptr)) {
+        push @tokens, $tex->extract_token($fmt, $ptr);
+    }
+
+    return __pack_tokens(@tokens);
+}
+
+sub extract_meaning {
+    my $tex = shift;
+
+    my $fmt      = shift;
+    my $eqtb_ptr = shift;
+
+    my $csname = shift;
+
+    my $params = $fmt->get_params();
+    my $eqtb   = $fmt->get_eqtb();
+
+    my $eqtb_entry = $eqtb->get_word($eqtb_ptr);
+
+    my $eq_level = $eqtb_entry->get_eq_level();
+    my $eq_type  = $eqtb_entry->get_eq_type();
+    my $equiv    = $eqtb_entry->get_equiv();
+
+    my ($type, $subtype) = $params->interpret_cmd_chr($eq_type, $equiv);
+
+    return unless defined $type;
+
+    return if $type eq 'UNKNOWN';
+
+    if (defined(my $cat_code = $CHARACTER{$type})) {
+        return MEANING_TOKEN . pack_token_list([ $cat_code, chr($equiv) ]);
+    }
+
+    if (defined (my $level = $REGISTER{$type}) && defined $subtype) {
+        return MEANING_REGISTER . pack("j j", $level, $subtype);
     }
 
     if ($type eq 'char' && defined $subtype) {
-        return TeX::Primitive::CharGiven->new({ value => $subtype });
+        return MEANING_CHARDEF . pack("j", $subtype);
     }
 
     if ($type eq 'mathchar' && defined $subtype) {
-        return make_math_given($subtype);
+        return MEANING_MATHCHAR . pack("j", $subtype);
     }
 
     if ($type =~ m{\A assign_(dimen|glue|int|toks) \z}smx) {
-        return $tex->get_primitive($subtype);
+        return MEANING_PARAMETER . $subtype;
     }
 
     if ($type eq 'set_font' && defined $subtype) {
-        return TeX::Primitive::SetFont->new({ font => $subtype });
+        return MEANING_FONT . pack("j", $subtype);
     }
 
     if (defined(my $flags = $MACRO{$type})) {
         return $tex->extract_macro($fmt, $flags, $equiv);
     }
 
-    if (defined(my $primitive = $tex->get_primitive($type))) {
-        return $primitive;
-    }
+    ## Make sure we can load the primitive while we still know what it
+    ## was called.
 
-    my $meaning = eval { $tex->load_primitive($type) };
+    if (! defined $tex->get_primitive($type)) {
+        eval { $tex->load_primitive($type) };
 
-    return $meaning unless $@;
+        if ($@) {
+            my $csname  = $csname  || '<undef>';
+            my $subtype = $subtype || '<undef>';
 
-    {
-        my $csname  = $csname  || '<undef>';
-        my $type    = $type    || '<undef>';
-        my $subtype = $subtype || '<undef>';
+            $tex->print_err("Can't find definition for '$csname' [$type, $subtype]");
 
-        $tex->print_err("Can't find definition for '$csname' [$type, $subtype]");
+            return;
+        }
     }
 
-    return;
+    return MEANING_PRIMITIVE . pack("n/a* n/a*", $type, $subtype || '<undef>');
 }
 
 sub extract_macro {
@@ -10691,16 +11522,12 @@ sub extract_macro {
     my $flags       = shift;
     my $ref_cnt_ptr = shift;
 
-    my $macro = TeX::Primitive::Macro->new({
-        outer     => $flags & MODIFIER_OUTER,
-        long      => $flags & MODIFIER_LONG,
-        protected => $flags & MODIFIER_PROTECTED,
-                                           });
-
     my $params = $fmt->get_params();
     my $mem    = $fmt->get_mem();
 
-    my $token_list = new_token_list();
+    my $parameter_text;
+
+    my @tokens;
 
     my $param_no = 0;
 
@@ -10710,9 +11537,9 @@ sub extract_macro {
         my $token = $tex->extract_token($fmt, $ptr);
 
         if ($token == $params->end_match()) {
-            $macro->set_parameter_text($token_list);
+            $parameter_text = __pack_tokens(@tokens);
 
-            $token_list = new_token_list();
+            @tokens = ();
 
             next;
         }
@@ -10720,12 +11547,14 @@ sub extract_macro {
             $token = make_param_ref_token(++$param_no);
         }
 
-        $token_list->push($token);
+        push @tokens, $token;
     }
 
-    $macro->set_replacement_text($token_list);
-
-    return $macro;
+    return MEANING_MACRO . pack("j C N/a* N/a*",
+                                $flags,
+                                defined $parameter_text ? 1 : 0,
+                                $parameter_text // "",
+                                __pack_tokens(@tokens));
 }
 
 sub extract_token {
@@ -10783,126 +11612,402 @@ sub extract_token {
     return;
 }
 
-# sub __show_macro {
-#     my $macro = shift;
-#
-#     my $param_text = $macro->get_parameter_text();
-#     my $macro_text = $macro->get_replacement_text();
-#
-#     if (defined $param_text) {
-#         print $param_text;
-#     }
-#
-#     print "->";
-#
-#     print $macro_text;
-#
-#     return;
-# }
+## Packs a meaning found in eqtb, or returns undef if it isn't one
+## that can be rebuilt from scratch: only characters, macros,
+## primitives and the results of \countdef, \chardef and friends can.
 
-# sub list_macros {
-#     my $tex = shift;
-#
-#     my $active_chars = $tex->get_active_chars();
-#
-#     while (my ($char, $eqvt) = each %{ $active_chars }) {
-#         my $meaning = $eqvt->get_equiv();
-#
-#         if (defined $meaning) {
-#             $tex->print_ln();
-#             $tex->print_char($char);
-#             $tex->print(": ");
-#             $tex->print_meaning($meaning);
-#             $tex->print_ln();
-#         }
-#     }
-#
-#     my $csnames = $tex->get_csnames();
-#
-#     while (my ($csname, $eqvt) = each %{ $csnames }) {
-#         my $meaning = $eqvt->get_equiv();
-#
-#         if (defined $meaning) {
-#             $tex->print_ln();
-#             $tex->print_esc($csname);
-#             $tex->print(": ");
-#             $tex->print_meaning($meaning);
-#             $tex->print_ln();
-#         }
-#     }
-#
-#     return;
-# }
+sub pack_meaning {
+    my $tex = shift;
 
-######################################################################
-##                                                                  ##
-##                      [51] THE MAIN PROGRAM                       ##
-##                                                                  ##
-######################################################################
+    my $meaning = shift;
 
-sub __list_primitives {
-    my $tex = shift;
+    return MEANING_UNDEFINED unless defined $meaning;
 
-    my @primitives = qw(accent advance
-                        afterassignment aftergroup
-                        badness batchmode begingroup botmark box
-                        catcode char chardef closein closeout
-                        copy count countdef cr crcr csname delcode
-                        dimen dimendef discretionary
-                        divide else
-                        end endcsname endgroup endinput
-                        errmessage errorstopmode expandafter fi
-                        firstmark font fontdimen fontname futurelet
-                        halign hbox hrule hskip
-                        hyphenation hyphenchar if ifcase ifcat
-                        ifdim ifeof iffalse ifhbox ifhmode ifinner
-                        ifmmode ifnum ifodd iftrue ifvbox ifvoid ifx
-                        ignorespaces immediate indent input
-                        inputlineno jobname kern lastbox
-                        lastkern lastpenalty lastskip lccode
-                        let lower lowercase mark
-                        mathchardef
-                        mathcode
-                        meaning
-                        message
-                        multiply muskip muskipdef noalign
-                        noexpand noindent
-                        nonstopmode nullfont number omit openin
-                        openout or par
-                        patterns penalty raise read
-                        relax romannumeral
-                        scrollmode setbox setlanguage sfcode
-                        showthe skewchar skip
-                        skipdef span splitbotmark
-                        splitfirstmark string tabskip
-                        the toks toksdef topmark uccode
-                        unhbox unhcopy
-                        unskip unvbox unvcopy uppercase valign
-                        vbox vcenter vrule vskip
-                        vsplit vtop write);
+    my $class = blessed($meaning) // return;
 
-    ## The following aren't implemented, but they need to be bound to
-    ## keep various macro packages from complaining.
+    if ($class eq 'TeX::Token') {
+        return if $meaning == CATCODE_ANONYMOUS;
 
-    push @primitives, qw(above abovewithdelims atop atopwithdelims
-                         cleaders delimiter displaylimits displaystyle
-                         dp dump eqno hfil hfill hfilneg hss ht insert
-                         leaders left leqno limits mathaccent mathbin
-                         mathchar mathchoice mathclose mathinner
-                         mathop mathopen mathord mathpunct mathrel
-                         mkern moveleft moveright mskip noboundary
-                         nolimits nonscript over overline
-                         overwithdelims radical scriptfont
-                         scriptscriptfont scriptscriptstyle
-                         scriptstyle shipout show showbox showlists
-                         special textfont textstyle underline unkern
-                         unpenalty vadjust vfil vfill vfilneg vss wd
-                         xleaders);
+        return MEANING_TOKEN . __pack_tokens($meaning);
+    }
 
-    ## eTeX extensions
-    push @primitives, qw(detokenize
-                         ifcsname ifdefined
-                         dimexpr glueexpr muexpr numexpr
+    if ($class eq 'TeX::Primitive::Macro') {
+        my @parameter_text   = $meaning->get_parameter_text()->get_tokens();
+        my @replacement_text = $meaning->get_replacement_text()->get_tokens();
+
+        for my $token (@parameter_text, @replacement_text) {
+            return if $token == CATCODE_ANONYMOUS;
+        }
+
+        my $flags = 0;
+
+        $flags |= MODIFIER_LONG      if $meaning->is_long();
+        $flags |= MODIFIER_OUTER     if $meaning->is_outer();
+        $flags |= MODIFIER_PROTECTED if $meaning->is_protected();
+
+        return MEANING_MACRO . pack("j C N/a* N/a*",
+                                    $flags,
+                                    1,
+                                    __pack_tokens(@parameter_text),
+                                    __pack_tokens(@replacement_text));
+    }
+
+    if ($class eq 'TeX::Primitive::Register' && defined(my $index = $meaning->get_index())) {
+        return MEANING_REGISTER . pack("j j", $meaning->get_level(), $index);
+    }
+
+    if ($class eq 'TeX::Primitive::CharGiven') {
+        return MEANING_CHARDEF . pack("j", $meaning->get_value()) . $meaning->get_encoding();
+    }
+
+    if ($class eq 'TeX::Primitive::MathGiven') {
+        return MEANING_MATHCHAR . pack("j", $meaning->get_value());
+    }
+
+    ## Including the nameless \relax'es that \countdef and friends
+    ## define the control sequence as while they scan the rest of the
+    ## assignment.
+
+    if ($class eq 'TeX::Primitive::relax') {
+        return MEANING_PRIMITIVE . pack("n/a* n/a*", 'relax', '<undef>');
+    }
+
+    if ($meaning->isa('TeX::Command') && defined(my $name = $meaning->get_name())) {
+        my $primitive = $tex->get_primitive($name);
+
+        if (defined $primitive && ident($primitive) == ident($meaning)) {
+            return MEANING_PRIMITIVE . pack("n/a* n/a*", $name, '<undef>');
+        }
+    }
+
+    return;
+}
+
+## The values of registers, parameters and character codes are packed
+## as
+##
+##     S  a number (or other plain scalar)
+##     G  glue: width, stretch and shrink and their orders
+##     T  a token list
+##     A  a list of numbers (\parshape)
+##
+## pack_eqtb_value() returns undef for anything else.
+
+use constant {
+    VALUE_SCALAR => 'S',
+    VALUE_GLUE   => 'G',
+    VALUE_TOKENS => 'T',
+    VALUE_ARRAY  => 'A',
+};
+
+sub pack_eqtb_value {
+    my $tex = shift;
+
+    my $value = shift;
+
+    return unless defined $value;
+
+    my $class = ref($value);
+
+    return VALUE_SCALAR . $value if $class eq '';
+
+    if ($class eq 'TeX::Type::GlueSpec') {
+        return VALUE_GLUE . pack("j5", $value->get_width(),
+                                       $value->get_stretch(),
+                                       $value->get_stretch_order(),
+                                       $value->get_shrink(),
+                                       $value->get_shrink_order());
+    }
+
+    if ($class eq 'TeX::TokenList') {
+        my @tokens = $value->get_tokens();
+
+        for my $token (@tokens) {
+            return if $token == CATCODE_ANONYMOUS;
+        }
+
+        return VALUE_TOKENS . __pack_tokens(@tokens);
+    }
+
+    if ($class eq 'ARRAY') {
+        for my $item (@{ $value }) {
+            return if ref $item;
+        }
+
+        return VALUE_ARRAY . pack("j*", @{ $value });
+    }
+
+    return;
+}
+
+sub unpack_eqtb_value {
+    my $tex = shift;
+
+    my $record = shift;
+
+    my $kind = substr($record, 0, 1);
+    my $data = substr($record, 1);
+
+    return $data if $kind eq VALUE_SCALAR;
+
+    if ($kind eq VALUE_GLUE) {
+        my ($width, $stretch, $stretch_order, $shrink, $shrink_order)
+            = unpack("j5", $data);
+
+        return TeX::Type::GlueSpec->new({ width         => $width,
+                                          stretch       => $stretch,
+                                          stretch_order => $stretch_order,
+                                          shrink        => $shrink,
+                                          shrink_order  => $shrink_order });
+    }
+
+    return [ unpack("j*", $data) ] if $kind eq VALUE_ARRAY;
+
+    return new_token_list(unpack_token_list($data));
+}
+
+## A string that is the same for meanings that behave the same, in
+## this run or any other one.  Meanings that can't be packed are only
+## identified by their class, which is good enough since package data
+## can only have peeked at them (see PackageData::note_read()).
+
+sub fingerprint_meaning {
+    my $tex = shift;
+
+    my $meaning = shift;
+
+    if (defined(my $record = $tex->pack_meaning($meaning))) {
+        return $record;
+    }
+
+    my $class = ref($meaning);
+
+    ## Anonymous macros are numbered in the order they're created.
+
+    $class =~ s{\A TeX::Primitive::Macro::\d+ \z}{TeX::Primitive::Macro::}smx;
+
+    my $index = eval { $meaning->get_index() } // "";
+
+    return "?$class $index";
+}
+
+sub unpack_meaning {
+    my $tex = shift;
+
+    my $record = shift;
+    my $csname = shift;
+
+    my $kind = substr($record, 0, 1);
+    my $data = substr($record, 1);
+
+    if ($kind eq MEANING_UNDEFINED) {
+        return;
+    }
+
+    if ($kind eq MEANING_ALIAS) {
+        my ($source_kind, $source) = unpack("n/a* n/a*", $data);
+
+        utf8::decode($source);
+
+        my $eqvt = $source_kind eq 'active' ? $tex->get_active_char($source)
+                                            : $tex->get_csname($source);
+
+        return defined $eqvt ? $eqvt->get_equiv() : undef;
+    }
+
+    if ($kind eq MEANING_TOKEN) {
+        return (unpack_token_list($data))[0];
+    }
+
+    if ($kind eq MEANING_REGISTER) {
+        my ($level, $index) = unpack("j j", $data);
+
+        return TeX::Primitive::Register->new({ level => $level,
+                                               index => $index });
+    }
+
+    if ($kind eq MEANING_CHARDEF) {
+        ## pack_meaning() appends the encoding of a \UCSchardef.
+
+        my $value    = unpack("j", $data);
+        my $encoding = substr($data, length(pack("j", 0)));
+
+        return TeX::Primitive::CharGiven->new({ name     => "char",
+                                                value    => $value,
+                                                encoding => $encoding });
+    }
+
+    if ($kind eq MEANING_MATHCHAR) {
+        return make_math_given(unpack("j", $data));
+    }
+
+    if ($kind eq MEANING_FONT) {
+        return TeX::Primitive::SetFont->new({ font => unpack("j", $data) });
+    }
+
+    if ($kind eq MEANING_PARAMETER) {
+        return $tex->get_primitive($data);
+    }
+
+    if ($kind eq MEANING_MACRO) {
+        my ($flags, $has_parameters, $parameter_text, $replacement_text)
+            = unpack("j C N/a* N/a*", $data);
+
+        my %macro = (outer     => $flags & MODIFIER_OUTER,
+                     long      => $flags & MODIFIER_LONG,
+                     protected => $flags & MODIFIER_PROTECTED,
+                     replacement_text
+                         => new_token_list(unpack_token_list($replacement_text)));
+
+        if ($has_parameters) {
+            $macro{parameter_text} = new_token_list(unpack_token_list($parameter_text));
+        }
+
+        return TeX::Primitive::Macro->new(\%macro);
+    }
+
+    ## MEANING_PRIMITIVE
+
+    my ($type, $subtype) = unpack("n/a* n/a*", $data);
+
+    if (defined(my $primitive = $tex->get_primitive($type))) {
+        return $primitive;
+    }
+
+    my $meaning = eval { $tex->load_primitive($type) };
+
+    return $meaning unless $@;
+
+    {
+        my $csname  = $csname  || '<undef>';
+        my $type    = $type    || '<undef>';
+
+        $tex->print_err("Can't find definition for '$csname' [$type, $subtype]");
+    }
+
+    return;
+}
+
+# sub __show_macro {
+#     my $macro = shift;
+#
+#     my $param_text = $macro->get_parameter_text();
+#     my $macro_text = $macro->get_replacement_text();
+#
+#     if (defined $param_text) {
+#         print $param_text;
+#     }
+#
+#     print "->";
+#
+#     print $macro_text;
+#
+#     return;
+# }
+
+# sub list_macros {
+#     my $tex = shift;
+#
+#     my $active_chars = $tex->get_active_chars();
+#
+#     while (my ($char, $eqvt) = each %{ $active_chars }) {
+#         my $meaning = $eqvt->get_equiv();
+#
+#         if (defined $meaning) {
+#             $tex->print_ln();
+#             $tex->print_char($char);
+#             $tex->print(": ");
+#             $tex->print_meaning($meaning);
+#             $tex->print_ln();
+#         }
+#     }
+#
+#     my $csnames = $tex->get_csnames();
+#
+#     while (my ($csname, $eqvt) = each %{ $csnames }) {
+#         my $meaning = $eqvt->get_equiv();
+#
+#         if (defined $meaning) {
+#             $tex->print_ln();
+#             $tex->print_esc($csname);
+#             $tex->print(": ");
+#             $tex->print_meaning($meaning);
+#             $tex->print_ln();
+#         }
+#     }
+#
+#     return;
+# }
+
+######################################################################
+##                                                                  ##
+##                      [51] THE MAIN PROGRAM                       ##
+##                                                                  ##
+######################################################################
+
+sub __list_primitives {
+    my $tex = shift;
+
+    my @primitives = qw(accent advance
+                        afterassignment aftergroup
+                        badness batchmode begingroup botmark box
+                        catcode char chardef closein closeout
+                        copy count countdef cr crcr csname delcode
+                        dimen dimendef discretionary
+                        divide else
+                        end endcsname endgroup endinput
+                        errmessage errorstopmode expandafter fi
+                        firstmark font fontdimen fontname futurelet
+                        halign hbox hrule hskip
+                        hyphenation hyphenchar if ifcase ifcat
+                        ifdim ifeof iffalse ifhbox ifhmode ifinner
+                        ifmmode ifnum ifodd iftrue ifvbox ifvoid ifx
+                        ignorespaces immediate indent input
+                        inputlineno jobname kern lastbox
+                        lastkern lastpenalty lastskip lccode
+                        let lower lowercase mark
+                        mathchardef
+                        mathcode
+                        meaning
+                        message
+                        multiply muskip muskipdef noalign
+                        noexpand noindent
+                        nonstopmode nullfont number omit openin
+                        openout or par
+                        patterns penalty raise read
+                        relax romannumeral
+                        scrollmode setbox setlanguage sfcode
+                        showthe skewchar skip
+                        skipdef span splitbotmark
+                        splitfirstmark string tabskip
+                        the toks toksdef topmark uccode
+                        unhbox unhcopy
+                        unskip unvbox unvcopy uppercase valign
+                        vbox vcenter vrule vskip
+                        vsplit vtop write);
+
+    ## The following aren't implemented, but they need to be bound to
+    ## keep various macro packages from complaining.
+
+    push @primitives, qw(above abovewithdelims atop atopwithdelims
+                         cleaders delimiter displaylimits displaystyle
+                         dp dump eqno hfil hfill hfilneg hss ht insert
+                         leaders left leqno limits mathaccent mathbin
+                         mathchar mathchoice mathclose mathinner
+                         mathop mathopen mathord mathpunct mathrel
+                         mkern moveleft moveright mskip noboundary
+                         nolimits nonscript over overline
+                         overwithdelims radical scriptfont
+                         scriptscriptfont scriptscriptstyle
+                         scriptstyle shipout show showbox showlists
+                         special textfont textstyle underline unkern
+                         unpenalty vadjust vfil vfill vfilneg vss wd
+                         xleaders);
+
+    ## eTeX extensions
+    push @primitives, qw(detokenize
+                         ifcsname ifdefined
+                         dimexpr glueexpr muexpr numexpr
                          unexpanded unless
         );
 
@@ -11218,199 +12323,1026 @@ sub end_of_TEX {
     return $tex->termination_status();
 }
 
-sub close_files_and_terminate {
-    my $tex = shift;
+sub close_files_and_terminate {
+    my $tex = shift;
+
+    $tex->finish_extensions();
+
+    # stat if tracing_stats > 0 then @<Output statistics about this job@>; stats
+
+    ## Wait for any SVGs that are still being rendered in the
+    ## background before the output hooks look for them.
+
+    if (defined(my $svg_agent = $tex->get_svg_agent())) {
+        $svg_agent->flush_queue();
+    }
+
+    $tex->finish_output_file();
+
+    $tex->write_profile();
+
+    $tex->report_fragment_cache();
+
+    $tex->final_cleanup();       # { prepare for death }
+
+    if ($tex->log_opened()) {
+        $tex->wlog_cr();
+
+        my $log_file = $tex->get_log_file();
+
+        close($log_file);
+
+        $tex->set_log_file(undef);
+
+        my $selector = $tex->selector() - 2;
+
+        $tex->set_selector($selector);
+
+        if ($selector == term_only) {
+            $tex->print_nl("Transcript written on ");
+            $tex->slow_print($tex->get_log_name());
+            $tex->print_char(".");
+            $tex->print_ln(); # Where is this in tex.web?
+        }
+    }
+
+    STDOUT->flush();
+    STDERR->flush();
+
+    return;
+}
+
+## If profiling was turned on, the report goes to <job_name>.prof and
+## the collapsed stacks (for flamegraph.pl) to <job_name>.folded.
+
+sub write_profile {
+    my $tex = shift;
+
+    my $profiler = $tex->get_profiler();
+
+    return unless defined $profiler;
+
+    return if $tex->nofiles();
+
+    my $job_name = $tex->get_job_name();
+
+    $job_name = "texput" if empty($job_name);
+
+    my $report_file    = "$job_name.prof";
+    my $collapsed_file = "$job_name.folded";
+
+    eval {
+        $profiler->write_report($report_file);
+        $profiler->write_collapsed($collapsed_file);
+    };
+
+    if (my $error = $@) {
+        chomp($error);
+
+        $tex->print_nl("Can't write profile: $error");
+    } else {
+        $tex->print_nl("Profile written on $report_file and $collapsed_file.");
+    }
+
+    $tex->print_ln();
+
+    return;
+}
+
+sub final_cleanup {
+    my $tex = shift;
+
+    my $open_parens = $tex->open_parens();
+
+    while ($open_parens > 0) {
+        $tex->print(" )");
+
+        $open_parens--;
+    }
+
+    $tex->print_ln();
+
+    $tex->set_open_parens(0);
+
+    if ( (my $cur_level = $tex->cur_level()) > level_one ) {
+        $tex->print_nl("(");
+        $tex->print_esc("end occurred ");
+        $tex->print("inside a group at level ");
+        $tex->print_int($cur_level - level_one);
+        $tex->print_char(")");
+    }
+
+    $tex->check_cond_stack();
+
+    return;
+}
+
+sub check_cond_stack {
+    my $tex = shift;
+
+    # $tex->print_nl("*** Checking cond stack");
+
+    while (my $ptr = $tex->get_cond_ptr()) {
+        my $if_limit = $ptr->if_limit();
+        my $if_line  = $ptr->if_line();
+        my $cur_if   = $ptr->get_cur_if();
+
+        $tex->print_nl("(");
+        $tex->print_esc("end occurred ");
+        $tex->print("when ");
+        # $tex->print_cmd_chr($if_limit);
+        $tex->print_esc($cur_if->get_csname());
+
+        if ($if_line != 0) {
+            print(" on line ");
+            $tex->print_int($if_line);
+        }
+
+        $tex->print(" was incomplete)");
+
+        $tex->pop_cond_stack();
+    }
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                  SPECIAL RECURSIVE MAIN_LOOPS                    ##
+##                                                                  ##
+######################################################################
+
+## These are used by perl code that needs to execute some TeX input
+## and then take control back.
+
+sub push_main_control {
+    my $tex = shift;
+
+    $tex->set_eof_hook(
+        sub {
+            my $tex = shift;
+
+            $tex->pop_main_control();
+
+            return;
+        });
+
+    $tex->main_control();
+
+    return;
+}
+
+sub pop_main_control {
+    my $tex = shift;
+
+    $tex->back_input(POP_MAIN_CONTROL);
+
+    return;
+}
+
+sub process_file {
+    my $tex = shift;
+
+    my $file_spec = shift;
+    my $fh        = shift;
+
+    my $start_time = time();
+
+    $tex->start_input($file_spec, $fh);
+
+    $tex->push_main_control();
+
+    return;
+}
+
+sub process_string {
+    my $tex = shift;
+
+    my $string = shift;
+
+    return unless defined $string;
+
+    $tex->begin_string_reading($string);
+
+    $tex->push_main_control();
+
+    return;
+}
+
+## The first time we read a __DATA__ section (in a given state; see
+## TeX::Interpreter::PackageData), we record the definitions it makes.
+## After that, as long as the control sequences it looked at still
+## mean the same thing, we just repeat the definitions.
+
+sub read_package_data {
+    my $tex = shift;
+
+    my $package = caller;
+
+    my $stash = eval { no strict 'refs'; *{ "${package}::" } };
+
+    my $data_handle = *{ $stash->{DATA} }{IO};
+
+    my $position = tell($data_handle);
+
+    my $at_cat = $tex->get_catcode(ord('@'));
+
+    $tex->set_catcode(ord('@'), CATCODE_LETTER);
+
+    my $ident = ident $tex;
+
+    my $outer = $package_data_of{$ident};
+
+    $outer->note_opaque("nested package data ($package)") if defined $outer;
+
+    my ($key, $cache_file, $data);
+
+    if (TeX::Interpreter::PackageData->is_enabled()) {
+        $data = do { local $/; <$data_handle> } // "";
+
+        seek($data_handle, $position, SEEK_SET);
+
+        $key = TeX::Interpreter::PackageData->cache_key($package, $data,
+                                                        $tex->__eqtb_signature($data));
+
+        $cache_file = TeX::Interpreter::PackageData->cache_file($package, $key);
+
+        my $recording = TeX::Interpreter::PackageData->load($cache_file, $key);
+
+        if (defined $recording && $tex->replay_package_data($package, $recording)) {
+            $tex->set_catcode(ord('@'), $at_cat);
+
+            return;
+        }
+    }
+
+    my $recording;
+
+    if (defined $cache_file) {
+        $recording = TeX::Interpreter::PackageData->new({
+            key          => $key,
+            base_level   => $tex->cur_level(),
+            selector     => $tex->selector(),
+            signed_chars => { map { $_ => 1 } __signed_chars($data) },
+        });
+    }
+
+    my $cur_list  = $cur_list_of{$ident};
+    my $num_nodes = $cur_list->num_nodes();
+
+    $tex->start_input($package, $data_handle);
+
+    $package_data_of{$ident} = $recording;
+
+    $tex->push_main_control();
+
+    $package_data_of{$ident} = $outer;
+
+    if (defined $recording) {
+        if (   $tex->cur_level() != $recording->base_level()
+            || ident($cur_list_of{$ident}) != ident($cur_list)
+            || $cur_list->num_nodes() != $num_nodes) {
+            $recording->note_opaque("unbalanced groups or typesetting");
+        }
+
+        my $ok = $recording->finish_recording(sub { $tex->fingerprint_meaning(@_) });
+
+        if ($ok) {
+            ## Failing to cache the definitions shouldn't stop the job.
+
+            eval { $recording->save($cache_file) };
+        }
+    }
+
+    $tex->set_catcode(ord('@'), $at_cat);
+
+    seek($data_handle, $position, SEEK_SET);
+
+    return;
+}
+
+## The parts of eqtb whose assignments can be recorded, by the kind
+## they're recorded under.  The XML tag parameters are added below;
+## see "XML EXTENSIONS".  \parshape is recorded as kind par_shape.
+
+my %EQTB_TABLES = (
+    count_register    => \%count_registers_of,
+    dimen_register    => \%dimen_registers_of,
+    skip_register     => \%skip_registers_of,
+    muskip_register   => \%muskip_registers_of,
+    toks_register     => \%toks_registers_of,
+    integer_parameter => \%integer_parameters_of,
+    dimen_parameter   => \%dimen_parameters_of,
+    glue_parameter    => \%glue_parameters_of,
+    muglue_parameter  => \%muglue_parameters_of,
+    token_parameter   => \%token_parameters_of,
+    cat_code          => \%cat_codes_of,
+    lc_code           => \%lc_codes_of,
+    uc_code           => \%uc_codes_of,
+    tc_code           => \%tc_codes_of,
+    sf_code           => \%sf_codes_of,
+    math_code         => \%math_codes_of,
+    del_code          => \%del_codes_of,
+);
+
+my %VOLATILE_PARAMETERS = map { $_ => 1 } qw(time day month year);
+
+## The characters whose codes are part of the cache key: the 8-bit
+## characters and any others that appear in $data.
+
+sub __signed_chars {
+    my $data = shift;
+
+    my %char_codes = map { $_ => 1 } 0..255;
+
+    $char_codes{ord($_)} = 1 for $data =~ m{([^\x00-\xff])}g;
+
+    return sort { $a <=> $b } keys %char_codes;
+}
+
+## The parts of eqtb that the code could look at without our noticing:
+## the character codes of the __signed_chars() (the catcodes matter
+## for tokenizing $data, and \lowercase and friends read the others)
+## and the registers and parameters, except for the date and time.
+## Reading the codes of any other character makes the recording opaque
+## (see TeX::Interpreter::PackageData::note_code_read()).
+
+sub __eqtb_signature {
+    my $tex = shift;
+
+    my $data = shift;
+
+    my $ident = ident $tex;
+
+    state $DEFAULT_VALUES = { map { $tex->pack_eqtb_value($_) => 1 }
+                                  0, TeX::Type::GlueSpec->new(), new_token_list() };
+
+    my $md5 = Digest::MD5->new();
+
+    my @char_codes = __signed_chars($data);
+
+    my @catcodes = map { $tex->get_catcode($_) } @char_codes;
+
+    $md5->add(join ",", $tex->end_line_char(), @catcodes);
+
+    ## get_catcode() has initialized the other codes, if the character
+    ## has any.
+
+    for my $kind (qw(lc_code uc_code tc_code sf_code math_code del_code)) {
+        my $table = $EQTB_TABLES{$kind}->{$ident};
+
+        my @codes = map { defined $_ ? $_->get_equiv()->get_value() : "" }
+                        @{ $table }{ @char_codes };
+
+        $md5->add("\x{0}$kind ", join ",", @codes);
+    }
+
+    for my $kind (sort keys %EQTB_TABLES) {
+        next if $kind =~ m{_code\z};
+
+        my $table = $EQTB_TABLES{$kind}->{$ident};
+
+        for my $name (sort keys %{ $table }) {
+            next if $kind eq 'integer_parameter' && $VOLATILE_PARAMETERS{$name};
+
+            my $equiv = $table->{$name}->get_equiv();
+
+            my $value = eval { $equiv->get_value() };
+
+            my $record = $tex->pack_eqtb_value($value) // "?" . ref($value);
+
+            ## Registers are created when they're first referred to, so
+            ## one with the default value is the same as a missing one.
+
+            next if $DEFAULT_VALUES->{$record};
+
+            utf8::encode($record);
+
+            $md5->add("\x{0}$kind $name=", $record);
+        }
+    }
+
+    return $md5->hexdigest();
+}
+
+## Looks up where an eqtb_ptr passed to eq_define() points, if it's one
+## of the %EQTB_TABLES.  The reverse index is rebuilt whenever we see
+## a new entry, which is cheap enough since this is only done while
+## recording.
+
+sub __find_eqtb_cell {
+    my $tex = shift;
+
+    my $package_data = shift;
+    my $eqvt_ptr     = shift;
+
+    my $ident = ident $tex;
+
+    my $addr = refaddr($eqvt_ptr);
+
+    return (par_shape => "") if $addr == refaddr(\$par_shape_of{$ident});
+
+    if (! defined $package_data->get_cell($addr)) {
+        for my $kind (keys %EQTB_TABLES) {
+            my $table = $EQTB_TABLES{$kind}->{$ident};
+
+            for my $name (keys %{ $table }) {
+                $package_data->set_cell(refaddr(\$table->{$name}), [ $kind, $name ]);
+            }
+        }
+    }
+
+    my $cell = $package_data->get_cell($addr);
+
+    return defined $cell ? @{ $cell } : ();
+}
+
+sub __eqtb_cell_ptr {
+    my $tex = shift;
+
+    my $kind = shift;
+    my $name = shift;
+
+    my $ident = ident $tex;
+
+    return \$par_shape_of{$ident} if $kind eq 'par_shape';
+
+    return \$EQTB_TABLES{$kind}->{$ident}->{$name};
+}
+
+## Returns false, without changing anything, if the recording doesn't
+## apply.
+
+sub replay_package_data {
+    my $tex = shift;
+
+    my $package   = shift;
+    my $recording = shift;
+
+    return unless $tex->selector() == $recording->get_selector();
+
+    for my $read ($recording->get_reads()) {
+        my ($kind, $name, $fingerprint) = @{ $read };
+
+        my $eqvt = $kind eq 'active' ? $tex->get_active_char($name)
+                                     : $tex->get_csname($name);
+
+        my $meaning = defined $eqvt ? $eqvt->get_equiv() : undef;
+
+        return unless $tex->fingerprint_meaning($meaning) eq $fingerprint;
+    }
+
+    ## Print the same thing start_input() and the end of the file would.
+
+    if ( $tex->term_offset() + length($package) > $tex->max_print_line() - 2 ) {
+        $tex->print_ln();
+    } elsif ( $tex->term_offset() > 0 || $tex->file_offset() > 0 ) {
+        $tex->print_char(" ");
+    }
+
+    $tex->print_char("(");
+    $tex->incr_open_parens();
+    $tex->slow_print($package);
+
+    for my $definition ($recording->get_definitions()) {
+        my ($kind, $name, $record, $modifier) = @{ $definition };
+
+        if ($kind eq 'active') {
+            $tex->define_active_char($name, $tex->unpack_meaning($record, $name), $modifier);
+        } elsif ($kind eq 'csname') {
+            $tex->define_csname($name, $tex->unpack_meaning($record, $name), $modifier);
+        } else {
+            my $eqvt_ptr = $tex->__eqtb_cell_ptr($kind, $name);
+
+            $tex->eq_define($eqvt_ptr, $tex->unpack_eqtb_value($record), $modifier);
+
+            $tex->uncache_catcode($name) if $kind eq 'cat_code';
+        }
+    }
+
+    ## Then whatever the section printed, ending with the ")".
+
+    my $old_setting = $tex->selector();
+
+    for my $chunk ($recording->get_printeds()) {
+        my ($selector, $text) = @{ $chunk };
+
+        $tex->set_selector($selector);
+
+        if (defined $text) {
+            $tex->print_char($_) for split //, $text;
+        } else {
+            $tex->print_ln();
+        }
+    }
+
+    $tex->set_selector($old_setting);
+
+    $tex->decr_open_parens();
+    $tex->update_terminal();
+
+    return 1;
+}
+
+## Assignments that don't go through __record_definition(): those to
+## registers, parameters and character codes are recorded by value.
+
+sub __record_assignment {
+    my $tex = shift;
+
+    my $package_data = shift;
+
+    my $eqvt_ptr = shift;
+    my $equiv    = shift;
+    my $modifier = shift;
+
+    return if $package_data->take_pending();
+
+    my ($kind, $name) = $tex->__find_eqtb_cell($package_data, $eqvt_ptr);
+
+    if (! defined $kind) {
+        $package_data->note_opaque("assignment to something other than a register");
+
+        return;
+    }
+
+    my $record = $tex->pack_eqtb_value($equiv);
+
+    $package_data->note_definition($kind, $name, $record, $modifier);
+
+    ## This is the assignment note_definition() is expecting.
+
+    $package_data->take_pending();
+
+    return;
+}
+
+sub __record_definition {
+    my $tex = shift;
+
+    my $package_data = shift;
+
+    my $kind     = shift;
+    my $name     = shift;
+    my $meaning  = shift;
+    my $modifier = shift // 0;
+
+    return unless $package_data->is_lasting($tex, $modifier & MODIFIER_GLOBAL);
+
+    my $record = $tex->pack_meaning($meaning);
+
+    if (! defined $record) {
+        my ($source_kind, $source) = $package_data->find_source($meaning);
+
+        if (defined $source) {
+            my $eqvt = $source_kind eq 'active' ? $tex->get_active_char($source)
+                                                : $tex->get_csname($source);
+
+            my $equiv = defined $eqvt ? $eqvt->get_equiv() : undef;
+
+            if (ref($equiv) && ident($equiv) == ident($meaning)) {
+                utf8::encode($source);
+
+                $record = MEANING_ALIAS . pack("n/a* n/a*", $source_kind, $source);
+            }
+        }
+    }
+
+    $package_data->note_definition($kind, $name, $record, $modifier);
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                      ALTERNATE ENTRY POINTS                      ##
+##                                                                  ##
+######################################################################
+
+## These are alternates to TeX().
+
+## Can these be replaced by \hbox and/or \boxtostring?
+
+## When memoize_fragments is on, a conversion is looked up in
+## fragment_cache under a key made from its input (the token list's
+## catcodes and characters, or the string), the par_tags flag, the
+## current mode, the input encoding, catcode_state and
+## memoization_context().  Each key holds a list of entries, one for
+## every state of eqtb the conversion has been cached in: the fragment
+## it produced, weak references to the EQVTs it read, and the control
+## sequences and active characters it found undefined.  An entry can be
+## reused as long as none of those EQVTs is stale and the undefined
+## ones are still undefined, so assignments to things the conversion
+## didn't look at don't get in the way.
+##
+## A conversion is only cached if it had no side_effects, i.e., if the
+## only thing it changed was its own group, so that running it again
+## could only produce the same fragment.  In that case it also leaves
+## catcode_state where it found it, since the catcodes it changed were
+## restored when its group was unwound.  The EQVTs it made itself are
+## stale by then and aren't remembered.
+##
+## Once an EQVT has been freed it can't come back into force, so an
+## entry that refers to one is discarded, both when its key is looked
+## up and in a sweep of the whole cache after every
+## FRAGMENT_CACHE_SWEEP new entries.
+##
+## The cache keeps its own copy of each fragment and hands out clones,
+## since callers normally move the nodes into the main document.
+##
+## Conversions without a group of their own ($no_group) change the
+## caller's state and are never cached.
+
+use constant FRAGMENT_CACHE_SWEEP => 1000;
+
+my %fragment_cache_of :HASH(:name<fragment_cache>); # key => [ entries ]
+
+my %fragment_cache_additions_of :COUNTER(:name<fragment_cache_additions>);
+
+my %fragment_cache_hits_of        :COUNTER(:name<fragment_cache_hits>);
+my %fragment_cache_misses_of      :COUNTER(:name<fragment_cache_misses>);
+my %fragment_cache_uncacheable_of :COUNTER(:name<fragment_cache_uncacheable>);
+
+## Perl code can change things that eqtb and side_effects know nothing
+## about (labels, CSS rules, the section stack, ...), so
+## note_perl_command() counts every command or pseudo-macro defined in
+## Perl as a side effect unless it has been declared safe with
+## allow_memoization().  The primitives in TeX::Primitive only change
+## state we keep track of, except for the texml extensions, of which
+## only the ones that just add to the output or only look at the XML
+## element stack (which is part of memoization_context()) are known to
+## be safe.
+##
+## A command declared safe may still read or change Perl state, as
+## long as that state is part of memoization_context(): the context is
+## part of the key, and a conversion that leaves it different from the
+## way it found it isn't cached.
+
+my %memoizable_of :HASH(:name<memoizable>); # class name or code address => 1
+
+my %MEMOIZABLE_PRIMITIVE = map { ("TeX::Primitive::texml::$_" => 1) }
+    qw(startXMLelement endXMLelement deferXMLclosetag
+       setXMLattribute setXMLclass addXMLclass deleteXMLclass
+       addXMLcomment leavevmode titlecase ifinXMLelement);
+
+sub __memoization_key {
+    my $command = shift;
+
+    return refaddr($command) if ref($command) eq 'CODE';
+
+    return unless blessed($command);
+
+    if ($command->isa('TeX::Primitive::Macro')) {
+        my $code = $command->get_anonymous_code();
+
+        return defined $code ? refaddr($code) : undef;
+    }
+
+    return unless $command->isa('TeX::Command');
+
+    my $class = ref($command);
+
+    if ($class =~ m{\A TeX::Primitive::}smx) {
+        return if $class !~ m{\A TeX::Primitive::texml::}smx;
+
+        return if $MEMOIZABLE_PRIMITIVE{$class};
+    }
+
+    return $class;
+}
+
+## Takes CODE refs, as passed to define_csname() or
+## define_pseudo_macro(), or TeX::Command classes.
+
+sub allow_memoization {
+    my $tex = shift;
+
+    for my $command (@_) {
+        my $key = ref($command) eq 'CODE' ? refaddr($command) : $command;
+
+        $memoizable_of{ident $tex}->{$key} = 1;
+    }
+
+    return;
+}
+
+sub note_perl_command {
+    my $tex = shift;
+
+    my $command = shift;
+
+    my $ident = ident $tex;
+
+    return unless $memoize_fragments_of{$ident};
+
+    my $key = __memoization_key($command);
+
+    return unless defined $key;
+
+    $side_effects_of{$ident}++ unless $memoizable_of{$ident}->{$key};
+
+    return;
+}
+
+## The state outside eqtb that safe Perl commands look at.  Subclasses
+## that give such commands state of their own add it here.
+
+sub memoization_context {
+    my $tex = shift;
+
+    return join "\x{0}", "xml", $tex->get_xml_stacks();
+}
+
+## Called by get_csname() and get_active_char() while a conversion is
+## being recorded.  EQVTs are noted by __record_eqvt_reads(), but a
+## lookup that finds nothing (or something other than an EQVT) has to
+## be remembered by name.
+
+sub __note_fragment_read {
+    my $reads = shift;
+
+    my $type = shift;
+    my $name = shift;
+    my $eqvt = shift;
+
+    if (ref($eqvt) eq 'TeX::Interpreter::EQVT') {
+        $reads->{eqvts}->{refaddr($eqvt)} = $eqvt;
+    } else {
+        $reads->{$type}->{$name} = $eqvt;
+    }
+
+    return;
+}
+
+## Runs $code with EQVT's accessors replaced by versions that also note
+## the EQVT in $reads.  This way eqtb lookups cost nothing extra when
+## no conversion is being recorded.
+
+sub __record_eqvt_reads {
+    my $reads = shift;
+    my $code  = shift;
+
+    my $get_equiv = \&TeX::Interpreter::EQVT::get_equiv;
+    my $kind      = \&TeX::Interpreter::EQVT::kind;
+
+    my $eqvts = $reads->{eqvts};
 
-    $tex->finish_extensions();
+    no warnings 'redefine';
 
-    # stat if tracing_stats > 0 then @<Output statistics about this job@>; stats
+    local *TeX::Interpreter::EQVT::get_equiv = sub {
+        $eqvts->{refaddr($_[0])} = $_[0];
 
-    $tex->finish_output_file();
+        return $get_equiv->($_[0]);
+    };
 
-    $tex->final_cleanup();       # { prepare for death }
+    local *TeX::Interpreter::EQVT::kind = sub {
+        $eqvts->{refaddr($_[0])} = $_[0];
 
-    if ($tex->log_opened()) {
-        $tex->wlog_cr();
+        return $kind->($_[0]);
+    };
 
-        my $log_file = $tex->get_log_file();
+    return $code->();
+}
 
-        close($log_file);
+## A conversion that was recorded or found in the cache while another
+## one was being recorded depends on the same things the inner one did.
 
-        $tex->set_log_file(undef);
+sub __merge_fragment_reads {
+    my $outer = shift;
+    my $inner = shift;
 
-        my $selector = $tex->selector() - 2;
+    my $eqvts = $inner->{eqvts};
 
-        $tex->set_selector($selector);
+    for my $eqvt (ref($eqvts) eq 'HASH' ? values %{ $eqvts } : @{ $eqvts }) {
+        $outer->{eqvts}->{refaddr($eqvt)} = $eqvt;
+    }
 
-        if ($selector == term_only) {
-            $tex->print_nl("Transcript written on ");
-            $tex->slow_print($tex->get_log_name());
-            $tex->print_char(".");
-            $tex->print_ln(); # Where is this in tex.web?
+    for my $type (qw(csname active)) {
+        while (my ($name, $meaning) = each %{ $inner->{$type} }) {
+            $outer->{$type}->{$name} = $meaning;
         }
     }
 
-    STDOUT->flush();
-    STDERR->flush();
-
     return;
 }
 
-sub final_cleanup {
+sub __fragment_cache_key {
     my $tex = shift;
 
-    my $open_parens = $tex->open_parens();
+    my $input    = shift;
+    my $par_tags = shift;
+    my $context  = shift;
 
-    while ($open_parens > 0) {
-        $tex->print(" )");
+    my @key = ($catcode_state_of{ident $tex},
+               $tex->get_cur_mode(),
+               $tex->is_unicode_input() ? 1 : 0,
+               $par_tags ? 1 : 0,
+               $context);
 
-        $open_parens--;
-    }
+    if (ref $input) {
+        for my $token ($input->get_tokens()) {
+            my $catcode = $token->get_catcode();
 
-    $tex->print_ln();
+            ## Anonymous tokens are only identified by their addresses.
 
-    $tex->set_open_parens(0);
+            return if $catcode == CATCODE_ANONYMOUS;
 
-    if ( (my $cur_level = $tex->cur_level()) > level_one ) {
-        $tex->print_nl("(");
-        $tex->print_esc("end occurred ");
-        $tex->print("inside a group at level ");
-        $tex->print_int($cur_level - level_one);
-        $tex->print_char(")");
+            push @key, $catcode . " " . $token->get_datum();
+        }
+    } else {
+        push @key, "string", $input;
     }
 
-    $tex->check_cond_stack();
+    return join "\x{0}", @key;
+}
+
+## An entry is dead once one of its EQVTs has been freed.
+
+sub __is_dead_fragment_entry {
+    my $entry = shift;
+
+    for my $eqvt (@{ $entry->{eqvts} }) {
+        return 1 unless defined $eqvt;
+    }
 
     return;
 }
 
-sub check_cond_stack {
+sub __is_current_fragment_entry {
     my $tex = shift;
 
-    # $tex->print_nl("*** Checking cond stack");
+    my $entry = shift;
 
-    while (my $ptr = $tex->get_cond_ptr()) {
-        my $if_limit = $ptr->if_limit();
-        my $if_line  = $ptr->if_line();
-        my $cur_if   = $ptr->get_cur_if();
+    my $ident = ident $tex;
 
-        $tex->print_nl("(");
-        $tex->print_esc("end occurred ");
-        $tex->print("when ");
-        # $tex->print_cmd_chr($if_limit);
-        $tex->print_esc($cur_if->get_csname());
+    for my $eqvt (@{ $entry->{eqvts} }) {
+        return if $eqvt->is_stale();
+    }
 
-        if ($if_line != 0) {
-            print(" on line ");
-            $tex->print_int($if_line);
+    while (my ($csname, $meaning) = each %{ $entry->{csname} }) {
+        if ((refaddr($csnames_of{$ident}->{$csname}) // 0) != (refaddr($meaning) // 0)) {
+            keys %{ $entry->{csname} }; # reset the iterator
+
+            return;
         }
+    }
 
-        $tex->print(" was incomplete)");
+    while (my ($char, $meaning) = each %{ $entry->{active} }) {
+        if ((refaddr($active_chars_of{$ident}->{$char}) // 0) != (refaddr($meaning) // 0)) {
+            keys %{ $entry->{active} };
 
-        $tex->pop_cond_stack();
+            return;
+        }
     }
 
-    return;
+    return 1;
 }
 
-######################################################################
-##                                                                  ##
-##                  SPECIAL RECURSIVE MAIN_LOOPS                    ##
-##                                                                  ##
-######################################################################
+sub __find_fragment_cache_entry {
+    my $tex = shift;
 
-## These are used by perl code that needs to execute some TeX input
-## and then take control back.
+    my $key = shift;
 
-sub push_main_control {
-    my $tex = shift;
+    my $cache = $fragment_cache_of{ident $tex};
 
-    $tex->set_eof_hook(
-        sub {
-            my $tex = shift;
+    my $entries = $cache->{$key};
 
-            $tex->pop_main_control();
+    return unless defined $entries;
 
-            return;
-        });
+    @{ $entries } = grep { ! __is_dead_fragment_entry($_) } @{ $entries };
 
-    $tex->main_control();
+    if (! @{ $entries }) {
+        delete $cache->{$key};
+
+        return;
+    }
+
+    for my $entry (@{ $entries }) {
+        return $entry if $tex->__is_current_fragment_entry($entry);
+    }
 
     return;
 }
 
-sub pop_main_control {
+sub __sweep_fragment_cache {
     my $tex = shift;
 
-    $tex->back_input(POP_MAIN_CONTROL);
+    my $cache = $fragment_cache_of{ident $tex};
+
+    for my $key (keys %{ $cache }) {
+        my $entries = $cache->{$key};
+
+        @{ $entries } = grep { ! __is_dead_fragment_entry($_) } @{ $entries };
+
+        delete $cache->{$key} unless @{ $entries };
+    }
 
     return;
 }
 
-sub process_file {
+sub __add_fragment_cache_entry {
     my $tex = shift;
 
-    my $file_spec = shift;
-    my $fh        = shift;
+    my $key      = shift;
+    my $fragment = shift;
+    my $reads    = shift;
 
-    my $start_time = time();
+    my $ident = ident $tex;
 
-    $tex->start_input($file_spec, $fh);
+    my @eqvts = grep { ! $_->is_stale() } values %{ $reads->{eqvts} };
 
-    $tex->push_main_control();
+    weaken($_) for @eqvts;
+
+    push @{ $fragment_cache_of{$ident}->{$key} }, {
+        fragment => $fragment->cloneNode(1),
+        eqvts    => \@eqvts,
+        csname   => $reads->{csname},
+        active   => $reads->{active},
+    };
+
+    if (++$fragment_cache_additions_of{$ident} >= FRAGMENT_CACHE_SWEEP) {
+        $tex->__sweep_fragment_cache();
+
+        $fragment_cache_additions_of{$ident} = 0;
+    }
 
     return;
 }
 
-sub process_string {
+sub __memoize_conversion {
     my $tex = shift;
 
-    my $string = shift;
+    my $input    = shift;
+    my $par_tags = shift;
+    my $convert  = shift;
 
-    return unless defined $string;
+    my $context = $tex->memoization_context();
 
-    $tex->begin_string_reading($string);
+    my $key = $tex->__fragment_cache_key($input, $par_tags, $context);
 
-    $tex->push_main_control();
+    my $ident = ident $tex;
 
-    return;
-}
+    my $outer_reads = $fragment_reads_of{$ident};
 
-sub read_package_data {
-    my $tex = shift;
+    if (! defined $key) {
+        $fragment_cache_uncacheable_of{$ident}++;
 
-    my $package = caller;
+        return $convert->();
+    }
 
-    my $stash = eval { no strict 'refs'; *{ "${package}::" } };
+    if (defined(my $entry = $tex->__find_fragment_cache_entry($key))) {
+        $fragment_cache_hits_of{$ident}++;
 
-    my $data_handle = *{ $stash->{DATA} }{IO};
+        __merge_fragment_reads($outer_reads, $entry) if defined $outer_reads;
 
-    my $position = tell($data_handle);
+        return $entry->{fragment}->cloneNode(1);
+    }
 
-    my $at_cat = $tex->get_catcode(ord('@'));
+    my $catcode_state = $catcode_state_of{$ident};
+    my $side_effects  = $side_effects_of{$ident};
 
-    $tex->set_catcode(ord('@'), CATCODE_LETTER);
+    my $reads = { eqvts => {}, csname => {}, active => {} };
 
-    $tex->start_input($package, $data_handle);
+    my $fragment = do {
+        local $fragment_reads_of{$ident} = $reads;
 
-    $tex->push_main_control();
+        __record_eqvt_reads($reads, $convert);
+    };
 
-    $tex->set_catcode(ord('@'), $at_cat);
+    if ($side_effects_of{$ident} == $side_effects
+        && $tex->memoization_context() eq $context) {
+        $fragment_cache_misses_of{$ident}++;
 
-    seek($data_handle, $position, SEEK_SET);
+        $tex->__add_fragment_cache_entry($key, $fragment, $reads);
 
-    return;
+        $catcode_state_of{$ident} = $catcode_state;
+    } else {
+        $fragment_cache_uncacheable_of{$ident}++;
+    }
+
+    __merge_fragment_reads($outer_reads, $reads) if defined $outer_reads;
+
+    return $fragment;
 }
 
-######################################################################
-##                                                                  ##
-##                      ALTERNATE ENTRY POINTS                      ##
-##                                                                  ##
-######################################################################
+sub report_fragment_cache {
+    my $tex = shift;
 
-## These are alternates to TeX().
+    return unless $tex->is_memoize_fragments();
 
-## Can these be replaced by \hbox and/or \boxtostring?
+    my $hits        = $tex->fragment_cache_hits();
+    my $misses      = $tex->fragment_cache_misses();
+    my $uncacheable = $tex->fragment_cache_uncacheable();
+
+    my $total = $hits + $misses + $uncacheable;
+
+    my $rate = $total ? sprintf("%.1f", 100 * $hits / $total) : "0.0";
+
+    $tex->wlog_cr();
+    $tex->wlog_ln("Fragment cache: $total conversions, $hits hits ($rate%), $misses misses, $uncacheable not cacheable");
+
+    return;
+}
 
 sub convert_token_list {
     my $tex = shift;
@@ -11424,6 +13356,22 @@ sub convert_token_list {
         $token_list = $tex->read_undelimited_parameter();
     }
 
+    if ($memoize_fragments_of{ident $tex} && ! $no_group) {
+        return $tex->__memoize_conversion($token_list, $par_tags,
+            sub { $tex->__convert_token_list($token_list, $par_tags) });
+    }
+
+    return $tex->__convert_token_list($token_list, $par_tags, $no_group);
+}
+
+sub __convert_token_list {
+    my $tex = shift;
+
+    my $token_list = shift;
+    my $par_tags   = shift;
+
+    my $no_group = shift;
+
     $token_list->push(POP_MAIN_CONTROL); ## BLEAH: modifies caller's copy
                                          ## (But we remove it below.)
 
@@ -11469,6 +13417,22 @@ sub convert_fragment {
 
     my $no_group = shift;
 
+    if ($memoize_fragments_of{ident $tex} && ! $no_group) {
+        return $tex->__memoize_conversion($string, $par_tags,
+            sub { $tex->__convert_fragment($string, $par_tags) });
+    }
+
+    return $tex->__convert_fragment($string, $par_tags, $no_group);
+}
+
+sub __convert_fragment {
+    my $tex = shift;
+
+    my $string   = shift;
+    my $par_tags = shift;
+
+    my $no_group = shift;
+
     $tex->push_output("TeX::Output::XML::Fragment");
 
     $tex->begingroup() unless $no_group;
@@ -11533,8 +13497,20 @@ sub do_file_output {
 
     my $node = shift;
 
+    my $ident = ident $tex;
+
+    $side_effects_of{$ident}++;
+
     my $fileno = $node->fileno();
 
+    ## \write's to the terminal and log file are recorded by print_char().
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        if (! eval { $node->is_write_node() } || $tex->get_write_open($fileno)) {
+            $package_data->note_opaque("file output");
+        }
+    }
+
     if (eval { $node->is_write_node() }) {
         $tex->write_out($node);
 
@@ -11930,6 +13906,8 @@ sub install_misc_extensions {
 
 my %xml_tag_parameters_of :HASH(:name<xml_tag_parameter>);
 
+$EQTB_TABLES{xml_tag_parameter} = \%xml_tag_parameters_of;
+
 my %xml_stack_of :ARRAY(:name<xml_stack>);
 
 sub __list_xml_extensions {
@@ -12148,62 +14126,133 @@ sub import_xml_fragment {
 
 my %css_rules_of :ARRAY(:name<css_rule>);
 
-my %css_classes_of   :HASH(:name<css_class> :gethash<get_css_classes> :sethash<set_css_classes>);
+my %css_classes_of   :HASH(:name<css_class> :gethash<get_css_classes> :sethash<set_css_classes>);
+
+my %css_class_ctr_of :HASH(:name<css_class_ctr>);
+
+sub __make_class_name :PRIVATE {
+    my $tex = shift;
+
+    my $ident = ident $tex;
+
+    my $property = shift;
+    my $value    = shift;
+
+    my $prefix = join "", map { substr($_, 0, 1) } split /-/, $property;
+
+    if ($value =~ m{^[a-z]}i) {
+        $prefix .= join "", map { substr($_, 0, 1) } split / /, $value;
+    }
+
+    $css_class_ctr_of{$ident}->{$prefix} ||= 0;
+
+    my $gen = $css_class_ctr_of{$ident}->{$prefix}++;
+
+    $gen = "" if $gen == 0;
+
+    my $css_class = "${prefix}${gen}";
+
+    return "texml-$css_class";
+}
+
+sub find_css_class {
+    my $tex = shift;
+
+    my $property = shift;
+    my $value    = shift;
+
+    my $key = qq{${property}: $value};
+
+    my $css_class = $tex->get_css_class($key);
+
+    return $css_class if nonempty($css_class);
+
+    $css_class = $tex->__make_class_name($property, $value);
+
+    $tex->add_css_rule([ ".$css_class", $key ]);
+
+    $tex->set_css_class($key, $css_class);
+
+    return $css_class;
+}
+
+######################################################################
+##                                                                  ##
+##                           DEFINITIONS                            ##
+##                                                                  ##
+######################################################################
+
+sub get_csname {
+    my $tex = shift;
+
+    my $csname = shift;
+
+    my $ident = ident $tex;
+
+    my $eqvt = $csnames_of{$ident}->{$csname};
+
+    if (! defined $eqvt && defined $lazy_csnames_of{$ident}) {
+        $eqvt = $tex->__undump_lazy_csname($csname);
+    }
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_read(csname => $csname, $eqvt);
+    }
+
+    if (defined(my $reads = $fragment_reads_of{$ident})) {
+        __note_fragment_read($reads, csname => $csname, $eqvt);
+    }
+
+    ## Always return a scalar: callers use get_csname() in list
+    ## context.
+
+    return $eqvt;
+}
 
-my %css_class_ctr_of :HASH(:name<css_class_ctr>);
+## All of the control sequences, including any that a lazy snapshot
+## hasn't installed yet.
 
-sub __make_class_name :PRIVATE {
+sub get_csnames {
     my $tex = shift;
 
     my $ident = ident $tex;
 
-    my $property = shift;
-    my $value    = shift;
-
-    my $prefix = join "", map { substr($_, 0, 1) } split /-/, $property;
+    if (defined(my $snapshot = $lazy_csnames_of{$ident})) {
+        $snapshot->for_each_csname(sub {
+            my $csname = shift;
 
-    if ($value =~ m{^[a-z]}i) {
-        $prefix .= join "", map { substr($_, 0, 1) } split / /, $value;
+            if ($snapshot->has_csname($csname)) {
+                $tex->__undump_lazy_csname($csname);
+            }
+        });
     }
 
-    $css_class_ctr_of{$ident}->{$prefix} ||= 0;
-
-    my $gen = $css_class_ctr_of{$ident}->{$prefix}++;
-
-    $gen = "" if $gen == 0;
-
-    my $css_class = "${prefix}${gen}";
+    my %csnames = %{ $csnames_of{$ident} };
 
-    return "texml-$css_class";
+    return wantarray ? %csnames : \%csnames;
 }
 
-sub find_css_class {
-    my $tex = shift;
+## First reference to a control sequence from a lazy snapshot: install
+## it at level one, just as undump_eqtb() would have.
 
-    my $property = shift;
-    my $value    = shift;
+sub __undump_lazy_csname {
+    my $tex = shift;
 
-    my $key = qq{${property}: $value};
+    my $csname = shift;
 
-    my $css_class = $tex->get_css_class($key);
+    my $ident = ident $tex;
 
-    return $css_class if nonempty($css_class);
+    my $record = $lazy_csnames_of{$ident}->take_csname_record($csname);
 
-    $css_class = $tex->__make_class_name($property, $value);
+    return unless defined $record;
 
-    $tex->add_css_rule([ ".$css_class", $key ]);
+    my $meaning = $tex->unpack_meaning($record, $csname);
 
-    $tex->set_css_class($key, $css_class);
+    return unless defined $meaning;
 
-    return $css_class;
+    return $csnames_of{$ident}->{$csname} = make_eqvt($meaning, level_one);
 }
 
-######################################################################
-##                                                                  ##
-##                           DEFINITIONS                            ##
-##                                                                  ##
-######################################################################
-
 sub define_csname {
     my $tex = shift;
 
@@ -12211,6 +14260,14 @@ sub define_csname {
     my $command  = shift;
     my $modifier = shift;
 
+    ## Make sure eq_define() saves the right value.
+
+    $tex->get_csname($csname) if defined $lazy_csnames_of{ident $tex};
+
+    if (defined(my $package_data = $package_data_of{ident $tex})) {
+        $tex->__record_definition($package_data, csname => $csname, $command, $modifier);
+    }
+
     $tex->eq_define(\$csnames_of{ident $tex}->{$csname}, $command, $modifier);
 
     return;
@@ -12234,6 +14291,12 @@ sub let_csname {
         $equiv = UNDEFINED_CS;
     }
 
+    $tex->get_csname($dst_csname) if defined $lazy_csnames_of{ident $tex};
+
+    if (defined(my $package_data = $package_data_of{ident $tex})) {
+        $tex->__record_definition($package_data, csname => $dst_csname, $equiv, $modifier);
+    }
+
     my $eqvt_ptr = \$csnames_of{ident $tex}->{$dst_csname};
 
     $tex->eq_define($eqvt_ptr, $equiv, $modifier);
@@ -12285,6 +14348,10 @@ sub define_active_char {
     my $command  = shift;
     my $modifier = shift;
 
+    if (defined(my $package_data = $package_data_of{ident $tex})) {
+        $tex->__record_definition($package_data, active => $char, $command, $modifier);
+    }
+
     $tex->eq_define(\$active_chars_of{ident $tex}->{$char}, $command, $modifier);
 
     return;
@@ -12383,14 +14450,77 @@ sub get_meaning {
     return $eqvt->get_equiv();
 }
 
+## Like get_meaning(), but returns the kind of the meaning as well
+## (see meaning_kind()).  A character token is its own meaning.
+
+sub get_meaning_and_kind {
+    my $tex = shift;
+
+    my $token = shift;
+
+    my $catcode = $token->get_catcode();
+
+    my $datum = $token->get_datum();
+
+    if ($catcode == CATCODE_ANONYMOUS) {
+        return ($datum, meaning_kind($datum));
+    }
+
+    my $eqvt;
+
+    if ($catcode == CATCODE_ACTIVE) {
+        $eqvt = $tex->get_active_char($datum);
+    } elsif ($catcode == CATCODE_CSNAME) {
+        $eqvt = $tex->get_csname($datum);
+    } else {
+        return ($token, KIND_TOKEN);
+    }
+
+    return (undef, KIND_UNDEFINED) unless defined $eqvt;
+
+    return ($eqvt->get_equiv(), $eqvt->kind());
+}
+
+## get_meaning() for a token that is only being looked at in passing,
+## e.g., to see whether it's \outer, rather than acted on.  The
+## difference only matters while recording package data.
+
+sub peek_meaning {
+    my $tex = shift;
+
+    my $token = shift;
+
+    my ($meaning) = $tex->peek_meaning_and_kind($token);
+
+    return $meaning;
+}
+
+sub peek_meaning_and_kind {
+    my $tex = shift;
+
+    my $token = shift;
+
+    my $package_data = $package_data_of{ident $tex};
+
+    return $tex->get_meaning_and_kind($token) unless defined $package_data;
+
+    $package_data->set_peeking(true);
+
+    my @meaning = $tex->get_meaning_and_kind($token);
+
+    $package_data->set_peeking(false);
+
+    return @meaning;
+}
+
 sub get_expandable_meaning {
     my $tex = shift;
 
     my $token = shift;
 
-    my $cur_cmd = $tex->get_meaning($token);
+    my ($cur_cmd, $kind) = $tex->get_meaning_and_kind($token);
 
-    return $cur_cmd if eval { $cur_cmd->isa('TeX::Command::Expandable') };
+    return $cur_cmd if $kind == KIND_MACRO || $kind == KIND_EXPANDABLE;
 
     return;
 }
@@ -12629,7 +14759,74 @@ sub set_catcode {
 
     my $table = $cat_codes_of{ident $tex};
 
-    return $tex->set_character_code($table, $char_code, $cat_code, $modifier);
+    $tex->set_character_code($table, $char_code, $cat_code, $modifier);
+
+    $tex->uncache_catcode($char_code);
+
+    return;
+}
+
+## lexer_catcode() is get_catcode() for the lexer: it consults the
+## cache first and only goes to eqtb for characters it hasn't seen
+## since their catcode last changed.
+
+sub lexer_catcode {
+    my $tex = shift;
+
+    my $char_code = shift;
+
+    my $ident = ident $tex;
+
+    my $catcode = $char_code < 256 ? vec($catcode_vector_of{$ident}, $char_code, 8)
+                                   : $wide_catcodes_of{$ident}->{$char_code};
+
+    return $catcode if defined $catcode && $catcode != CATCODE_UNCACHED;
+
+    $catcode = $tex->get_catcode($char_code);
+
+    my $slot = \$cat_codes_of{$ident}->{$char_code};
+
+    $catcode_slots_of{$ident}->{ident $slot} = $char_code;
+
+    if ($char_code < 256) {
+        vec($catcode_vector_of{$ident}, $char_code, 8) = $catcode;
+    } else {
+        $wide_catcodes_of{$ident}->{$char_code} = $catcode;
+    }
+
+    return $catcode;
+}
+
+sub uncache_catcode {
+    my $tex = shift;
+
+    my $char_code = shift;
+
+    my $ident = ident $tex;
+
+    if ($char_code < 256) {
+        vec($catcode_vector_of{$ident}, $char_code, 8) = CATCODE_UNCACHED;
+    } else {
+        delete $wide_catcodes_of{$ident}->{$char_code};
+    }
+
+    $catcode_state_of{$ident} = ++$last_catcode_state_of{$ident};
+
+    return;
+}
+
+sub reset_catcode_cache {
+    my $tex = shift;
+
+    my $ident = ident $tex;
+
+    $catcode_vector_of{$ident} = chr(CATCODE_UNCACHED) x 256;
+    $wide_catcodes_of{$ident}  = {};
+    $catcode_slots_of{$ident}  = {};
+
+    $catcode_state_of{$ident} = ++$last_catcode_state_of{$ident};
+
+    return;
 }
 
 sub get_lccode {
@@ -12637,7 +14834,13 @@ sub get_lccode {
 
     my $char_code = shift;
 
-    my $table = $lc_codes_of{ident $tex};
+    my $ident = ident $tex;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_code_read(lc_code => $char_code);
+    }
+
+    my $table = $lc_codes_of{$ident};
 
     return $tex->get_character_code($table, $char_code);
 }
@@ -12661,7 +14864,13 @@ sub get_uccode {
 
     my $char_code = shift;
 
-    my $table = $uc_codes_of{ident $tex};
+    my $ident = ident $tex;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_code_read(uc_code => $char_code);
+    }
+
+    my $table = $uc_codes_of{$ident};
 
     return $tex->get_character_code($table, $char_code);
 }
@@ -12683,7 +14892,13 @@ sub get_tccode {
 
     my $char_code = shift;
 
-    my $table = $tc_codes_of{ident $tex};
+    my $ident = ident $tex;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_code_read(tc_code => $char_code);
+    }
+
+    my $table = $tc_codes_of{$ident};
 
     return $tex->get_character_code($table, $char_code);
 }
@@ -12705,7 +14920,13 @@ sub get_sfcode {
 
     my $char_code = shift;
 
-    my $table = $sf_codes_of{ident $tex};
+    my $ident = ident $tex;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_code_read(sf_code => $char_code);
+    }
+
+    my $table = $sf_codes_of{$ident};
 
     return $tex->get_character_code($table, $char_code);
 }
@@ -12727,7 +14948,13 @@ sub get_mathcode {
 
     my $char_code = shift;
 
-    my $table = $math_codes_of{ident $tex};
+    my $ident = ident $tex;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_code_read(math_code => $char_code);
+    }
+
+    my $table = $math_codes_of{$ident};
 
     return $tex->get_character_code($table, $char_code);
 }
@@ -12749,7 +14976,13 @@ sub get_delcode {
 
     my $char_code = shift;
 
-    my $table = $del_codes_of{ident $tex};
+    my $ident = ident $tex;
+
+    if (defined(my $package_data = $package_data_of{$ident})) {
+        $package_data->note_code_read(del_code => $char_code);
+    }
+
+    my $table = $del_codes_of{$ident};
 
     return $tex->get_character_code($table, $char_code);
 }
@@ -14575,100 +16808,161 @@ sub package_load_notification {
 ##     FOO() to read FOO
 ##
 ## Currently the set_* methods do no type checking.  That should be fixed.
+##
+## These accessors are called all over the place, including the
+## innermost loops (get_next(), main_control(), etc.), so rather than
+## generate them afresh on every call, we install them as named subs
+## in the interpreter's class: all at once when the first interpreter
+## of a class is created and, for anything that didn't exist yet, the
+## first time AUTOMETHOD sees them.  After that, calling
+## $tex->end_line_char() costs no more than any other method call.
+##
+## Control sequence names that aren't parameters still go through
+## AUTOMETHOD every time, since their meanings can change.
 
-sub AUTOMETHOD {
-    my ($tex, $ident, @args) = @_;
+sub __make_special_accessors {
+    my $table = shift;
+    my $name  = shift;
 
-    my $subname = $_;   # Requested subroutine name is passed via $_
+    my $getter = sub {
+        return $table->{ident $_[0]}->{$name}->get_value();
+    };
 
-    if ($subname =~ s/^set_//) {
-        if (defined(my $eqvt = $tex->get_special_integer($subname))) {
-            return sub {
-                $eqvt->set_value($args[0]);
-            };
-        }
+    my $setter = sub {
+        $table->{ident $_[0]}->{$name}->set_value($_[1]);
+    };
 
-        if (defined(my $eqvt = $tex->get_special_dimen($subname))) {
-            return sub {
-                $eqvt->set_value($args[0]);
-            };
-        }
+    return ($getter, $setter);
+}
 
-        if (exists $integer_parameters_of{$ident}->{$subname}) {
-            return sub {
-                my $eqvt_ptr = \$integer_parameters_of{$ident}->{$subname};
+sub __make_eqtb_accessors {
+    my $table = shift;
+    my $name  = shift;
 
-                $tex->eq_define($eqvt_ptr, $args[0], $args[1]);
-            };
-        }
+    my $getter = sub {
+        my $equiv = $table->{ident $_[0]}->{$name}->get_equiv();
 
-        if (exists $dimen_parameters_of{$ident}->{$subname}) {
-            return sub {
-                my $eqvt_ptr = \$dimen_parameters_of{$ident}->{$subname};
+        return defined $equiv ? $equiv->get_value() : ();
+    };
 
-                $tex->eq_define($eqvt_ptr, $args[0], $args[1]);
-            };
-        }
+    my $setter = sub {
+        my $tex = shift;
 
-        if (exists $glue_parameters_of{$ident}->{$subname}) {
-            return sub {
-                my $eqvt_ptr = \$glue_parameters_of{$ident}->{$subname};
+        my $eqvt_ptr = \$table->{ident $tex}->{$name};
 
-                $tex->eq_define($eqvt_ptr, $args[0], $args[1]);
-            };
-        }
+        $tex->eq_define($eqvt_ptr, $_[0], $_[1]);
+    };
+
+    return ($getter, $setter);
+}
 
-        if (exists $xml_tag_parameters_of{$ident}->{$subname}) {
-            return sub {
-                my $eqvt_ptr = \$xml_tag_parameters_of{$ident}->{$subname};
+## In order of precedence.
 
-                $tex->eq_define($eqvt_ptr, $args[0], $args[1]);
-            };
-        }
-    } else {
-        if (defined(my $eqvt = $tex->get_special_integer($subname))) {
-            return sub {
-                return $eqvt->get_value();
-            };
-        }
+my @PARAMETER_TABLES = ([ \%special_integers_of,   \&__make_special_accessors ],
+                        [ \%special_dimens_of,     \&__make_special_accessors ],
+                        [ \%integer_parameters_of, \&__make_eqtb_accessors ],
+                        [ \%dimen_parameters_of,   \&__make_eqtb_accessors ],
+                        [ \%glue_parameters_of,    \&__make_eqtb_accessors ],
+                        [ \%xml_tag_parameters_of, \&__make_eqtb_accessors ]);
 
-        if (defined(my $eqvt = $tex->get_special_dimen($subname))) {
-            return sub {
-                return $eqvt->get_value();
-            };
-        }
+## Real methods always win, as they did when every parameter accessor
+## went through AUTOLOAD.  (We can't use can() here, since TeX::Class
+## makes it consult AUTOMETHOD.)
 
-        if (defined(my $eqvt = $tex->get_integer_parameter($subname))) {
-            return sub {
-                return $eqvt->get_equiv()->get_value();
-            };
-        }
+sub __has_method {
+    my $class  = shift;
+    my $method = shift;
 
-        if (defined (my $eqvt = $tex->get_dimen_parameter($subname))) {
-            return sub {
-                return $eqvt->get_equiv()->get_value();
-            };
-        }
+    no strict 'refs';
 
-        if (defined (my $eqvt = $tex->get_glue_parameter($subname))) {
-            return sub {
-                return $eqvt->get_equiv()->get_value();
-            };
-        }
+    for my $package (@{ mro::get_linear_isa($class) }) {
+        return 1 if defined &{ "${package}::${method}" };
+    }
+
+    return;
+}
 
-        if (defined (my $eqvt = $tex->get_xml_tag_parameter($subname))) {
-            return sub {
-                my $equiv = $eqvt->get_equiv();
+sub __install_accessor {
+    my $class  = shift;
+    my $method = shift;
+    my $code   = shift;
 
-                if (defined $equiv) {
-                    return $equiv->get_value();
-                }
+    return if __has_method($class, $method);
 
-                return;
-            };
+    no strict 'refs';
+
+    *{ "${class}::${method}" } = $code;
+
+    return;
+}
+
+## Returns the accessor for $method_name if it is a parameter accessor.
+
+sub __install_parameter_accessor {
+    my $tex = shift;
+
+    my $method_name = shift;
+
+    my $ident = ident $tex;
+
+    (my $name = $method_name) =~ s/^set_//;
+
+    for my $entry (@PARAMETER_TABLES) {
+        my ($table, $maker) = @{ $entry };
+
+        next unless exists $table->{$ident}->{$name};
+
+        my ($getter, $setter) = $maker->($table, $name);
+
+        __install_accessor(ref $tex, $name,       $getter);
+        __install_accessor(ref $tex, "set_$name", $setter);
+
+        return $name eq $method_name ? $getter : $setter;
+    }
+
+    return;
+}
+
+{
+    my %installed;
+
+    sub __install_parameter_accessors {
+        my $tex = shift;
+
+        my $class = ref $tex;
+
+        return if $installed{$class}++;
+
+        my $ident = ident $tex;
+
+        for my $entry (@PARAMETER_TABLES) {
+            my ($table, $maker) = @{ $entry };
+
+            for my $name (sort keys %{ $table->{$ident} || {} }) {
+                next if __has_method($class, $name);
+
+                my ($getter, $setter) = $maker->($table, $name);
+
+                __install_accessor($class, $name,       $getter);
+                __install_accessor($class, "set_$name", $setter);
+            }
         }
+
+        return;
+    }
+}
+
+sub AUTOMETHOD {
+    my ($tex, $ident, @args) = @_;
+
+    my $subname = $_;   # Requested subroutine name is passed via $_
+
+    if (defined(my $accessor = $tex->__install_parameter_accessor($subname))) {
+        return $accessor;
     }
 
+    $subname =~ s/^set_//;
+
     if (defined(my $eqvt = $tex->get_csname($subname))) {
         return sub {
             make_anonymous_token($eqvt);
@@ -288,6 +288,17 @@ sub write_out {
 my %section_stack_of :ARRAY(:name<section_stack>);
 my %toc_stack_of :ARRAY(:name<toc_stack>);
 
+## LTsect's and LTtoc's stack commands are safe to memoize (see
+## allow_memoization()) because the stacks are part of the context.
+
+sub memoization_context {
+    my $tex = shift;
+
+    return join "\x{0}", $tex->SUPER::memoization_context(),
+        "section", map({ @{ $_ } } $tex->get_section_stacks()),
+        "toc", $tex->get_toc_stacks();
+}
+
 ######################################################################
 ##                                                                  ##
 ##                          EXTRA METHODS                           ##
@@ -46,7 +46,7 @@ sub install {
 
     $tex->class_load_notification();
 
-    $tex->add_output_hook(\&move_drm);
+    $tex->add_output_hook(\&move_drm, 0, [ 'def-list[@content-type]' ]);
 
     $tex->read_package_data();
 
@@ -57,7 +57,8 @@ sub install {
 ## DRM notice in the right place.
 
 sub move_drm {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $dom = $xml->get_dom();
 
@@ -65,7 +66,7 @@ sub move_drm {
 
     return unless defined $drm;
 
-    my @tocs = $dom->findnodes(q{/descendant::def-list[starts-with(@content-type, "toc")]});
+    my @tocs = grep { $_->getAttribute('content-type') =~ m{^toc} } $nodes->{'def-list[@content-type]'}->@*;
 
     return unless @tocs;
 
@@ -221,7 +221,14 @@ sub install {
     } else {
         $tex->print_nl("Can't find private AMS modules: Disabling extended metadata support");
 
-        $tex->define_csname(AddAMSmetadata => sub {});
+        my $noop = sub {};
+
+        $tex->define_csname(AddAMSmetadata => $noop);
+
+        ## The full version changes the main document, so only this
+        ## one is safe to memoize.
+
+        $tex->allow_memoization($noop);
     }
 
     $tex->print_ln();
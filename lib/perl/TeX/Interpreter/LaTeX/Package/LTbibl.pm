@@ -51,7 +51,7 @@ sub install {
 
     $tex->add_output_hook(\&do_resolve_cites, 1); # Same level as do_resolve_xrefs
 
-    $tex->add_output_hook(\&do_sort_cites, 2);
+    $tex->add_output_hook(\&do_sort_cites, 2, [ qw(cite-group) ]);
 
     $tex->read_package_data();
 
@@ -137,17 +137,14 @@ sub do_resolve_cites {
 }
 
 sub do_sort_cites {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $tex = $xml->get_tex_engine();
 
     return unless $tex->if('TeXMLsortcites@');
 
-    my $handle = $tex->get_output_handle();
-
-    my $body = $handle->get_dom();
-
-    my @groups = $body->findnodes(qq{descendant::cite-group});
+    my @groups = $nodes->{'cite-group'}->@*;
 
     $tex->print_nl("Sorting cite groups");
 
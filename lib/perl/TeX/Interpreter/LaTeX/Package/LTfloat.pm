@@ -42,7 +42,7 @@ sub install {
 
     $tex->package_load_notification();
 
-    $tex->add_output_hook(\&normalize_figures);
+    $tex->add_output_hook(\&normalize_figures, 0, [ qw(fig-group|fig table-wrap-group|table-wrap) ]);
 
     $tex->read_package_data();
 
@@ -114,12 +114,17 @@ my sub __move_caption {
     return;
 }
 
+## Empty groups are renamed, so we ask for groups and their members
+## together and check the names as we go.
+
 sub normalize_figures {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
-    my $dom = $xml->get_dom();
+    my @fig_nodes   = $nodes->{'fig-group|fig'}->@*;
+    my @table_nodes = $nodes->{'table-wrap-group|table-wrap'}->@*;
 
-    for my $fig_group ($dom->findnodes("/descendant::fig-group")) {
+    for my $fig_group (grep { $_->nodeName() eq 'fig-group' } @fig_nodes) {
         __move_label($fig_group);
         __move_caption($fig_group);
 
@@ -138,7 +143,7 @@ sub normalize_figures {
         }
     }
 
-    for my $fig ($dom->findnodes("/descendant::fig")) {
+    for my $fig (grep { $_->nodeName() eq 'fig' } @fig_nodes) {
         __move_label($fig);
         __move_caption($fig);
 
@@ -147,7 +152,7 @@ sub normalize_figures {
         # print STDERR "*** finalize_document: Found node '$name'\n";
     }
 
-    for my $table_group ($dom->findnodes("/descendant::table-wrap-group")) {
+    for my $table_group (grep { $_->nodeName() eq 'table-wrap-group' } @table_nodes) {
         __move_label($table_group);
         __move_caption($table_group);
 
@@ -166,7 +171,7 @@ sub normalize_figures {
         }
     }
 
-    for my $table ($dom->findnodes("/descendant::table-wrap")) {
+    for my $table (grep { $_->nodeName() eq 'table-wrap' } @table_nodes) {
         __move_label($table);
         __move_caption($table);
     }
@@ -56,7 +56,7 @@ sub install  {
 
     $tex->add_output_hook(\&do_resolve_xrefs, 1);
 
-    $tex->add_output_hook(\&do_resolve_ref_ranges, 9);
+    $tex->add_output_hook(\&do_resolve_ref_ranges, 9, [ qw(xref-group) ]);
 
     $tex->read_package_data();
 
@@ -120,7 +120,7 @@ sub do_resolve_xrefs {
                     my ($xml_id, $ref_type) = parse_ref_record($r);
 
                     if (nonempty($xml_id)) {
-                        $xref->setAttribute(rid => $xml_id);
+                        $xml->set_element_attribute($xref, rid => $xml_id);
                         $xref->setAttribute('specific-use' => $ref_cmd);
                         $xref->setAttribute('ref-type' => $ref_type);
                         $xref->removeAttribute('ref-key');
@@ -137,12 +137,12 @@ sub do_resolve_xrefs {
                     my ($xml_id, $ref_type) = parse_ref_record($r);
 
                     if (nonempty($xml_id)) {
-                        $xref->setAttribute(rid => $xml_id);
+                        $xml->set_element_attribute($xref, rid => $xml_id);
                         $xref->setAttribute('specific-use' => $ref_cmd);
                         $xref->setAttribute('ref-type' => $ref_type);
                         $xref->removeAttribute('ref-key');
 
-                        my ($title) = $body->findnodes(qq{//*[\@id="$xml_id"]/title});
+                        my ($title) = $xml->get_element_by_id($xml_id)->findnodes("title");
 
                         for my $node ($title->childNodes()) {
                             $xref->appendChild($node->cloneNode(1));
@@ -193,16 +193,13 @@ sub do_resolve_xrefs {
 }
 
 sub do_resolve_ref_ranges {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $tex = $xml->get_tex_engine();
 
     return unless $tex->if('TeXML@resolveXMLxrefgroups@');
 
-    my $handle = $tex->get_output_handle();
-
-    my $body = $handle->get_dom();
-
     $tex->print_nl("Resolving <xref-group>s");
     $tex->print_ln();
 
@@ -211,7 +208,7 @@ sub do_resolve_ref_ranges {
     $tex->let_csname('start@xref@group' => '@empty');
     $tex->let_csname('end@xref@group' => '@empty');
 
-    for my $group ($body->findnodes(qq{descendant::xref-group})) {
+    for my $group ($nodes->{'xref-group'}->@*) {
         my $first = $group->getAttribute('first');
         my $last  = $group->getAttribute('last');
 
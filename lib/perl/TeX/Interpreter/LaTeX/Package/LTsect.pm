@@ -40,6 +40,13 @@ use TeX::TokenList qw(:factories);
 use TeX::Utils::Misc qw(nonempty);
 use TeX::Utils::XML;
 
+## add_section_alt_titles() only reads the titles, so it selects them
+## rather than the whole section.  That lets TeX::Output::XML::Stream
+## spool a section without waiting for the xrefs in its body to be
+## resolved.
+
+use constant SECTION_TITLES => "sec/title|sec/subtitle|app/title|app/subtitle";
+
 my sub add_toc_alt_titles;
 my sub add_section_alt_titles;
 my sub add_title_group_alt_titles;
@@ -57,14 +64,18 @@ sub install  {
 
     ## These need to run after LTref's output hooks.
 
-    $tex->add_output_hook(\&add_toc_alt_titles, 10);
-    $tex->add_output_hook(\&add_section_alt_titles, 10);
-    $tex->add_output_hook(\&add_title_group_alt_titles, 10);
+    $tex->add_output_hook(\&add_toc_alt_titles,         10, [ qw(toc-entry) ]);
+    $tex->add_output_hook(\&add_section_alt_titles,     10, [ SECTION_TITLES ]);
+    $tex->add_output_hook(\&add_title_group_alt_titles, 10, [ qw(book-title-group|title-group) ]);
 
     $tex->define_csname('@push@sectionstack'      => \&do_push_section_stack);
     $tex->define_pseudo_macro('@pop@sectionstack' => \&do_pop_section_stack);
     $tex->define_csname('@clear@sectionstack'     => \&do_clear_section_stack);
 
+    $tex->allow_memoization(\&do_push_section_stack,
+                            \&do_pop_section_stack,
+                            \&do_clear_section_stack);
+
     $tex->read_package_data();
 
     return;
@@ -196,11 +207,12 @@ my sub add_alt_title {
 }
 
 sub add_toc_alt_titles {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $dom = $xml->get_dom();
 
-    for my $toc_entry ($dom->findnodes("/descendant::toc-entry")) {
+    for my $toc_entry ($nodes->{'toc-entry'}->@*) {
         add_alt_title($toc_entry, $dom);
     }
 
@@ -208,11 +220,18 @@ sub add_toc_alt_titles {
 }
 
 sub add_section_alt_titles {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $dom = $xml->get_dom();
 
-    for my $section ($dom->findnodes("/descendant::sec|/descendant::app")) {
+    my %seen;
+
+    for my $title ($nodes->{+SECTION_TITLES}->@*) {
+        my $section = $title->parentNode();
+
+        next if $seen{ $section->unique_key() }++;
+
         add_alt_title($section, $dom);
     }
 
@@ -220,11 +239,12 @@ sub add_section_alt_titles {
 }
 
 sub add_title_group_alt_titles {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $dom = $xml->get_dom();
 
-    for my $title_group ($dom->findnodes("/descendant::book-title-group|/descendant::title-group")) {
+    for my $title_group ($nodes->{'book-title-group|title-group'}->@*) {
         add_alt_title($title_group, $dom);
     }
 
@@ -71,6 +71,10 @@ sub install {
     $tex->define_pseudo_macro('@pop@tocstack' => \&do_pop_toc_stack);
     $tex->define_csname('@clear@tocstack'     => \&do_clear_toc_stack);
 
+    $tex->allow_memoization(\&do_push_toc_stack,
+                            \&do_pop_toc_stack,
+                            \&do_clear_toc_stack);
+
     return;
 }
 
@@ -147,11 +151,7 @@ my sub do_label_toc_entries {
     for my $entry (@toc_entries) {
         if (my @nav_ptrs = $entry->findnodes(qq{child::nav-pointer})) {
             if (nonempty(my $rid = $nav_ptrs[0]->getAttribute('rid'))) {
-                ## Can't use getElementById without DTD validation.
-
-                # my $target = $dom->getElementById($rid);
-
-                my ($target) = $dom->findnodes("/descendant::*[\@id='$rid']");
+                my $target = $handle->get_element_by_id($rid);
 
                 if (defined($target)) {
                     if (nonempty(my $type = $target->getAttribute('specific-use'))) {
@@ -202,11 +202,9 @@ EOF
 
     my $handle = $tex->get_output_handle();
 
-    my $body = $handle->get_dom();
+    my @toc_list = $handle->get_elements_by_id($xml_id);
 
-    my $toc_list = $body->findnodes(qq{//*[\@id='$xml_id']});
-
-    my $num_found = $toc_list->size();
+    my $num_found = @toc_list;
 
     if ($num_found == 0) {
         $tex->print_err("Unable to finish TOC $type: can't find XML element '$xml_id'");
@@ -222,7 +220,7 @@ EOF
         $tex->error();
     }
 
-    my $toc = $toc_list->get_node(0);
+    my $toc = $toc_list[0];
 
     $toc->appendChild($new);
 
@@ -262,11 +260,9 @@ EOF
 
     my $handle = $tex->get_output_handle();
 
-    my $body = $handle->get_dom();
-
-    my $toc_list = $body->findnodes(qq{//*[\@id='$xml_id']});
+    my @toc_list = $handle->get_elements_by_id($xml_id);
 
-    my $num_found = $toc_list->size();
+    my $num_found = @toc_list;
 
     if ($num_found == 0) {
         $tex->print_err("Unable to finish TOC $type: can't find XML element '$xml_id'");
@@ -282,7 +278,7 @@ EOF
         $tex->error();
     }
 
-    my $toc = $toc_list->get_node(0);
+    my $toc = $toc_list[0];
 
     $toc->lastChild->appendChild($new);
 
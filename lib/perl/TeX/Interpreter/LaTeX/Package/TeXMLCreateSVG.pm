@@ -57,6 +57,8 @@ sub install {
 
     $tex->define_pseudo_macro('TeXMLCreateSVG' => \&do_texml_create_svg);
 
+    $tex->add_output_hook(\&resolve_queued_svgs, 0, [ qw(graphic|inline-graphic) ]);
+
     return;
 }
 
@@ -126,7 +128,22 @@ sub do_texml_create_svg {
 
     my $regenerate = $tex->do_svg();
 
-    if (-e $out_file) {
+    my $svg = $regenerate ? $tex->get_svg_agent() : undef;
+
+    if ($scale_factor != 1) {
+        $tex_fragment = qq{\\scalebox{$scale_factor}{$tex_fragment}};
+    }
+
+    ## The SVG cache knows exactly what went into each SVG, so if it's
+    ## available we trust it rather than comparing timestamps.
+
+    if (defined $svg && $svg->use_cache()) {
+        if ($svg->fetch_cached($tex_fragment, $id, $tex, $starred, $out_file)) {
+            $tex->print_nl("Found $out_file in the SVG cache.  Not regenerating.");
+
+            $regenerate = 0;
+        }
+    } elsif (-e $out_file) {
         my $tex_file = $tex->get_file_name();
 
         my $m_in  = file_mtime($tex_file);
@@ -140,10 +157,15 @@ sub do_texml_create_svg {
     }
 
     if ($regenerate) {
-        my $svg = $tex->get_svg_agent();
+        ## Normally the SVG is rendered in the background (see
+        ## TeX::Utils::SVG), so there's no file for \includegraphics
+        ## to look at yet.  \TeXMLqueuedSVG leaves room for it and
+        ## resolve_queued_svgs() fills in the details.
+
+        if ($svg->is_deferred()) {
+            $svg->queue_tex($tex_fragment, $id, $tex, $starred, $out_file);
 
-        if ($scale_factor != 1) {
-            $tex_fragment = qq{\\scalebox{$scale_factor}{$tex_fragment}};
+            return $tex->tokenize(qq{\\TeXMLqueuedSVG{$out_file}});
         }
 
         my $svg_file = $svg->convert_tex($tex_fragment, $id, $tex, $starred);
@@ -170,6 +192,58 @@ sub do_texml_create_svg {
     return $tex->tokenize($expansion);
 }
 
+## Output hook: by now TeX::Interpreter::close_files_and_terminate()
+## has flushed the SVG queue, so every graphic that refers to a queued
+## SVG either gets its real dimensions or is turned into a
+## MISSING_SVG_GRAPHIC, just as it would have been if the SVG had been
+## rendered on the spot.
+
+sub resolve_queued_svgs {
+    my $xml   = shift;
+    my $nodes = shift;
+
+    my $tex = $xml->get_tex_engine();
+
+    my $svg = $tex->get_svg_agent();
+
+    return unless defined $svg;
+
+    my $dom = $tex->get_output_handle()->get_dom();
+
+    for my $graphic ($nodes->{'graphic|inline-graphic'}->@*) {
+        my $href = $graphic->getAttribute('xlink:href');
+
+        next unless defined $href;
+
+        my $status = $svg->get_status($href);
+
+        next unless defined $status;
+
+        if ($status) {
+            my ($width, $height, $media_type, $error)
+                = TeX::Interpreter::LaTeX::Package::graphics->natural_size($href);
+
+            if (! defined $error) {
+                $graphic->setAttribute(mimetype => $media_type);
+                $graphic->setAttribute(width    => $width);
+                $graphic->setAttribute(height   => $height);
+
+                next;
+            }
+
+            $tex->print_err("Can't parse image file '$href': $error");
+
+            $tex->error();
+        }
+
+        my $missing = $dom->createElement("MISSING_SVG_GRAPHIC");
+
+        $graphic->replaceNode($missing);
+    }
+
+    return;
+}
+
 1;
 
 __DATA__
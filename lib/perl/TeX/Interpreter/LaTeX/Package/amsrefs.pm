@@ -90,11 +90,12 @@ sub do_modify_bib_label {
 
     my $bibkey = trim($tex->read_undelimited_parameter(EXPANDED));
 
-    my $dom = $tex->get_output_handle()->get_dom();
+    my $handle = $tex->get_output_handle();
 
     ## Find the unique <ref> element for this bibkey.
 
-    my @ref_nodes = $dom->findnodes(qq{descendant::ref[attribute::id="bibr-$bibkey"]});
+    my @ref_nodes = grep { $_->nodeName() eq 'ref' }
+        $handle->get_elements_by_id("bibr-$bibkey");
 
     if (@ref_nodes != 1) {
         if (@ref_nodes == 0) {
@@ -166,7 +167,9 @@ sub do_modify_bib_label {
     ## already have been resolved, so we need to seek them out and
     ## update them.
 
-    my @xrefs = $dom->findnodes(qq{descendant::xref[attribute::rid="bibr-$bibkey"]});
+    my @xrefs = grep { $_->nodeName() eq 'xref'
+                           && $_->getAttribute('rid') eq "bibr-$bibkey" }
+        $handle->get_referrers("bibr-$bibkey");
 
     for my $xref (@xrefs) {
         my $first = $xref->firstChild;
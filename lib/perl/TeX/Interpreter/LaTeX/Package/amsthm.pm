@@ -50,7 +50,7 @@ sub install {
 
     $tex->package_load_notification();
 
-    $tex->add_output_hook(\&normalize_statements);
+    $tex->add_output_hook(\&normalize_statements, 0, [ 'statement[@content-type]' ]);
 
     $tex->read_package_data();
 
@@ -60,15 +60,16 @@ sub install {
 }
 
 sub normalize_statements {
-    my $xml = shift;
-
-    my $dom = $xml->get_dom();
+    my $xml   = shift;
+    my $nodes = shift;
 
     ## Proofs nested within their theorems cause UI problems in the
     ## AMS MathViewer, so we unnest them.  Arguably this should be
     ## done in the MathViewer-specific part of the toolchain.
 
-    for my $theorem ($dom->findnodes("/descendant::statement[contains(\@content-type, 'theorem')]")) {
+    my @theorems = grep { $_->getAttribute('content-type') =~ m{theorem} } $nodes->{'statement[@content-type]'}->@*;
+
+    for my $theorem (@theorems) {
         my @proofs = $theorem->findnodes("statement[contains(\@content-type,'proof')]");
 
         for (my $i = 0; $i < @proofs; $i++) {
@@ -42,7 +42,7 @@ sub install {
 
     $tex->package_load_notification();
 
-    $tex->add_output_hook(\&normalize_texml_cases);
+    $tex->add_output_hook(\&normalize_texml_cases, 0, [ qw(texml_cases) ]);
 
     $tex->read_package_data();
 
@@ -50,13 +50,10 @@ sub install {
 }
 
 sub normalize_texml_cases {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
-    my $tex = $xml->get_tex_engine();
-
-    my $dom = $tex->get_output_handle()->get_dom();
-
-    for my $case ($dom->findnodes("/descendant::texml_cases")) {
+    for my $case ($nodes->{texml_cases}->@*) {
         my $parent = $case->parentNode;
 
         my @rows = $case->findnodes("tr");
@@ -51,7 +51,7 @@ sub install {
 
     $tex->package_load_notification();
 
-    $tex->add_output_hook(\&do_resolve_crefs, 1);
+    $tex->add_output_hook(\&do_resolve_crefs, 1, [ qw(cref) ]);
 
     $tex->read_package_data();
 
@@ -59,14 +59,11 @@ sub install {
 }
 
 sub do_resolve_crefs {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $tex = $xml->get_tex_engine();
 
-    my $handle = $tex->get_output_handle();
-
-    my $body = $handle->get_dom();
-
     $tex->print_nl("Resolving <cref>s");
 
     $tex->begingroup();
@@ -75,7 +72,7 @@ sub do_resolve_crefs {
     $tex->let_csname('@@setcrefrange' => 'resolve@@setcrefrange');
     $tex->let_csname('@setnamecref'   => 'resolve@setnamecref');
 
-    for my $cref ($body->findnodes(qq{descendant::cref})) {
+    for my $cref ($nodes->{cref}->@*) {
         (undef, my $ref_cmd) = split / /, $cref->getAttribute('specific-use');
 
         my $tex_cmd = qq{\\${ref_cmd}};
@@ -35,7 +35,7 @@ use warnings;
 
 use File::Basename qw(fileparse);
 
-use TeX::Arithmetic qw(sprint_scaled);
+use TeX::Arithmetic qw(round_decimals sprint_scaled xn_over_d);
 
 use TeX::Constants qw(:named_args);
 
@@ -73,6 +73,16 @@ sub install {
     return;
 }
 
+my sub round_dimen {
+    my $value = shift;
+
+    my $pt = sprintf "%.2f", sprint_scaled($value);
+
+    $pt =~ s{\.0+$}{};
+
+    return "${pt}pt";
+}
+
 sub do_Gin_round_dimen {
     my $self = shift;
 
@@ -85,11 +95,7 @@ sub do_Gin_round_dimen {
 
     my $value = $meaning->read_value($tex, $cur_tok);
 
-    my $pt = sprintf "%.2f", sprint_scaled($value);
-
-    $pt =~ s{\.0+$}{};
-
-    return $tex->tokenize("${pt}pt");
+    return $tex->tokenize(round_dimen($value));
 }
 
 # I don't need to use lexical subroutines here, but I want to play
@@ -118,6 +124,50 @@ my sub image_bbox {
             $info->{file_media_type})
 }
 
+## Converts a (non-negative) number of big points to scaled points
+## the same way scan_dimen() does, i.e., the way TeX reads
+## "\Gin@urx bp".
+
+my sub bp_to_scaled {
+    my $bp = shift;
+
+    use integer;
+
+    my ($int, $frac) = "$bp" =~ m{\A (\d*) (?:\.(\d*))?}smx;
+
+    my $f = round_decimals(split //, substr($frac // "", 0, 17));
+
+    my ($cur_val, $remainder) = xn_over_d($int || 0, 7227, 7200);
+
+    $f = (7227 * $f + 0200000 * $remainder) / 7200;
+
+    $cur_val += $f / 0200000;
+
+    $f %= 0200000;
+
+    return $cur_val * 0200000 + $f;
+}
+
+## Returns the width and height that \includegraphics would give an
+## image file at its natural size, plus the media type and any error.
+## Used to fill in the dimensions of SVGs that were still being
+## rendered when they were included (see TeXMLCreateSVG).
+
+sub natural_size {
+    my $class = shift;
+
+    my $img_file = shift;
+
+    my ($llx, $lly, $urx, $ury, $media_type, $error) = image_bbox($img_file);
+
+    return (undef, undef, undef, $error) if defined $error;
+
+    my $width  = bp_to_scaled($urx) - bp_to_scaled($llx);
+    my $height = bp_to_scaled($ury) - bp_to_scaled($lly);
+
+    return (round_dimen($width), round_dimen($height), $media_type);
+}
+
 sub do_Gread_image {
     my $self = shift;
 
@@ -228,6 +278,20 @@ __DATA__
     \endXMLelement{\jats@graphics@element}%
 }
 
+% An SVG that TeXMLCreateSVG is still rendering.  The width and height
+% are filled in at the end of the run.
+
+\def\TeXMLqueuedSVG#1{%
+    \begingroup
+        \def\Gin@fullpath{#1}%
+        \def\Gin@media@type{image/svg+xml}%
+        \let\Gin@alt\@empty
+        \Gin@req@width\z@
+        \Gin@req@height\z@
+        \Ginclude@image{#1}%
+    \endgroup
+}
+
 \def\Gread@eps#1{%
     %  These values don't matter, except that urx and ury need to be non-zero
     \def\Gin@llx{0}%
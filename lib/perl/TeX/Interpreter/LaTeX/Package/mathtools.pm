@@ -45,7 +45,7 @@ sub install {
     $tex->package_load_notification();
 
     # showonlyrefs needs to run before LTref::do_resolve_xrefs
-    $tex->add_output_hook(\&do_showonlyrefs, 0);
+    $tex->add_output_hook(\&do_showonlyrefs, 0, [ 'tag[@SOR_key]' ]);
 
     $tex->read_package_data();
 
@@ -53,15 +53,12 @@ sub install {
 }
 
 sub do_showonlyrefs {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $tex = $xml->get_tex_engine();
 
-    my $handle = $tex->get_output_handle();
-
-    my $body = $handle->get_dom();
-
-    my @tags = $body->findnodes(q{descendant::tag[@SOR_key]});
+    my @tags = $nodes->{'tag[@SOR_key]'}->@*;
 
     return unless @tags;
 
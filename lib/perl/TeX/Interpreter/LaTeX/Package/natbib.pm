@@ -44,7 +44,7 @@ sub install {
 
     $tex->package_load_notification();
 
-    $tex->add_output_hook(\&do_resolve_natbib, 1);
+    $tex->add_output_hook(\&do_resolve_natbib, 1, [ qw(natbibref) ]);
 
     $tex->read_package_data();
 
@@ -52,15 +52,12 @@ sub install {
 }
 
 sub do_resolve_natbib {
-    my $xml = shift;
+    my $xml   = shift;
+    my $nodes = shift;
 
     my $tex = $xml->get_tex_engine();
 
-    my $handle = $tex->get_output_handle();
-
-    my $body = $handle->get_dom();
-
-    my @refs = $body->findnodes(qq{descendant::natbibref});
+    my @refs = $nodes->{natbibref}->@*;
 
     my $num_refs = @refs;
 
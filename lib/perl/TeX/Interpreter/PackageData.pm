@@ -0,0 +1,436 @@
+package TeX::Interpreter::PackageData;
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use warnings;
+
+use version; our $VERSION = qv '1.0.0';
+
+## A TeX::Interpreter::PackageData is what reading the __DATA__
+## section of a class or package module did to the control sequences,
+## recorded so that TeX::Interpreter::read_package_data() can do the
+## same thing on later runs without tokenizing and executing the TeX
+## code again.  It consists of
+##
+##     reads       : every control sequence or active character the
+##                   code looked at before defining it itself, with a
+##                   fingerprint of the meaning it had at the time
+##
+##     definitions : every assignment that outlives the __DATA__
+##                   section, in order, as [ kind, name, record,
+##                   modifier ].  For control sequences and active
+##                   characters, kind is "csname" or "active" and the
+##                   record is a packed meaning (see
+##                   TeX::Interpreter::pack_meaning()).  Otherwise kind
+##                   names an eqtb table (count_register, cat_code, and
+##                   so on; see TeX::Interpreter::__find_eqtb_cell()) and
+##                   the record is a packed value (see
+##                   TeX::Interpreter::pack_eqtb_value()).
+##
+##     printed     : what it wrote to the terminal and log file,
+##                   including the ")" at the end
+##
+## A recording can only be replayed if all the reads still see the
+## same meanings, since the code may have looked at them to decide
+## what to define.  We don't keep track of which registers and
+## parameters it looks at; instead, their values are part of the cache
+## key (see TeX::Interpreter::__eqtb_signature()).  So are the
+## character codes (\catcode, \lccode and so on) of the characters in
+## signed_chars; looking at the codes of any other character makes the
+## recording opaque.
+##
+## While the section is being interpreted, the recording also keeps
+## track of everything that can't be replayed: assignments to boxes,
+## fonts and the like, Perl code, errors, file operations and so on.
+## If any of those happen, the recording is thrown away and the
+## section is always interpreted.
+##
+## Recordings are cached in files keyed by the name of the module, the
+## MD5 checksum of its __DATA__ section, the state of eqtb when it is
+## read and the version of this format and of texml itself.  The
+## [TeX::Interpreter::PackageData] section of the config file controls
+## this:
+##
+##     cache = 1       use the cache (the default)
+##     cache = 0       always interpret the __DATA__ section
+##
+## The cache lives in the pkgdata subdirectory of the format snapshot
+## cache (see TeX::FMT::Snapshot::cache_dir()).
+
+use Carp;
+
+use Digest::MD5;
+
+use File::Spec::Functions qw(catdir catfile);
+
+use Scalar::Util qw(blessed);
+
+use Storable qw(nfreeze thaw);
+
+use TeX::Constants qw(:booleans);
+
+use TeX::FMT::Snapshot qw(:files);
+
+use TeXML::CFG;
+
+use TeX::Class;
+
+use constant CACHE_MAGIC => "TeXML package data\n";
+
+my %key_of :ATTR(:name<key>);
+
+my %reads_of       :ARRAY(:name<read>);       # [ kind, name, fingerprint ]
+my %definitions_of :ARRAY(:name<definition>); # [ kind, name, record, modifier ]
+
+## Recording state.  base_level is the save level the __DATA__ section
+## started at; anything defined at that level or globally outlives it.
+## pending is set between note_definition() and the eq_define() that
+## carries it out.  peeking is set while the code is looking at a
+## token in passing (see TeX::Interpreter::peek_meaning()).
+
+my %base_level_of :COUNTER(:name<base_level>);
+
+my %pending_of :BOOLEAN(:name<pending> :default<false>);
+my %peeking_of :BOOLEAN(:name<peeking> :default<false>);
+
+my %opaque_of :ATTR(:name<opaque>);  # why it can't be replayed
+
+my %signed_chars_of :ATTR(:name<signed_chars>); # { char_code => 1 }
+
+## What the section printed to the terminal and log file, as
+## [ selector, text ] chunks; a text of undef stands for print_ln().
+## Replaying it is only right if we start out printing to the same
+## place, so we also remember the selector that was in force.
+
+my %selector_of :ATTR(:name<selector>);
+my %printed_of  :ARRAY(:name<printed>);
+
+my %seen_of    :HASH(:name<seen>);   # "kind name" => 1
+my %sources_of :HASH(:name<source>); # refaddr(meaning) => [ kind, name ]
+my %cells_of   :HASH(:name<cell>);   # refaddr(eqvt_ptr) => [ kind, name ]
+
+my $CFG = TeXML::CFG->get_cfg();
+
+######################################################################
+##                                                                  ##
+##                            RECORDING                             ##
+##                                                                  ##
+######################################################################
+
+## Anything that makes the recording useless.  Only the first reason
+## is kept, for tracing.
+
+sub note_opaque {
+    my $self = shift;
+
+    my $reason = shift;
+
+    $opaque_of{ident $self} //= $reason;
+
+    return;
+}
+
+sub is_opaque {
+    my $self = shift;
+
+    return defined $opaque_of{ident $self};
+}
+
+## True if an assignment made now will outlive the __DATA__ section.
+
+sub is_lasting {
+    my $self = shift;
+
+    my $tex    = shift;
+    my $global = shift;
+
+    return $global || $tex->cur_level() <= $base_level_of{ident $self};
+}
+
+## Meanings implemented in Perl outside of the TeX primitives can do
+## anything, so we give up as soon as the code so much as looks at one,
+## unless it's only peeking.  That includes the texml primitives, which
+## mostly change the output.
+
+sub __is_perl_code {
+    my $meaning = shift;
+
+    my $class = blessed($meaning);
+
+    return 1 unless defined $class; # CODE
+
+    return if $class eq 'TeX::Primitive::Macro' || $class eq 'TeX::Token';
+
+    return $class !~ m{\A TeX::Primitive:: (?! texml:: | Macro:: )}smx;
+}
+
+sub note_read {
+    my $self = shift;
+
+    my $kind = shift;
+    my $name = shift;
+    my $eqvt = shift;
+
+    my $ident = ident $self;
+
+    my $meaning = defined $eqvt ? $eqvt->get_equiv() : undef;
+
+    if (ref $meaning) {
+        if (! $peeking_of{$ident} && __is_perl_code($meaning)) {
+            $self->note_opaque("Perl code ($name)");
+        }
+
+        $sources_of{$ident}->{ident $meaning} = [ $kind, $name ];
+    }
+
+    return if $seen_of{$ident}->{"$kind $name"}++;
+
+    push @{ $reads_of{$ident} }, [ $kind, $name, $meaning ];
+
+    return;
+}
+
+## Called whenever the code looks up one of the character codes of
+## $char_code.  $kind is only for tracing.
+
+sub note_code_read {
+    my $self = shift;
+
+    my $kind      = shift;
+    my $char_code = shift;
+
+    my $signed_chars = $signed_chars_of{ident $self};
+
+    return if ! defined $signed_chars || $signed_chars->{$char_code};
+
+    $self->note_opaque(sprintf "%s of U+%04X", $kind, $char_code);
+
+    return;
+}
+
+sub note_definition {
+    my $self = shift;
+
+    my $kind     = shift;
+    my $name     = shift;
+    my $record   = shift;
+    my $modifier = shift;
+
+    my $ident = ident $self;
+
+    $seen_of{$ident}->{"$kind $name"} = 1;
+
+    $pending_of{$ident} = 1;
+
+    if (! defined $record) {
+        $self->note_opaque("can't record the meaning of $name");
+
+        return;
+    }
+
+    push @{ $definitions_of{$ident} }, [ $kind, $name, $record, $modifier ];
+
+    return;
+}
+
+## Called by eq_define() for every assignment that outlives the
+## section.  Returns true if it's one that note_definition() has
+## already taken care of.
+
+sub take_pending {
+    my $self = shift;
+
+    my $ident = ident $self;
+
+    my $pending = $pending_of{$ident};
+
+    $pending_of{$ident} = 0;
+
+    return $pending;
+}
+
+sub note_printed {
+    my $self = shift;
+
+    my $selector = shift;
+    my $text     = shift;
+
+    my $printed = $printed_of{ident $self};
+
+    my $last = $printed->[-1];
+
+    if (defined $text && defined $last && $last->[0] == $selector && defined $last->[1]) {
+        $last->[1] .= $text;
+    } else {
+        push @{ $printed }, [ $selector, $text ];
+    }
+
+    return;
+}
+
+## The control sequence or active character that the code most
+## recently found $meaning in, if any.  This is how we record \let's
+## of meanings that can't be packed; the caller has to check that it
+## still has that meaning.
+
+sub find_source {
+    my $self = shift;
+
+    my $meaning = shift;
+
+    return unless ref $meaning;
+
+    my $source = $sources_of{ident $self}->{ident $meaning};
+
+    return unless defined $source;
+
+    return @{ $source };
+}
+
+## Called once the section has been read.  $fingerprint turns a
+## meaning into a string that can be compared across runs.  Returns
+## true if the recording can be replayed.
+
+sub finish_recording {
+    my $self = shift;
+
+    my $fingerprint = shift;
+
+    my $ident = ident $self;
+
+    for my $read (@{ $reads_of{$ident} }) {
+        $read->[2] = $fingerprint->($read->[2]);
+    }
+
+    delete $seen_of{$ident};
+    delete $sources_of{$ident};
+    delete $cells_of{$ident};
+    delete $signed_chars_of{$ident};
+
+    return ! $self->is_opaque();
+}
+
+######################################################################
+##                                                                  ##
+##                              CACHE                               ##
+##                                                                  ##
+######################################################################
+
+sub is_enabled {
+    my $class = shift;
+
+    return $CFG->val(__PACKAGE__, 'cache', 1);
+}
+
+sub cache_key {
+    my $class = shift;
+
+    my $package   = shift;
+    my $data      = shift;
+    my $signature = shift;
+
+    my $version = eval { no strict 'refs'; ${ "${package}::VERSION" } } // "";
+
+    utf8::encode($data);
+
+    return join ":", $package, $version, Digest::MD5::md5_hex($data),
+                     $signature, $VERSION, $main::VERSION // "";
+}
+
+sub cache_file {
+    my $class = shift;
+
+    my $package = shift;
+    my $key     = shift;
+
+    (my $name = $package) =~ s{\A TeX::Interpreter::LaTeX::}{}smx;
+
+    $name =~ s{::}{-}g;
+
+    my $digest = Digest::MD5::md5_hex($key);
+
+    return catfile(TeX::FMT::Snapshot->cache_dir(), "pkgdata", "$name-$digest.dat");
+}
+
+sub save {
+    my $self = shift;
+
+    my $file = shift;
+
+    my $ident = ident $self;
+
+    my $image = nfreeze({ key         => $key_of{$ident},
+                          selector    => $selector_of{$ident},
+                          reads       => $reads_of{$ident},
+                          definitions => $definitions_of{$ident},
+                          printed     => $printed_of{$ident},
+                        });
+
+    write_cache_file($file, CACHE_MAGIC, $image);
+
+    return;
+}
+
+sub load {
+    my $class = shift;
+
+    my $file = shift;
+    my $key  = shift;
+
+    my $data = read_cache_file($file, CACHE_MAGIC);
+
+    return unless defined $data;
+
+    my $image = eval { thaw($data) };
+
+    return unless ref($image) eq 'HASH';
+
+    return unless defined $image->{key} && $image->{key} eq $key;
+
+    for my $field (qw(reads definitions printed)) {
+        return unless ref($image->{$field}) eq 'ARRAY';
+    }
+
+    my $recording = $class->new({ key      => $image->{key},
+                                  selector => $image->{selector},
+                                });
+
+    $recording->push_read(@{ $image->{reads} });
+    $recording->push_definition(@{ $image->{definitions} });
+    $recording->push_printed(@{ $image->{printed} });
+
+    return $recording;
+}
+
+1;
+
+__END__
@@ -0,0 +1,430 @@
+package TeX::Interpreter::Profiler;
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use warnings;
+
+## A TeX::Interpreter::Profiler records where the interpreter spends
+## its time.  The interpreter calls enter() and leave() around every
+## control sequence that get_x_token() expands or main_control()
+## executes, and add_tokens() whenever it starts reading a token list.
+## A macro's time includes reading its body (see
+## leave_at_end_of_level()).
+## For each control sequence we keep
+##
+##     calls     : the number of times it was expanded or executed
+##     inclusive : wall time including everything it called (recursive
+##                 calls are only counted once)
+##     exclusive : wall time not spent in other control sequences
+##     tokens    : the number of tokens it put back into the input
+##
+## Exclusive time is also credited to the Perl package that defined
+## the control sequence's meaning, so that, for example, all the time
+## spent in the pseudo-macros of
+## TeX::Interpreter::LaTeX::Package::amsthm shows up in one line.
+## Macros defined in TeX are credited to TeX::Primitive::Macro.
+##
+## write_report() writes a plain text summary and write_collapsed()
+## writes the exclusive times in the "collapsed stack" format read by
+## flamegraph.pl and friends (one line per call stack, frames
+## separated by semicolons, followed by a count in microseconds).
+
+use B ();
+
+use List::Util qw(sum0);
+
+use Scalar::Util qw(blessed reftype);
+
+use Time::HiRes ();
+
+use TeX::Class;
+
+my %stack_of :ARRAY(:name<frame>);
+
+my %stats_of     :HASH(:name<stat>);      # name    => { ... }
+my %packages_of  :HASH(:name<package>);   # package => exclusive time
+my %collapsed_of :HASH(:name<collapsed>); # stack   => exclusive time
+
+my %active_of :HASH(:name<active>);       # name    => recursion depth
+
+my %pending_of :HASH(:name<pending>);     # input level => macro frame
+
+my %start_time_of :ATTR(:name<start_time>);
+
+## Frames are arrays, to keep enter() and leave() cheap.
+
+use constant {
+    FRAME_NAME     => 0,
+    FRAME_PATH     => 1,
+    FRAME_START    => 2,
+    FRAME_CHILDREN => 3,
+    FRAME_TOKENS   => 4,
+};
+
+######################################################################
+##                                                                  ##
+##                           CONSTRUCTOR                            ##
+##                                                                  ##
+######################################################################
+
+sub START {
+    my ($self, $ident, $arg_ref) = @_;
+
+    $start_time_of{$ident} = Time::HiRes::time();
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                            RECORDING                             ##
+##                                                                  ##
+######################################################################
+
+## The collapsed-stack format uses semicolons to separate frames and a
+## space to separate the stack from the count, so neither can appear
+## in a frame name.
+
+sub __frame_name {
+    my $token = shift;
+
+    my $name = "$token";
+
+    $name =~ s{\s+\z}{};
+
+    $name =~ s{;}{:}g;
+    $name =~ s{\s}{_}g;
+
+    return length($name) ? $name : "<empty>";
+}
+
+sub __owner_of {
+    my $meaning = shift;
+
+    my $code;
+
+    if ((reftype($meaning) // '') eq 'CODE') {
+        $code = $meaning;
+    } elsif (blessed($meaning)) {
+        if ($meaning->isa('TeX::Primitive::Macro')) {
+            $code = $meaning->get_anonymous_code();
+        }
+
+        return ref($meaning) unless defined $code;
+    }
+
+    return "<unknown>" unless defined $code;
+
+    my $stash = B::svref_2object($code)->STASH();
+
+    return $stash->isa('B::HV') ? $stash->NAME() : "<unknown>";
+}
+
+## Returns the new frame, which should be passed to the matching call
+## to leave() or leave_at_end_of_level().
+
+sub enter {
+    my $self = shift;
+
+    my $token   = shift;
+    my $meaning = shift;
+
+    my $ident = ident $self;
+
+    my $stack = $stack_of{$ident};
+
+    my $name = __frame_name($token);
+
+    my $stats = $stats_of{$ident}->{$name} //= { calls     => 0,
+                                                 inclusive => 0,
+                                                 exclusive => 0,
+                                                 tokens    => 0,
+                                                 package   => __owner_of($meaning),
+                                               };
+
+    $stats->{calls}++;
+
+    $active_of{$ident}->{$name}++;
+
+    my $path = @{ $stack } ? "$stack->[-1]->[FRAME_PATH];$name" : $name;
+
+    my $frame = [ $name, $path, Time::HiRes::time(), 0, 0 ];
+
+    push @{ $stack }, $frame;
+
+    return $frame;
+}
+
+sub __index_of {
+    my $stack = shift;
+    my $frame = shift;
+
+    for (my $index = $#{ $stack }; $index >= 0; $index--) {
+        return $index if $stack->[$index] == $frame;
+    }
+
+    return;
+}
+
+## Closes the frame at $index.  Normally that's the top of the stack,
+## but end_level() can also take a frame out from under the ones above
+## it.  In that case the frame above it is still running; the part of
+## it that has already happened is counted as a child of this frame
+## and the rest will be counted as a child of the frame below.
+
+sub __close_frame {
+    my $self = shift;
+
+    my $index = shift;
+    my $now   = shift;
+
+    my $ident = ident $self;
+
+    my $stack = $stack_of{$ident};
+
+    my ($name, $path, $start, $children, $tokens) = @{ splice @{ $stack }, $index, 1 };
+
+    my $elapsed = $now - $start;
+
+    my $running = $index < @{ $stack } ? $now - $stack->[$index]->[FRAME_START] : 0;
+
+    my $exclusive = $elapsed - $children - $running;
+
+    my $stats = $stats_of{$ident}->{$name};
+
+    $stats->{exclusive} += $exclusive;
+    $stats->{tokens}    += $tokens;
+
+    if (--$active_of{$ident}->{$name} == 0) {
+        $stats->{inclusive} += $elapsed;
+    }
+
+    $packages_of{$ident}->{ $stats->{package} } += $exclusive;
+
+    $collapsed_of{$ident}->{$path} += $exclusive;
+
+    if ($index > 0) {
+        $stack->[$index - 1]->[FRAME_CHILDREN] += $elapsed - $running;
+    }
+
+    for (my $i = $index; $i < @{ $stack }; $i++) {
+        my $frame = $stack->[$i];
+
+        $frame->[FRAME_PATH] = $i > 0 ? "$stack->[$i - 1]->[FRAME_PATH];$frame->[FRAME_NAME]"
+                                      : $frame->[FRAME_NAME];
+    }
+
+    return;
+}
+
+sub __close_frames_from {
+    my $self = shift;
+
+    my $index = shift;
+
+    my $stack = $stack_of{ident $self};
+
+    my $now = Time::HiRes::time();
+
+    while (@{ $stack } > $index) {
+        $self->__close_frame($#{ $stack }, $now);
+    }
+
+    return;
+}
+
+## Closes $frame and every frame above it.  Normally that's just
+## $frame, but if a command died and the error was caught further up,
+## or a macro's body outlived the command that expanded it, we may have
+## to close several.  If $frame has already been closed, there's
+## nothing to do.
+
+sub leave {
+    my $self = shift;
+
+    my $frame = shift;
+
+    my $index = __index_of($stack_of{ident $self}, $frame);
+
+    $self->__close_frames_from($index) if defined $index;
+
+    return;
+}
+
+## A macro isn't finished when get_x_token() has expanded it, but when
+## the interpreter has read the rest of its body.  So its frame is
+## left open and closed by end_level(), which end_token_list() calls
+## when it leaves the input level holding the body.  A macro whose
+## body has been read is no longer the caller of anything that's still
+## running, so it's taken out of the stack even if it isn't on top.
+## In particular, a macro that calls itself at the end of its body
+## doesn't make the stack any deeper.
+
+sub leave_at_end_of_level {
+    my $self = shift;
+
+    my $frame = shift;
+    my $level = shift;
+
+    $pending_of{ident $self}->{$level} = $frame;
+
+    return;
+}
+
+sub end_level {
+    my $self = shift;
+
+    my $level = shift;
+
+    my $ident = ident $self;
+
+    my $frame = delete $pending_of{$ident}->{$level};
+
+    return unless defined $frame;
+
+    my $index = __index_of($stack_of{$ident}, $frame);
+
+    return unless defined $index;
+
+    $self->__close_frame($index, Time::HiRes::time());
+
+    return;
+}
+
+sub add_tokens {
+    my $self = shift;
+
+    my $num_tokens = shift;
+
+    my $stack = $stack_of{ident $self};
+
+    if (@{ $stack }) {
+        $stack->[-1]->[FRAME_TOKENS] += $num_tokens;
+    }
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                            REPORTING                             ##
+##                                                                  ##
+######################################################################
+
+## Control sequences are listed by exclusive time.  $max_entries
+## limits the length of the list (the default is 100; 0 means all of
+## them).
+
+sub write_report {
+    my $self = shift;
+
+    my $file        = shift;
+    my $max_entries = shift // 100;
+
+    my $ident = ident $self;
+
+    $self->__close_frames_from(0);
+
+    my $stats    = $stats_of{$ident};
+    my $packages = $packages_of{$ident};
+
+    my $total = Time::HiRes::time() - $start_time_of{$ident};
+
+    my $profiled = sum0 values %{ $packages };
+
+    open(my $fh, ">:utf8", $file) or die "Can't open $file: $!\n";
+
+    printf { $fh } "Total time:                   %10.3f s\n", $total;
+    printf { $fh } "Time in control sequences:    %10.3f s\n", $profiled;
+    printf { $fh } "Distinct control sequences:   %10d\n\n", scalar keys %{ $stats };
+
+    print { $fh } "By package (exclusive time):\n\n";
+
+    for my $package (sort { $packages->{$b} <=> $packages->{$a} } keys %{ $packages }) {
+        printf { $fh } "  %10.3f s  %5.1f%%  %s\n",
+            $packages->{$package},
+            $profiled ? 100 * $packages->{$package} / $profiled : 0,
+            $package;
+    }
+
+    print { $fh } "\nBy control sequence:\n\n";
+
+    printf { $fh } "  %10s  %10s  %10s  %10s  %s\n",
+        "calls", "excl (s)", "incl (s)", "tokens", "name (package)";
+
+    my @names = sort { $stats->{$b}->{exclusive} <=> $stats->{$a}->{exclusive}
+                           || $a cmp $b } keys %{ $stats };
+
+    if ($max_entries > 0 && @names > $max_entries) {
+        splice @names, $max_entries;
+    }
+
+    for my $name (@names) {
+        my $entry = $stats->{$name};
+
+        printf { $fh } "  %10d  %10.4f  %10.4f  %10d  %s (%s)\n",
+            @{ $entry }{qw(calls exclusive inclusive tokens)},
+            $name, $entry->{package};
+    }
+
+    close($fh) or die "Can't write $file: $!\n";
+
+    return;
+}
+
+sub write_collapsed {
+    my $self = shift;
+
+    my $file = shift;
+
+    my $ident = ident $self;
+
+    $self->__close_frames_from(0);
+
+    my $collapsed = $collapsed_of{$ident};
+
+    open(my $fh, ">:utf8", $file) or die "Can't open $file: $!\n";
+
+    for my $path (sort keys %{ $collapsed }) {
+        my $usecs = int(1_000_000 * $collapsed->{$path} + 0.5);
+
+        print { $fh } "$path $usecs\n" if $usecs > 0;
+    }
+
+    close($fh) or die "Can't write $file: $!\n";
+
+    return;
+}
+
+1;
+
+__END__
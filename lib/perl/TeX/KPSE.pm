@@ -1,6 +1,6 @@
 package TeX::KPSE;
 
-# Copyright (C) 2022 American Mathematical Society
+# Copyright (C) 2022, 2026 American Mathematical Society
 #
 # This program is free software: you can redistribute it and/or modify
 # it under the terms of the GNU Affero General Public License as published by
@@ -32,15 +32,25 @@ package TeX::KPSE;
 use strict;
 use warnings;
 
-use version; our $VERSION = qv '1.3.0';
+use version; our $VERSION = qv '1.4.0';
 
 use base qw(Exporter);
 
-our %EXPORT_TAGS = (all => [ qw(kpse_lookup kpse_reset_program_name) ]);
+our %EXPORT_TAGS = (all => [ qw(kpse_lookup
+                                kpse_tex_file_names
+                                kpse_reset_program_name
+                                kpse_reset_cache
+                                kpse_statistics) ]);
 
 our @EXPORT_OK = ( @{ $EXPORT_TAGS{all} } );
 
-our @EXPORT = ( @{ $EXPORT_TAGS{all} } );
+our @EXPORT = qw(kpse_lookup kpse_reset_program_name);
+
+use Cwd qw(abs_path);
+
+use File::Basename;
+use File::Find;
+use File::Spec::Functions qw(catfile file_name_is_absolute rel2abs);
 
 use TeXML::CFG;
 
@@ -49,13 +59,399 @@ my $CFG = TeXML::CFG->get_cfg();
 my $KPSEWHICH         = $CFG->val(__PACKAGE__, 'kpsewhich', 'kpsewhich');
 my $KPSE_PROGRAM_NAME = $CFG->val(__PACKAGE__, 'program_name', 'pdflatex');
 
+## Set native_lookup=0 in the [TeX::KPSE] section of the config file
+## to go back to running kpsewhich for every lookup.
+
+my $NATIVE_LOOKUP = $CFG->val(__PACKAGE__, 'native_lookup', 1);
+
 sub _nonempty( $ ) {
     my $string = shift;
 
     return defined $string && $string =~ /\S/;
 }
 
-sub kpse_lookup( $; $ ) {
+######################################################################
+##                                                                  ##
+##                         NATIVE RESOLVER                          ##
+##                                                                  ##
+######################################################################
+
+## Instead of forking kpsewhich for every file we look for, we expand
+## the search path (TEXINPUTS or an explicit --path) once, index the
+## directories it names, and answer lookups from memory.  Recursive
+## (//) elements are indexed from an ls-R database if one covers the
+## directory and by walking the tree otherwise.  Relative directories
+## (notably the ".//" that bin/texml puts at the front of TEXINPUTS)
+## can acquire new files while we run, so for those we only cache the
+## list of subdirectories and stat the candidates on every lookup,
+## which is what kpathsea itself does.
+##
+## Anything we can't find is handed to kpsewhich, since any empty
+## (default) path elements come from the system texmf.cnf, which we
+## make no attempt to parse.  For the same reason, when no search path
+## is given, we only resolve the files kpsewhich would look for along
+## TEXINPUTS; fonts, formats, BibTeX files and the like, which it
+## finds along other paths chosen by the suffix, go straight to
+## kpsewhich.
+##
+## Results, including misses, are remembered so that no file name is
+## passed to kpsewhich more than once per search path.  Like a miss,
+## a remembered hit is only final for the directories that can't
+## change underneath us: a file that has since appeared in a volatile
+## directory earlier in the path shadows it, so we look there again
+## first.
+
+my %PATH_CACHE;     # search path spec => [ path elements ]
+my %LS_R_CACHE;     # ls-R file => { basename => [ dirs ] }
+my %TREE_CACHE;     # directory => { basename => [ dirs ] }
+my %SUBDIR_CACHE;   # absolute directory => [ subdirs ]
+
+## For each search path and file name, the path we found (undef for a
+## miss), the number of path elements before the one it was found
+## in, i.e., the ones that have to be checked again, and the path made
+## absolute (see __recall()).
+
+my %FOUND;          # search path => { file name => [ path, limit, abs ] }
+my %FOUND_BY_KPSEWHICH; # file name => [ path, abs ] or [] (other formats)
+
+my %STATS = (lookups => 0, hits => 0, negative_hits => 0, forks => 0);
+
+sub kpse_reset_cache() {
+    %PATH_CACHE   = ();
+    %LS_R_CACHE   = ();
+    %TREE_CACHE   = ();
+    %SUBDIR_CACHE = ();
+    %FOUND        = ();
+
+    %FOUND_BY_KPSEWHICH = ();
+
+    return;
+}
+
+sub kpse_statistics() {
+    return wantarray ? %STATS : { %STATS };
+}
+
+## kpathsea only accepts readable regular files.
+
+sub __is_file( $ ) {
+    my $path = shift;
+
+    return -f $path && -r _;
+}
+
+## kpsewhich can answer with a path relative to the current directory
+## (for instance, when texmf.cnf puts "." in TEXINPUTS), which can
+## change between lookups.  So along with each path we remember, we
+## keep its absolute form, and __recall() returns the path as it was
+## found if it still means the same file and the absolute path if not.
+
+sub __absolute( $ ) {
+    my $path = shift;
+
+    return $path if file_name_is_absolute($path);
+
+    return abs_path($path) // rel2abs($path);
+}
+
+sub __recall( $$ ) {
+    my $path = shift;
+    my $abs  = shift;
+
+    return unless __is_file($abs);
+
+    return $path eq $abs || __absolute($path) eq $abs ? $path : $abs;
+}
+
+## The suffixes kpsewhich associates with formats other than
+## kpse_tex_format (see kpathsea's tex-file.c).  Anything else,
+## including unknown suffixes, is looked for along TEXINPUTS.
+
+my $OTHER_FORMAT_SUFFIX = qr{ \. (?: afm | base | bib | bst | cnf | enc | fmt
+                                  | \d* gf | ist | lig | lua | map | mem | mf
+                                  | mft | mp | ofm | opl | otf | ovf | ovp
+                                  | pfa | pfb | \d* pk | pool | tfm | ttc
+                                  | ttf | vf ) \z}smx;
+
+sub __is_tex_format( $ ) {
+    my $file_name = shift;
+
+    return $file_name !~ $OTHER_FORMAT_SUFFIX;
+}
+
+## The names kpathsea tries, in order, when TeX \input's $file_name:
+## $file_name.tex and then $file_name, unless $file_name already ends
+## in .tex or one of the alternative suffixes of kpse_tex_format.
+
+my $TEX_SUFFIX = qr{ \. (?: tex | sty | cls | fd | aux | bbl | def | clo | ldf ) \z}smx;
+
+sub kpse_tex_file_names( $ ) {
+    my $file_name = shift;
+
+    return $file_name =~ $TEX_SUFFIX ? ($file_name) : ("$file_name.tex", $file_name);
+}
+
+sub __brace_expand( $ );
+
+sub __brace_expand( $ ) {
+    my $string = shift;
+
+    return $string unless $string =~ m{\A (.*?) \{ ([^{}]*) \} (.*) \z}smx;
+
+    my ($pre, $alternatives, $post) = ($1, $2, $3);
+
+    return map { __brace_expand("$pre$_$post") } split /,/, $alternatives, -1;
+}
+
+## Each path element is a hash with the following keys:
+##
+##     dir       : the directory
+##     recursive : true for "dir//"
+##     db_only   : true for "!!dir" (ls-R only, never look at the disk)
+##     volatile  : true for relative directories
+##
+## Empty path elements (which kpathsea replaces by the compiled-in
+## default path) are dropped; files that live there are found by the
+## kpsewhich fallback.
+
+sub __expand_path( $ ) {
+    my $spec = shift;
+
+    return $PATH_CACHE{$spec} if exists $PATH_CACHE{$spec};
+
+    my @elements;
+
+    for my $raw (split /:/, $spec) {
+        next unless _nonempty($raw);
+
+        for my $element (__brace_expand($raw)) {
+            my $db_only = $element =~ s{\A !!}{}smx;
+
+            my $recursive = $element =~ s{/{2,}\z}{}smx;
+
+            $element =~ s{/+\z}{}smx;
+
+            $element = '.' if $element eq '';
+
+            push @elements, { dir       => $element,
+                              recursive => $recursive,
+                              db_only   => $db_only,
+                              volatile  => ! file_name_is_absolute($element),
+            };
+        }
+    }
+
+    return $PATH_CACHE{$spec} = \@elements;
+}
+
+sub __find_ls_R( $ ) {
+    my $dir = shift;
+
+    my $candidate = rel2abs($dir);
+
+    while (1) {
+        for my $name (qw(ls-R ls-r)) {
+            my $ls_R = catfile($candidate, $name);
+
+            return ($ls_R, $candidate) if -f $ls_R;
+        }
+
+        my $parent = dirname($candidate);
+
+        last if $parent eq $candidate;
+
+        $candidate = $parent;
+    }
+
+    return;
+}
+
+## ls-R consists of blocks introduced by "DIR:" lines, followed by the
+## names of the entries in DIR.  Directory names are either absolute
+## or relative to the directory containing the ls-R file.
+
+sub __load_ls_R( $$ ) {
+    my $ls_R = shift;
+    my $root = shift;
+
+    return $LS_R_CACHE{$ls_R} if exists $LS_R_CACHE{$ls_R};
+
+    my %index;
+
+    open(my $fh, "<", $ls_R) or do {
+        return $LS_R_CACHE{$ls_R} = undef;
+    };
+
+    my $cur_dir = $root;
+
+    while (my $line = <$fh>) {
+        chomp $line;
+
+        next if $line eq '' || $line =~ m{\A %}smx;
+
+        if ($line =~ m{\A (.*) : \z}smx) {
+            my $dir = $1;
+
+            $dir =~ s{\A \./}{}smx;
+            $dir =~ s{/+\z}{}smx;
+
+            if (file_name_is_absolute($dir)) {
+                $cur_dir = $dir;
+            } elsif ($dir eq '.' || $dir eq '') {
+                $cur_dir = $root;
+            } else {
+                $cur_dir = "$root/$dir";
+            }
+
+            next;
+        }
+
+        push @{ $index{$line} }, $cur_dir;
+    }
+
+    close($fh);
+
+    return $LS_R_CACHE{$ls_R} = \%index;
+}
+
+sub __walk_tree( $ ) {
+    my $dir = shift;
+
+    return $TREE_CACHE{$dir} if exists $TREE_CACHE{$dir};
+
+    my %index;
+
+    if (-d $dir) {
+        find({ wanted => sub {
+                   return if -d $_;
+
+                   push @{ $index{$_} }, $File::Find::dir;
+               },
+               preprocess => sub { sort @_ },
+               follow_fast => 1,
+               follow_skip => 2,
+             }, $dir);
+    }
+
+    return $TREE_CACHE{$dir} = \%index;
+}
+
+## Relative directories are cached by their absolute name, since the
+## current directory can change between lookups.
+
+sub __list_subdirs( $ ) {
+    my $dir = shift;
+
+    my $abs_dir = rel2abs($dir);
+
+    return $SUBDIR_CACHE{$abs_dir} if exists $SUBDIR_CACHE{$abs_dir};
+
+    my @subdirs;
+
+    if (-d $dir) {
+        find({ wanted => sub {
+                   push @subdirs, $File::Find::name if -d $_;
+               },
+               preprocess => sub { sort @_ },
+               follow_fast => 1,
+               follow_skip => 2,
+             }, $dir);
+    }
+
+    return $SUBDIR_CACHE{$abs_dir} = \@subdirs;
+}
+
+## Returns the candidate directories for $base within a path element,
+## in search order.  For a recursive element, $subdir (the directory
+## part of the name being looked up) can be anywhere below the
+## element; otherwise it has to be directly inside it.
+
+sub __candidate_dirs( $$$ ) {
+    my $element = shift;
+    my $base    = shift;
+    my $subdir  = shift;
+
+    my $dir = $element->{dir};
+
+    if ($element->{recursive} || $element->{db_only}) {
+        if (! $element->{volatile}) {
+            my ($ls_R, $root) = __find_ls_R($dir);
+
+            if (defined $ls_R) {
+                my $index = __load_ls_R($ls_R, $root);
+
+                if (defined $index) {
+                    my @dirs = @{ $index->{$base} || [] };
+
+                    if ($element->{recursive}) {
+                        return grep { $_ eq $dir || index($_, "$dir/") == 0 } @dirs;
+                    }
+
+                    my $target = $subdir eq '' ? $dir : "$dir/$subdir";
+
+                    return grep { $_ eq $target } @dirs;
+                }
+            }
+        }
+
+        return if $element->{db_only};
+
+        if ($element->{volatile}) {
+            return grep { __is_file("$_/$base") } @{ __list_subdirs($dir) };
+        }
+
+        return @{ __walk_tree($dir)->{$base} || [] };
+    }
+
+    $dir = "$dir/$subdir" if $subdir ne '';
+
+    return __is_file("$dir/$base") ? ($dir) : ();
+}
+
+## Returns the path and the index of the path element it was found
+## in.  If $limit is given, only the elements before it are searched.
+
+sub __native_lookup( $$;$$ ) {
+    my $file_name     = shift;
+    my $spec          = shift;
+    my $volatile_only = shift;
+    my $limit         = shift;
+
+    my ($base, $subdir) = fileparse($file_name);
+
+    $subdir =~ s{\A \./}{}smx;
+    $subdir =~ s{/+\z}{}smx;
+
+    $subdir = '' if $subdir eq '.';
+
+    my $elements = __expand_path($spec);
+
+    $limit //= @{ $elements };
+
+    for my $index (0 .. $limit - 1) {
+        my $element = $elements->[$index];
+
+        next if $volatile_only && ! $element->{volatile};
+
+        for my $dir (__candidate_dirs($element, $base, $subdir)) {
+            next if $subdir ne '' && $dir !~ m{(?:\A|/) \Q$subdir\E \z}smx;
+
+            my $path = $dir eq '.' ? "./$base" : "$dir/$base";
+
+            return ($path, $index) if __is_file($path);
+        }
+    }
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                            KPSEWHICH                             ##
+##                                                                  ##
+######################################################################
+
+sub __run_kpsewhich( $; $ ) {
     my $file_name   = shift;
     my $search_path = shift;
 
@@ -69,14 +465,118 @@ sub kpse_lookup( $; $ ) {
         $cmd .= qq{ --path='$search_path'};
     }
 
-    chomp(my $path = qx{$cmd '$file_name'});
+    $STATS{forks}++;
+
+    chomp(my $path = qx{$cmd '$file_name' 2>/dev/null});
 
     return $path eq '' ? undef : $path;
 }
 
+######################################################################
+##                                                                  ##
+##                            INTERFACE                             ##
+##                                                                  ##
+######################################################################
+
+sub kpse_lookup( $; $ ) {
+    my $file_name   = shift;
+    my $search_path = shift;
+
+    return unless _nonempty($file_name);
+
+    return __run_kpsewhich($file_name, $search_path) unless $NATIVE_LOOKUP;
+
+    $STATS{lookups}++;
+
+    if (file_name_is_absolute($file_name)) {
+        return __is_file($file_name) ? $file_name : undef;
+    }
+
+    ## Without a search path, kpsewhich picks one from the suffix.
+
+    if (! _nonempty($search_path) && ! __is_tex_format($file_name)) {
+        my $entry = $FOUND_BY_KPSEWHICH{$file_name};
+
+        if (defined $entry && ! @{ $entry }) {
+            $STATS{negative_hits}++;
+
+            return;
+        }
+
+        if (defined $entry && defined(my $path = __recall($entry->[0], $entry->[1]))) {
+            $STATS{hits}++;
+
+            return $path;
+        }
+
+        my $path = __run_kpsewhich($file_name);
+
+        $FOUND_BY_KPSEWHICH{$file_name} = defined $path ? [ $path, __absolute($path) ] : [];
+
+        return $path;
+    }
+
+    my $path_spec = _nonempty($search_path) ? $search_path
+                                            : $ENV{TEXINPUTS} // '';
+
+    my $found = $FOUND{$path_spec} //= {};
+
+    if (defined(my $entry = $found->{$file_name})) {
+        my ($path, $limit, $abs) = @{ $entry };
+
+        my ($newer) = __native_lookup($file_name, $path_spec, 1, $limit);
+
+        if (defined $newer) {
+            $STATS{hits}++;
+
+            return $newer;
+        }
+
+        if (! defined $path) {
+            $STATS{negative_hits}++;
+
+            return;
+        }
+
+        if (defined(my $recalled = __recall($path, $abs))) {
+            $STATS{hits}++;
+
+            return $recalled;
+        }
+    }
+
+    my $elements = __expand_path($path_spec);
+
+    my ($path, $index) = __native_lookup($file_name, $path_spec);
+
+    if (defined $path) {
+        $STATS{hits}++;
+    } else {
+        $path = __run_kpsewhich($file_name, $search_path);
+
+        $index = @{ $elements };
+    }
+
+    ## Don't remember hits in volatile directories: a later file with
+    ## the same name might appear earlier in the path.  (What kpsewhich
+    ## finds comes from the default path, after all of our elements.)
+
+    if (! defined $path) {
+        $found->{$file_name} = [ undef, scalar @{ $elements } ];
+    } elsif ($index == @{ $elements } || ! $elements->[$index]->{volatile}) {
+        $found->{$file_name} = [ $path, $index, __absolute($path) ];
+    }
+
+    return $path;
+}
+
 sub kpse_reset_program_name( $ ) {
     $KPSE_PROGRAM_NAME = shift;
 
+    %FOUND = ();
+
+    %FOUND_BY_KPSEWHICH = ();
+
     return;
 }
 
@@ -51,6 +51,14 @@ sub BUILD {
     return;
 }
 
+## Returns one of the :node_types constants from TeX::Constants.
+## Every concrete node class overrides this; TeX::Output::XML
+## dispatches on it.
+
+sub node_type {
+    return;
+}
+
 sub is_char_node {
     return 0;
 }
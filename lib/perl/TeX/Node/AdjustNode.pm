@@ -32,7 +32,7 @@ package TeX::Node::AdjustNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params adjust_node);
 
 use base qw(TeX::Node::AbstractNode);
 
@@ -48,6 +48,10 @@ sub BUILD {
     return;
 }
 
+sub node_type {
+    return adjust_node;
+}
+
 1;
 
 __END__
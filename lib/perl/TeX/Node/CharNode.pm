@@ -40,9 +40,9 @@ our @EXPORT_OK = ( @{ $EXPORT_TAGS{factories} } );
 
 our @EXPORT = ();
 
-use TeX::Class;
+use TeX::Class qw(:array_backed);
 
-use TeX::Constants qw(UCS);
+use TeX::Constants qw(UCS char_node);
 
 use TeX::Node::HListNode qw(:factories);
 
@@ -101,6 +101,10 @@ sub show_node {
         print_char_code($char);
 }
 
+sub node_type {
+    return char_node;
+}
+
 1;
 
 __END__
@@ -44,6 +44,8 @@ use utf8;
 
 use TeX::Class;
 
+use TeX::Constants qw(unicode_string_node);
+
 my %contents_of :ATTR(:name<contents>);
 
 sub new_unicode_string( $ ) {
@@ -60,6 +62,10 @@ sub to_string :STRINGIFY {
     return $self->get_contents();
 }
 
+sub node_type {
+    return unicode_string_node;
+}
+
 1;
 
 __END__
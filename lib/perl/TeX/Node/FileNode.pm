@@ -36,8 +36,14 @@ use base qw(TeX::Node::WhatsitNode);
 
 use TeX::Class;
 
+use TeX::Constants qw(file_node);
+
 my %fileno_of :COUNTER(:name<fileno>);
 
+sub node_type {
+    return file_node;
+}
+
 1;
 
 __END__
@@ -38,7 +38,7 @@ use TeX::Class;
 
 use TeX::Arithmetic qw(:string);
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params glue_node);
 
 my %width_of   :ATTR(:get<width>   :set<width>);
 
@@ -112,6 +112,10 @@ sub to_string :STRINGIFY {
     return " ";
 }
 
+sub node_type {
+    return glue_node;
+}
+
 1;
 
 __END__
@@ -38,6 +38,8 @@ use base qw(TeX::Node::WhatsitNode);
 
 use TeX::Class;
 
+use TeX::Constants qw(char_node);
+
 my %font_of        :ATTR(:get<font>  :set<font>);
 my %char_code_of    :ATTR(:get<char_code> :set<char_code>);
 my %glyph_count_of :ATTR(:get<glyph_count> :set<glyph_count>);
@@ -78,6 +80,10 @@ sub show_node {
     return sprintf "%s %s (%d)", $font, print_char_code($char), $count;
 }
 
+sub node_type {
+    return char_node;
+}
+
 1;
 
 __END__
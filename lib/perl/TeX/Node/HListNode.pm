@@ -46,7 +46,7 @@ use List::Util qw(any);
 
 use TeX::Arithmetic qw(:string unity);
 
-use TeX::Constants qw(:box_params :node_params :type_bounds);
+use TeX::Constants qw(:box_params :node_params :type_bounds hlist_node);
 
 use base qw(TeX::Node::AbstractNode);
 
@@ -386,6 +386,10 @@ sub to_string :STRINGIFY {
     return "@nodes";
 }
 
+sub node_type {
+    return hlist_node;
+}
+
 1;
 
 __END__
@@ -32,7 +32,7 @@ package TeX::Node::InsertNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params ins_node);
 
 use base qw(TeX::Node::AbstractNode);
 
@@ -60,6 +60,10 @@ sub BUILD {
     return;
 }
 
+sub node_type {
+    return ins_node;
+}
+
 1;
 
 __END__
@@ -32,7 +32,7 @@ package TeX::Node::KernNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params kern_node);
 
 use base qw(TeX::Node::AbstractNode);
 
@@ -56,6 +56,10 @@ sub show_node {
     return $node;
 }
 
+sub node_type {
+    return kern_node;
+}
+
 1;
 
 __END__
@@ -32,7 +32,7 @@ package TeX::Node::LanguageNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params language_node);
 
 use base qw(TeX::Node::WhatsitNode);
 
@@ -42,6 +42,10 @@ my %language_of :COUNTER(:name<language> :default<0>);
 
 # We don't use this yet, but here's the skeleton of it.
 
+sub node_type {
+    return language_node;
+}
+
 1;
 
 __END__
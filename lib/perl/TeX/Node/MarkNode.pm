@@ -36,10 +36,16 @@ use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
+use TeX::Constants qw(mark_node);
+
 use TeX::TokenList;
 
 my %token_list_of :ATTR(:name<token_list> :type<TeX::TokenList>);
 
+sub node_type {
+    return mark_node;
+}
+
 1;
 
 __END__
@@ -38,7 +38,7 @@ use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params math_node);
 
 my %width_of :ATTR(:get<width> :set<width>  :init_arg => 'width');
 my %subtype_of :ATTR(:get<subtype> :set<subtype> :init_arg => 'subtype');
@@ -61,6 +61,10 @@ sub show_node {
     return $node;
 }
 
+sub node_type {
+    return math_node;
+}
+
 1;
 
 __END__
@@ -32,7 +32,7 @@ package TeX::Node::PenaltyNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params penalty_node);
 
 use base qw(TeX::Node::AbstractNode);
 
@@ -40,6 +40,10 @@ use TeX::Class;
 
 my %penalty_of :ATTR(:get<penalty> :set<penalty> :init_arg => 'penalty');
 
+sub node_type {
+    return penalty_node;
+}
+
 1;
 
 __END__
@@ -38,6 +38,8 @@ use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
+use TeX::Constants qw(rule_node);
+
 my %height_of :ATTR(:get<height> :set<height>);
 my %width_of  :ATTR(:get<width>  :set<width>);
 my %depth_of  :ATTR(:get<depth>  :set<depth>);
@@ -72,6 +74,10 @@ sub show_node {
     return $node;
 }
 
+sub node_type {
+    return rule_node;
+}
+
 1;
 
 __END__
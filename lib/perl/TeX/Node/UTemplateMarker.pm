@@ -40,10 +40,16 @@ use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
+use TeX::Constants qw(u_template_node);
+
 sub is_u_template_marker {
     return 1;
 }
 
+sub node_type {
+    return u_template_node;
+}
+
 1;
 
 __END__
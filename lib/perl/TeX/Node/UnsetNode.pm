@@ -38,7 +38,7 @@ use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params unset_node);
 
 my %height_of     :ATTR(:get<height>     :set<height>     :default(0));
 my %width_of      :ATTR(:get<width>      :set<width>      :default(0));
@@ -50,6 +50,10 @@ my %shrink_of     :ATTR(:get<shrink>     :set<shrink>     :default(0.0));
 my %glue_sign_of  :ATTR(:get<glue_sign>  :set<glue_sign>  :default(normal));
 my %glue_order_of :ATTR(:get<glue_order> :set<glue_order> :default(normal));
 
+sub node_type {
+    return unset_node;
+}
+
 1;
 
 __END__
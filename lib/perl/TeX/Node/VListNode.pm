@@ -32,7 +32,7 @@ package TeX::Node::VListNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params vlist_node);
 
 use base qw(TeX::Node::HListNode);
 
@@ -93,6 +93,10 @@ sub is_underline_box {
     return 1;
 }
 
+sub node_type {
+    return vlist_node;
+}
+
 1;
 
 __END__
@@ -36,12 +36,16 @@ package TeX::Node::WhatsitNode;
 use strict;
 use warnings;
 
-use TeX::Constants qw(:node_params);
+use TeX::Constants qw(:node_params whatsit_node);
 
 use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
+sub node_type {
+    return whatsit_node;
+}
+
 1;
 
 __END__
@@ -36,6 +36,8 @@ use base qw(TeX::Node::AbstractNode);
 
 use TeX::Class;
 
+use TeX::Constants qw(xml_node);
+
 my %qName_of :ATTR(:name<qName>);
 
 use overload q{eq}  => \&xml_node_eq;
@@ -58,6 +60,10 @@ sub xml_node_eq {
     return "$self" eq "$other";
 }
 
+sub node_type {
+    return xml_node;
+}
+
 1;
 
 __END__
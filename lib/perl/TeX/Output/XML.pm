@@ -37,15 +37,13 @@ use FindBin;
 
 use List::Util qw(min uniq);
 
-use List::MoreUtils qw(duplicates);
-
 use TeX::Node::CharNode qw(:factories);
 
 use TeX::Utils::XML;
 
 use TeX::Class;
 
-use TeX::Constants qw(UCS);
+use TeX::Constants qw(UCS :node_types);
 
 use TeX::Utils::Misc;
 
@@ -88,13 +86,43 @@ my $XML_Name = qr{ (?: $XML_NameStartChar ) (?: $XML_NameChar )*}smxo;
 
 my %tex_engine_of :ATTR(:name<tex_engine> :type<TeX::Interpreter>);
 
-my %dom_of :ATTR(:name<dom> :type<XML::LibXML::Document>);
+my %dom_of :ATTR(:name<dom> :get<*custom*> :type<XML::LibXML::Document>);
+
+## Each hook is [ $priority, $sub, $selectors ]; see run_hooks().
 
 my %hooks_of :ARRAY(:name<hook>);
 
-my %current_element_of :ATTR(:name<current_element> :type<TeX::Output::XML::Element>);
+## Elements by id and by the ids their rid attributes refer to, kept
+## up to date as attributes are added through open_element(),
+## add_attribute() and set_element_attribute(), so that package code
+## can find them while the document is still being built.  Entries
+## aren't removed, so lookups check that they still hold.
+
+my %live_ids_of  :HASH(:name<live_id_list>);  # id => [ elements ]
+my %referrers_of :HASH(:name<referrer_list>); # id => [ elements ]
+
+## The fallback for get_elements_by_id() when the live index doesn't
+## know an id (e.g., one set directly with setAttribute()), as id => [
+## elements ] in document order.  It is kept until the document
+## changes: dom_generation counts the changes we know about (see
+## note_dom_change()), and run_hooks() throws it away before each
+## stage.
+
+my %id_index_of            :ATTR(:name<id_index>);
+my %id_index_generation_of :ATTR(:name<id_index_generation>);
+
+my %dom_generation_of :COUNTER(:name<dom_generation> :default<0>);
+
+my %current_element_of :ATTR(:name<current_element> :get<*custom*> :type<TeX::Output::XML::Element>);
 my %element_stack_of   :ARRAY(:name<element_stack>  :type<TeX::Output::XML::Element>);
 
+## Text is collected in pending_text and added to the current element
+## with a single appendText() call the next time someone asks for the
+## current element (to open or close an element, add an attribute,
+## etc.) or the DOM, or the document is closed.
+
+my %pending_text_of :ATTR(:name<pending_text> :default<"">);
+
 my %xml_id_of :HASH(:name<xml_id>);
 my %xml_id_counter_of :COUNTER(:name<xml_id_counter>);
 
@@ -152,14 +180,12 @@ sub new_xml_element {
 ## perl's UTF8 flag is explicitly turned on, and this is the only way
 ## to ensure that.
 
-my sub __new_utf8_char {
-    my $char_code = shift;
-
-    my $char = chr($char_code);
+my sub __utf8_text {
+    my $text = shift;
 
-    utf8::upgrade($char);
+    utf8::upgrade($text);
 
-    return $char;
+    return $text;
 }
 
 ######################################################################
@@ -286,12 +312,111 @@ sub __normalize_id {
     return $new_id;
 }
 
+## index_document() makes a single pass over the finished document
+## (or over the subtree rooted at $root).
+## Empty paragraphs are deleted as they are found, and everything the
+## remaining clean-up steps need is collected, in document order:
+##
+##     rid        : elements with a rid attribute
+##     id         : elements with an id attribute
+##     css_id     : text nodes inside a tex-math element that contain
+##                  a \cssId
+##     xref_group : xref-group elements
+##
+## normalize_ids() rewrites the rids before the ids, and so on, just
+## as the old series of XPath queries did, so that the texmlidN names
+## are handed out in the same order.  While it does the ids it also
+## counts them, which is all flag_duplicate_ids() needs.
+
+sub __is_empty_paragraph {
+    my $p = shift;
+
+    # Delete empty p tags.  Ideally texml wouldn't generate these, but
+    # getting rid of all of them could be tricky.
+    # Cf. TeX::Interpreter::__is_empty_par()
+
+    # Question: Should we remove paragraphs that have attributes?
+    # Ditto comments.  At present we don't generate those, but there
+    # might be good reasons to do so in the future.
+
+    return if $p->hasAttributes();
+
+    for my $child ($p->childNodes()) {
+        my $type = $child->nodeType();
+
+        return unless $type == XML_TEXT_NODE || $type == XML_CDATA_SECTION_NODE;
+
+        return if $child->data() =~ m{[^ \t\r\n]};
+    }
+
+    return 1;
+}
+
+sub index_document {
+    my $self = shift;
+
+    my $root = shift // $self->get_dom()->documentElement();
+
+    my $tex = $self->get_tex_engine();
+
+    my %index = (rid => [], id => [], css_id => [], xref_group => []);
+
+    return \%index unless defined $root;
+
+    # Each entry is a node and a flag saying whether it's inside a
+    # tex-math element.  Children are pushed in reverse so they come
+    # off the stack in document order.
+
+    my @stack = ([ $root, 0 ]);
+
+    while (my $entry = pop @stack) {
+        my ($node, $in_math) = @{ $entry };
+
+        my $type = $node->nodeType();
+
+        if ($type == XML_TEXT_NODE) {
+            if ($in_math && index($node->data(), '\cssId') >= 0) {
+                push @{ $index{css_id} }, $node;
+            }
+
+            next;
+        }
+
+        next unless $type == XML_ELEMENT_NODE;
+
+        my $name = $node->nodeName();
+
+        if ($name eq 'p' && __is_empty_paragraph($node)) {
+            $tex->print_err(qq{Deleting empty paragraph: $node});
+
+            # $tex->error();
+
+            $node->unbindNode();
+
+            next;
+        }
+
+        push @{ $index{rid} }, $node if $node->hasAttribute('rid');
+        push @{ $index{id}  }, $node if $node->hasAttribute('id');
+
+        if ($name eq 'tex-math') {
+            $in_math = 1;
+        } elsif ($name eq 'xref-group') {
+            push @{ $index{xref_group} }, $node;
+        }
+
+        push @stack, map { [ $_, $in_math ] } reverse $node->childNodes();
+    }
+
+    return \%index;
+}
+
 sub normalize_ids {
     my $self = shift;
 
-    my $dom = $self->get_dom();
+    my $index = shift;
 
-    for my $node ($dom->findnodes("/descendant::*[\@rid]")) {
+    for my $node (@{ $index->{rid} }) {
         my $id = $node->getAttribute('rid');
         my $new_id = $self->__normalize_id($id);
 
@@ -300,20 +425,34 @@ sub normalize_ids {
         }
     }
 
-    for my $node ($dom->findnodes("/descendant::*[\@id]")) {
+    my %id_count;
+
+    my @ids;
+
+    for my $node (@{ $index->{id} }) {
         my $id = $node->getAttribute('id');
         my $new_id = $self->__normalize_id($id);
 
         if ($id ne $new_id) {
             $node->setAttribute(id => $new_id);
         }
+
+        push @ids, $new_id if $id_count{$new_id}++ == 0;
     }
 
-    for my $node ($dom->findnodes("/descendant::tex-math")) {
-        $self->__replace_cssID($node);
+    $index->{id_count} = \%id_count;
+    $index->{ids}      = \@ids;
+
+    for my $node (@{ $index->{css_id} }) {
+        my $text = $node->data();
+
+        $text =~ s{\\cssId\{(.*?)\}\{\}}
+                  { sprintf q{\cssId{%s}{}}, $self->__normalize_id($1) }smxeg;
+
+        $node->setData($text);
     }
 
-    for my $group ($dom->findnodes(qq{descendant::xref-group})) {
+    for my $group (@{ $index->{xref_group} }) {
         if (nonempty(my $id = $group->getAttribute('first'))) {
             $group->setAttribute(first => $self->__normalize_id($id));
         }
@@ -334,86 +473,347 @@ sub normalize_ids {
     return;
 }
 
-sub __replace_cssID {
+## Output hooks run in stages, in order of priority; hooks with the
+## same priority run in the order they were added.
+##
+## Rather than searching the whole document itself, a hook can list
+## the elements it wants as selectors, each of which is a
+## |-separated list of element names, optionally preceded by the name
+## of the parent element and a / and followed by an [@attribute] test:
+##
+##     $tex->add_output_hook(\&normalize_figures, 0, [ qw(fig-group fig) ]);
+##     $tex->add_output_hook(\&add_section_alt_titles, 10, [ "sec/title|app/title" ]);
+##     $tex->add_output_hook(\&do_showonlyrefs, 0, [ 'tag[@SOR_key]' ]);
+##
+## Before each stage we make one pass over the document to find the
+## elements selected by any hook in that stage.  The hook is then
+## called as
+##
+##     $sub->($xml, { $selector => [ @elements ], ... })
+##
+## with the elements in document order.  Elements that an earlier
+## hook in the same stage removed from the document are left out, but
+## elements that it added are not found until the next stage, so a
+## hook that depends on another hook's output should run at a higher
+## priority.
+##
+## get_elements_by_id() falls back on an id index that is likewise
+## built at most once per stage.
+
+sub __parse_selector {
+    my $selector = shift;
+
+    my @alternatives;
+
+    for my $alternative (split /\|/, $selector) {
+        if ($alternative =~ m{\A (?: ([^\[\s/]+) / )? ([^\[\s/]+) (?: \[ \@ ([^\]\s]+) \] )? \z}smx) {
+            push @alternatives, [ $2, $3, $1 ];
+        } else {
+            die "Invalid output hook selector '$selector'\n";
+        }
+    }
+
+    return @alternatives;
+}
+
+sub __is_attached {
+    my $node = shift;
+
+    while (defined(my $parent = $node->parentNode())) {
+        $node = $parent;
+    }
+
+    return $node->nodeType() == XML_DOCUMENT_NODE;
+}
+
+sub __walk_elements {
+    my $root = shift;
+
+    my $code = shift;
+
+    my @stack = ($root);
+
+    while (defined(my $node = pop @stack)) {
+        next unless $node->nodeType() == XML_ELEMENT_NODE;
+
+        $code->($node);
+
+        push @stack, reverse $node->childNodes();
+    }
+
+    return;
+}
+
+sub select_elements {
+    my $self = shift;
+
+    return $self->select_subtree_elements($self->get_dom()->documentElement(), @_);
+}
+
+sub select_subtree_elements {
+    my $self = shift;
+
+    my $root = shift;
+
+    my @selectors = uniq @_;
+
+    my %selected = map { $_ => [] } @selectors;
+
+    return \%selected unless @selectors && defined $root;
+
+    my %wanted; # element name => [ [ selector, attribute, parent ], ... ]
+
+    for my $selector (@selectors) {
+        for my $alternative (__parse_selector($selector)) {
+            my ($name, $attribute, $parent) = @{ $alternative };
+
+            push @{ $wanted{$name} }, [ $selector, $attribute, $parent ];
+        }
+    }
+
+    __walk_elements($root, sub {
+        my $node = shift;
+
+        my $wanted = $wanted{ $node->nodeName() } or return;
+
+        for my $entry (@{ $wanted }) {
+            my ($selector, $attribute, $parent) = @{ $entry };
+
+            next if defined $attribute && ! $node->hasAttribute($attribute);
+
+            if (defined $parent) {
+                my $parent_node = $node->parentNode();
+
+                next unless defined $parent_node && $parent_node->nodeName() eq $parent;
+            }
+
+            push @{ $selected{$selector} }, $node;
+        }
+    });
+
+    return \%selected;
+}
+
+## Drops what the live indexes know about the given ids for elements
+## that are no longer in the document, so that they can be freed.
+
+sub prune_live_index {
     my $self = shift;
 
+    my $ident = ident $self;
+
+    for my $id (uniq @_) {
+        if (defined(my $elements = $live_ids_of{$ident}->{$id})) {
+            @{ $elements } = grep { __has_id($_, $id) } @{ $elements };
+
+            delete $live_ids_of{$ident}->{$id} unless @{ $elements };
+        }
+
+        if (defined(my $referrers = $referrers_of{$ident}->{$id})) {
+            @{ $referrers } = grep { __is_attached($_) } @{ $referrers };
+
+            delete $referrers_of{$ident}->{$id} unless @{ $referrers };
+        }
+    }
+
+    return;
+}
+
+## True if $node is still in the document and still has the given id.
+
+sub __has_id {
     my $node = shift;
+    my $id   = shift;
+
+    my $node_id = $node->getAttribute('id');
 
-    for my $child ($node->childNodes()) {
-        if ($child->nodeType() == XML_TEXT_NODE) {
-            my $text = $child->data();
+    return defined $node_id && $node_id eq $id && __is_attached($node);
+}
 
-            $text =~ s{\\cssId\{(.*?)\}\{\}}
-                      { sprintf q{\cssId{%s}{}}, $self->__normalize_id($1) }smxeg;
+## Sorts attached elements into document order, dropping duplicates.
 
-            $child->setData($text);
-        } else {
-            $self->__replace_cssID($child);
+sub __in_document_order {
+    my %seen;
+
+    my @elements = grep { ! $seen{ $_->unique_key() }++ } @_;
+
+    return @elements if @elements < 2;
+
+    my %path_of;
+
+    for my $element (@elements) {
+        my @path;
+
+        for (my $node = $element; defined(my $parent = $node->parentNode()); $node = $parent) {
+            my $position = 0;
+
+            for (my $sibling = $node; defined($sibling = $sibling->previousSibling()); ) {
+                $position++;
+            }
+
+            unshift @path, $position;
         }
+
+        $path_of{ $element->unique_key() } = \@path;
     }
 
+    my $compare = sub {
+        my @a = @{ $path_of{ $_[0]->unique_key() } };
+        my @b = @{ $path_of{ $_[1]->unique_key() } };
+
+        while (@a && @b) {
+            my $cmp = shift(@a) <=> shift(@b);
+
+            return $cmp if $cmp;
+        }
+
+        return @a <=> @b;
+    };
+
+    return sort { $compare->($a, $b) } @elements;
+}
+
+## Code that adds elements with ids to the document without going
+## through open_element(), add_attribute() or set_element_attribute()
+## should call this so that get_elements_by_id() knows to look again.
+
+sub note_dom_change {
+    my $self = shift;
+
+    $self->incr_dom_generation();
+
     return;
 }
 
-sub delete_empty_paragraphs {
+sub __id_index {
     my $self = shift;
 
-    my $dom = $self->get_dom();
+    my $ident = ident $self;
 
-    my $tex = $self->get_tex_engine();
+    my $index = $id_index_of{$ident};
 
-    # Delete empty p tags.  Ideally texml wouldn't generate these, but
-    # getting rid of all of them could be tricky.
-    # Cf. TeX::Interpreter::__is_empty_par()
+    return $index if defined $index
+        && $id_index_generation_of{$ident} == $dom_generation_of{$ident};
+
+    my %index;
+
+    if (defined(my $root = $self->get_dom()->documentElement())) {
+        __walk_elements($root, sub {
+            my $node = shift;
+
+            if (defined(my $id = $node->getAttribute('id'))) {
+                push @{ $index{$id} }, $node;
+            }
+        });
+    }
+
+    $id_index_generation_of{$ident} = $dom_generation_of{$ident};
+
+    return $id_index_of{$ident} = \%index;
+}
+
+## All of the elements in the document with the given id, in document
+## order.  There should only ever be one, but callers that care can
+## complain about the rest.
+
+sub get_elements_by_id {
+    my $self = shift;
 
-    # Question: Should we remove '@*'?  I.e., should we remove empty
-    # paragraphs even if they have attributes? Ditto comments.  At
-    # present we don't generate those, but there might be good reasons
-    # to do so in the future.
+    my $id = shift;
 
-    for my $p ($dom->findnodes(qq{/descendant::p[not(@*|*|comment()|processing-instruction()) and normalize-space()='']})) {
-        $tex->print_err(qq{Deleting empty paragraph: $p});
+    my $elements = $live_ids_of{ident $self}->{$id};
 
-        # $tex->error();
+    my @found = defined $elements ? grep { __has_id($_, $id) } @{ $elements } : ();
 
-        $p->unbindNode();
+    if (! @found) {
+        @found = grep { __has_id($_, $id) } @{ $self->__id_index()->{$id} || [] };
     }
 
-    return;
+    return __in_document_order(@found);
 }
 
-sub run_hooks {
+## The first element in the document with the given id.
+
+sub get_element_by_id {
+    my $self = shift;
+
+    my $id = shift;
+
+    my ($element) = $self->get_elements_by_id($id);
+
+    return $element;
+}
+
+## The elements whose rid attribute includes $id, in document order.
+## Unlike get_elements_by_id(), this only sees rid attributes that were
+## set through open_element(), add_attribute() or
+## set_element_attribute(): searching the whole document on every call
+## is exactly what it is meant to avoid.  Code that sets rid with
+## setAttribute() won't have its elements found here.
+
+sub get_referrers {
+    my $self = shift;
+
+    my $id = shift;
+
+    my $referrers = $referrers_of{ident $self}->{$id};
+
+    return unless defined $referrers;
+
+    return __in_document_order(grep {
+        my $rid = $_->getAttribute('rid');
+
+        defined $rid && (grep { $_ eq $id } split ' ', $rid) && __is_attached($_);
+    } @{ $referrers });
+}
+
+## Returns a list of stages in order of priority, each a list of
+## [ $sub, $selectors ] pairs.
+
+sub get_hook_stages {
     my $self = shift;
 
     my @stages;
 
     for my $hook ($self->get_hooks()) {
-        my ($priority, $sub) = $hook->@*;
+        my ($priority, $sub, $selectors) = $hook->@*;
 
-        push $stages[$priority]->@*, $sub;
+        push $stages[$priority]->@*, [ $sub, $selectors // [] ];
     }
 
-    for my $stage (@stages) {
-        next unless defined $stage;
+    return grep { defined } @stages;
+}
+
+sub run_hooks {
+    my $self = shift;
+
+    for my $stage ($self->get_hook_stages()) {
+        $self->delete_id_index();
+
+        my $selected = $self->select_elements(map { $_->[1]->@* } $stage->@*);
 
         for my $hook ($stage->@*) {
-            $hook->($self);
+            my ($sub, $selectors) = $hook->@*;
+
+            my %nodes = map { $_ => [ grep { __is_attached($_) } $selected->{$_}->@* ] } $selectors->@*;
+
+            $sub->($self, \%nodes);
         }
     }
 
+    $self->delete_id_index();
+
     return;
 }
 
 sub flag_duplicate_ids {
     my $self = shift;
 
-    my $dom = $self->get_dom();
-
-    my @ids = $dom->findnodes(q{//attribute::id});
+    my $index = shift;
 
-    map { s{^\s*id="(.*?)"\s*$}{$1} } @ids;
+    my $id_count = $index->{id_count};
 
-    if (my @dups = duplicates @ids) {
+    if (my @dups = grep { $id_count->{$_} > 1 } @{ $index->{ids} }) {
         my $tex = $self->get_tex_engine();
 
         $tex->print_ln;
@@ -431,13 +831,15 @@ sub flag_duplicate_ids {
 sub finalize_document {
     my $self = shift;
 
+    $self->flush_pending_text();
+
     $self->run_hooks();
 
-    $self->delete_empty_paragraphs();
+    my $index = $self->index_document();
 
-    $self->normalize_ids();
+    $self->normalize_ids($index);
 
-    $self->flag_duplicate_ids();
+    $self->flag_duplicate_ids($index);
 
     return;
 }
@@ -554,11 +956,49 @@ sub append_text {
 
     my $text = shift;
 
-    return if length($text) == 0;
+    $pending_text_of{ident $self} .= $text;
 
-    my $current_element = $self->get_current_element();
+    return;
+}
+
+sub flush_pending_text {
+    my $self = shift;
 
-    $current_element->appendText($text);
+    my $ident = ident $self;
+
+    return if length($pending_text_of{$ident}) == 0;
+
+    $current_element_of{$ident}->appendText($pending_text_of{$ident});
+
+    $pending_text_of{$ident} = "";
+
+    return;
+}
+
+sub get_current_element {
+    my $self = shift;
+
+    $self->flush_pending_text();
+
+    return $current_element_of{ident $self};
+}
+
+sub get_dom {
+    my $self = shift;
+
+    $self->flush_pending_text();
+
+    return $dom_of{ident $self};
+}
+
+## complete_output_file() is called once the document returned by
+## close_document() has been written to $file_name.  Subclasses that
+## don't keep the whole document in memory use it to fill in the rest.
+
+sub complete_output_file {
+    my $self = shift;
+
+    my $file_name = shift;
 
     return;
 }
@@ -671,12 +1111,18 @@ sub open_element {
         while (my ($key, $val) = each %{ $atts }) {
             if (nonempty($key)) {
                 $element->setAttribute($key, $val);
+
+                if ($key eq 'id' || $key eq 'rid') {
+                    $self->__index_attribute($element, $key, $val);
+                }
             }
         }
     }
 
     $self->push_element(new_xml_element($element, $props));
 
+    $self->incr_dom_generation();
+
     return;
 }
 
@@ -699,7 +1145,66 @@ sub add_attribute {
     if (nonempty($value)) {
         my $current_element = $self->get_current_element();
 
-        $current_element->setAttribute($qName, $value);
+        if ($qName eq 'id' || $qName eq 'rid') {
+            my $node = $current_element->get_node();
+
+            my $old_value = $node->getAttribute($qName);
+
+            $node->setAttribute($qName, $value);
+
+            if (! defined $old_value || $old_value ne $value) {
+                $self->__index_attribute($node, $qName, $value);
+            }
+        } else {
+            $current_element->setAttribute($qName, $value);
+        }
+    }
+
+    return;
+}
+
+## For code that modifies the DOM directly: like $node->setAttribute(),
+## but keeps the live id and rid indexes up to date.
+
+sub set_element_attribute {
+    my $self = shift;
+
+    my $node  = shift;
+    my $qName = shift;
+    my $value = shift;
+
+    $node->setAttribute($qName, $value);
+
+    if ($qName eq 'id' || $qName eq 'rid') {
+        $self->__index_attribute($node, $qName, $value);
+    }
+
+    return;
+}
+
+sub __index_attribute {
+    my $self = shift;
+
+    my $node  = shift;
+    my $qName = shift;
+    my $value = shift;
+
+    my $ident = ident $self;
+
+    $self->incr_dom_generation();
+
+    if ($qName eq 'id') {
+        ## Keep every element given the id, so get_elements_by_id() can
+        ## count collisions.  Lookups drop the ones that have lost it.
+
+        my $elements = $live_ids_of{$ident}->{$value} //= [];
+
+        push @{ $elements }, $node
+            unless @{ $elements } && $elements->[-1]->isSameNode($node);
+    } else {
+        for my $id (split ' ', $value) {
+            push @{ $referrers_of{$ident}->{$id} }, $node;
+        }
     }
 
     return;
@@ -778,260 +1283,242 @@ sub set_css_property {
 ##                                                                  ##
 ######################################################################
 
-sub hlist_out {
-    my $self = shift;
-
-    my $box = shift;
+## hlist_out() and vlist_out() look up a handler for each node in a
+## table indexed by the node's type (see
+## TeX::Node::AbstractNode::node_type()).  The type of each class is
+## looked up once and cached.  A handler is called as
+##
+##     $handler->($self, $tex, $node, \@remaining_nodes)
+##
+## and may consume more nodes from @remaining_nodes.
 
-    my $tex = $self->get_tex_engine();
-
-    my @nodes = $box->get_nodes();
+my %NODE_TYPE_OF;
 
-    while (defined(my $node = shift @nodes)) {
-        if ($node->isa('TeX::Token')) { ## Extension
-            $self->append_text($node);
-
-            next;
-        }
-
-        ## HLIST ONLY
-
-        if ($node->isa('TeX::Node::MathNode')) {
-            $self->append_text(" "); # ???
-
-            next;
-        }
-
-        if ($node->isa('TeX::Node::UTemplateMarker')) {
-            next;
-        }
-
-        ## HLIST SPECIFIC HANDLING
-
-        if ($node->is_glue()) {
-            $self->append_text(" ");
-
-            next;
-        }
-
-        if ($node->is_kern()) {
-            $self->append_text(" ");
-
-            next;
-        }
-
-        ## COMMON
-
-        if ($node->isa('TeX::Node::Extension::UnicodeStringNode')) {
-            $self->append_text($node->get_contents());
+my sub node_type_of {
+    my $node = shift;
 
-            next;
-        }
+    return $NODE_TYPE_OF{ref $node} //=
+        $node->isa('TeX::Token') ? token_node : $node->node_type();
+}
 
-        if ($node->is_char_node()) {
-            my $enc = $node->get_encoding();
+my sub append_token {
+    my ($self, $tex, $node) = @_;
 
-            my $char_code = $node->get_char_code();
+    $self->append_text($node); ## Extension
 
-            if ($enc ne UCS) {
-                $char_code = $tex->decode_character($char_code, $enc);
-            }
+    return;
+}
 
-            $self->append_text(__new_utf8_char($char_code));
+my sub append_space {
+    my ($self, $tex, $node) = @_;
 
-            next;
-        }
+    $self->append_text(" ");
 
-        if ($node->isa('TeX::Node::XmlNode')) {
-            $self->output_xml_node($node);
+    return;
+}
 
-            next;
-        }
+my sub ignore_node {
+    return;
+}
 
-        if ($node->is_vbox()) {
-            $self->vlist_out($node);
+my sub append_unicode_string {
+    my ($self, $tex, $node) = @_;
 
-            next;
-        }
+    $self->append_text($node->get_contents());
 
-        if ($node->is_hbox()) {
-            $self->hlist_out($node);
+    return;
+}
 
-            next;
-        }
+## Appends $node and all of the character nodes that immediately
+## follow it with a single appendText() call.
 
-        if ($node->is_rule()) {
-            ## rule_ht := height(p);
-            ## rule_dp := depth(p);
-            ## rule_wd := width(p);
-            ## goto fin_rule;
+my sub append_char_run {
+    my ($self, $tex, $node, $nodes) = @_;
 
-            $tex->print_err("RuleNodes not implemented yet");
-            $tex->error();
+    my $text = "";
 
-            next;
-        }
+    while (1) {
+        my $enc = $node->get_encoding();
 
-        if ($node->isa("TeX::Node::FileNode")) {
-            $tex->do_file_output($node);
+        if ($enc eq UCS) {
+            $text .= chr($node->get_char_code());
+        } else {
+            my $map = eval { $tex->get_font_encoding($enc) };
 
-            next;
-        }
+            if (defined $map) {
+                my $decode = $map->{decode};
 
-        if ($node->isa("TeX::Node::LanguageNode")) {
-            ## NO-OP
+                my $char_code = $node->get_char_code();
 
-            next;
+                $text .= chr($decode->[$char_code] // $char_code);
+            } else {
+                $text .= chr($tex->decode_character($node->get_char_code(), $enc));
+            }
         }
 
-        if ($node->isa("TeX::Node::WhatsitNode")) {
-            ## @<Output the whatsit node |p| in an hlist@>;
-
-            my $type = ref($node);
+        last unless @{ $nodes } && node_type_of($nodes->[0]) == char_node;
 
-            $tex->print_err("$type not implemented yet");
-            $tex->error();
+        $node = shift @{ $nodes };
+    }
 
-            next;
-        }
+    $self->append_text(__utf8_text($text));
 
-        if ($node->isa('TeX::Node::MarkNode')) {
-            next;
-        }
+    return;
+}
 
-        if ($node->isa('TeX::Node::PenaltyNode')) {
-            next;
-        }
+my sub unexpected_char {
+    my ($self, $tex, $node) = @_;
 
-        $tex->print_err("I didn't expect to find '$node' (",
-                        ref($node),
-                        ") in the middle of an hlist!");
+    # This should no longer happen.
 
-        $tex->error();
-    }
+    $tex->confusion("vlistout: character '$node' in vmode");
 
     return;
 }
 
-sub vlist_out {
-    my $self = shift;
+my sub ship_xml_node {
+    my ($self, $tex, $node) = @_;
 
-    my $box = shift;
+    $self->output_xml_node($node);
 
-    my $tex = $self->get_tex_engine();
-
-    my @nodes = $box->get_nodes();
-
-    while (defined(my $node = shift @nodes)) {
-        if ($node->isa('TeX::Token')) { ## Extension
-            $self->append_text($node);
+    return;
+}
 
-            next;
-        }
+my sub ship_vlist {
+    my ($self, $tex, $node) = @_;
 
-        ## VLIST SPECIFIC HANDLING
+    $self->vlist_out($node);
 
-        if ($node->is_glue()) {
-            ## IGNORE
+    return;
+}
 
-            next;
-        }
+my sub ship_hlist {
+    my ($self, $tex, $node) = @_;
 
-        if ($node->is_kern()) {
-            ## IGNORE
+    $self->hlist_out($node);
 
-            next;
-        }
+    return;
+}
 
-        ## COMMON
+my sub ship_rule {
+    my ($self, $tex, $node) = @_;
 
-        if ($node->isa('TeX::Node::Extension::UnicodeStringNode')) {
-            $self->append_text($node->get_contents());
+    ## rule_ht := height(p);
+    ## rule_dp := depth(p);
+    ## rule_wd := width(p);
+    ## goto fin_rule;
 
-            next;
-        }
+    $tex->print_err("RuleNodes not implemented yet");
+    $tex->error();
 
-        if ($node->is_char_node()) {
-            # This should no longer happen.
+    return;
+}
 
-            $tex->confusion("vlistout: character '$node' in vmode");
+my sub ship_file_node {
+    my ($self, $tex, $node) = @_;
 
-            # # ...but it does.
+    $tex->do_file_output($node);
 
-            # my $char = __new_utf8_char($node->get_char_code());
+    return;
+}
 
-            # $self->append_text($char);
+my sub ship_whatsit {
+    my ($self, $tex, $node) = @_;
 
-            next;
-        }
+    ## @<Output the whatsit node |p| in an hlist@>;
 
-        if ($node->isa('TeX::Node::XmlNode')) {
-            $self->output_xml_node($node);
+    my $type = ref($node);
 
-            next;
-        }
+    $tex->print_err("$type not implemented yet");
+    $tex->error();
 
-        if ($node->is_vbox()) {
-            $self->vlist_out($node);
+    return;
+}
 
-            next;
-        }
+my sub unexpected_node {
+    my ($self, $tex, $node) = @_;
 
-        if ($node->is_hbox()) {
-            $self->hlist_out($node);
+    $tex->print_err("I didn't expect to find '$node' (",
+                    ref($node),
+                    ") in the middle of an hlist!");
 
-            next;
-        }
+    $tex->error();
 
-        if ($node->is_rule()) {
-            ## rule_ht := height(p);
-            ## rule_dp := depth(p);
-            ## rule_wd := width(p);
-            ## goto fin_rule;
+    return;
+}
 
-            $tex->print_err("RuleNodes not implemented yet");
-            $tex->error();
+my @HLIST_OUT;
+
+$HLIST_OUT[token_node]          = \&append_token;
+$HLIST_OUT[math_node]           = \&append_space; # ???
+$HLIST_OUT[u_template_node]     = \&ignore_node;
+$HLIST_OUT[glue_node]           = \&append_space;
+$HLIST_OUT[kern_node]           = \&append_space;
+$HLIST_OUT[unicode_string_node] = \&append_unicode_string;
+$HLIST_OUT[char_node]           = \&append_char_run;
+$HLIST_OUT[xml_node]            = \&ship_xml_node;
+$HLIST_OUT[vlist_node]          = \&ship_vlist;
+$HLIST_OUT[hlist_node]          = \&ship_hlist;
+$HLIST_OUT[rule_node]           = \&ship_rule;
+$HLIST_OUT[file_node]           = \&ship_file_node;
+$HLIST_OUT[language_node]       = \&ignore_node;
+$HLIST_OUT[whatsit_node]        = \&ship_whatsit;
+$HLIST_OUT[mark_node]           = \&ignore_node;
+$HLIST_OUT[penalty_node]        = \&ignore_node;
+
+my @VLIST_OUT;
+
+$VLIST_OUT[token_node]          = \&append_token;
+$VLIST_OUT[glue_node]           = \&ignore_node;
+$VLIST_OUT[kern_node]           = \&ignore_node;
+$VLIST_OUT[unicode_string_node] = \&append_unicode_string;
+$VLIST_OUT[char_node]           = \&unexpected_char;
+$VLIST_OUT[xml_node]            = \&ship_xml_node;
+$VLIST_OUT[vlist_node]          = \&ship_vlist;
+$VLIST_OUT[hlist_node]          = \&ship_hlist;
+$VLIST_OUT[rule_node]           = \&ship_rule;
+$VLIST_OUT[file_node]           = \&ship_file_node;
+$VLIST_OUT[language_node]       = \&ignore_node;
+$VLIST_OUT[whatsit_node]        = \&ship_whatsit;
+$VLIST_OUT[mark_node]           = \&ignore_node;
+$VLIST_OUT[penalty_node]        = \&ignore_node;
+
+my sub list_out {
+    my $self    = shift;
+    my $box     = shift;
+    my $handler = shift;
 
-            next;
-        }
+    my $tex = $self->get_tex_engine();
 
-        if ($node->isa("TeX::Node::FileNode")) {
-            $tex->do_file_output($node);
+    my @nodes = $box->get_nodes();
 
-            next;
-        }
+    while (defined(my $node = shift @nodes)) {
+        my $type = node_type_of($node);
 
-        if ($node->isa("TeX::Node::LanguageNode")) {
-            ## NO-OP
+        my $out = defined $type ? $handler->[$type] : undef;
 
-            next;
-        }
+        ($out // \&unexpected_node)->($self, $tex, $node, \@nodes);
+    }
 
-        if ($node->isa("TeX::Node::WhatsitNode")) {
-            ## @<Output the whatsit node |p| in an hlist@>;
+    return;
+}
 
-            my $type = ref($node);
+sub hlist_out {
+    my $self = shift;
 
-            $tex->print_err("$type not implemented yet");
-            $tex->error();
+    my $box = shift;
 
-            next;
-        }
+    list_out($self, $box, \@HLIST_OUT);
 
-        if ($node->isa('TeX::Node::MarkNode')) {
-            next;
-        }
+    return;
+}
 
-        if ($node->isa('TeX::Node::PenaltyNode')) {
-            next;
-        }
+sub vlist_out {
+    my $self = shift;
 
-        $tex->print_err("I didn't expect to find '$node' (",
-                        ref($node),
-                        ") in the middle of an hlist!");
+    my $box = shift;
 
-        $tex->error();
-    }
+    list_out($self, $box, \@VLIST_OUT);
 
     return;
 }
@@ -61,6 +61,8 @@ sub open_document {
 sub close_document {
     my $self = shift;
 
+    $self->flush_pending_text();
+
     return $self->get_fragment();
 }
 
@@ -0,0 +1,327 @@
+package TeX::Output::XML::PrettyPrinter;
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use warnings;
+
+## TeX::Output::XML::PrettyPrinter writes a DOM to a file, indented,
+## in a single pass.
+##
+## It replaces the two-step process bin/texml used to use (and still
+## does with -nobuiltin_pp), in which the DOM is written with
+## $dom->toFile($file, 1) and then re-parsed with XML::Twig (xml_pp) in
+## order to remove the indentation libxml2 added inside elements like
+## <p> and <title>, where it is significant.  It produces the same
+## output:
+##
+##     * Elements that contain no text are indented the way libxml2
+##       does it: each child on its own line, two spaces per level, up
+##       to 30 levels.  Any element with a text child, together with
+##       everything inside it, is written as is.
+##
+##     * Inside the elements listed in discard_spaces_in, no
+##       indentation is added, and whitespace-only text containing a
+##       newline is dropped.  (A lone space between two elements is
+##       kept, as XML::Twig would keep it.)
+##
+## The file is written to a temporary file in the same directory and
+## renamed into place, so nobody ever sees a half-written file.
+
+use File::Basename;
+use File::Temp;
+
+use List::Util qw(any min);
+
+use TeX::Class;
+
+use XML::LibXML qw(:libxml);
+
+use constant DEFAULT_DISCARD_SPACES_IN => qw(p label term texml:line title
+                                             cite-group xref-group);
+
+use constant INDENT     => "  ";
+use constant MAX_INDENT => 30;      # libxml2's limit
+
+my %discard_spaces_in_of :HASH(:name<discard_spaces_in>);
+
+######################################################################
+##                                                                  ##
+##                           CONSTRUCTOR                            ##
+##                                                                  ##
+######################################################################
+
+sub START {
+    my ($self, $ident, $arg_ref) = @_;
+
+    my @names = @{ $arg_ref->{discard_spaces_in} // [ DEFAULT_DISCARD_SPACES_IN ] };
+
+    $discard_spaces_in_of{$ident} = { map { $_ => 1 } @names };
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                              OUTPUT                              ##
+##                                                                  ##
+######################################################################
+
+## Dies on failure.
+
+sub write_document {
+    my $self = shift;
+
+    my $dom  = shift;
+    my $file = shift;
+
+    my $encoding = $dom->encoding() || "UTF-8";
+
+    my $tmp = File::Temp->new(DIR    => dirname($file),
+                              UNLINK => 0,
+                              SUFFIX => ".tmp");
+
+    my $tmp_file = $tmp->filename();
+
+    eval {
+        binmode($tmp, ":encoding($encoding)");
+
+        $self->__write_document($tmp, $dom, $encoding);
+
+        close($tmp) or die "Can't write $tmp_file: $!\n";
+
+        chmod(0666 & ~umask(), $tmp_file);
+
+        rename($tmp_file, $file) or die "Can't rename $tmp_file to $file: $!\n";
+    };
+
+    if (my $error = $@) {
+        unlink $tmp_file;
+
+        die $error;
+    }
+
+    return;
+}
+
+## write_node() writes a single node the way write_document() would
+## write it $level levels down.  $format should be false if the node
+## is inside an element that has text children.
+
+sub write_node {
+    my $self = shift;
+
+    my $fh     = shift;
+    my $node   = shift;
+    my $level  = shift;
+    my $format = shift;
+
+    $self->__write_node($fh, $node, $level, $format);
+
+    return;
+}
+
+sub __write_document {
+    my $self = shift;
+
+    my $fh       = shift;
+    my $dom      = shift;
+    my $encoding = shift;
+
+    my $version = $dom->version() || "1.0";
+
+    my $standalone = $dom->standalone();
+
+    print { $fh } qq{<?xml version="$version" encoding="$encoding"};
+
+    if ($standalone == 1) {
+        print { $fh } qq{ standalone="yes"};
+    } elsif ($standalone == 0) {
+        print { $fh } qq{ standalone="no"};
+    }
+
+    print { $fh } qq{?>\n};
+
+    for my $node ($dom->childNodes()) {
+        $self->__write_node($fh, $node, 0, 1);
+
+        print { $fh } "\n";
+    }
+
+    return;
+}
+
+sub __write_node {
+    my $self = shift;
+
+    my $fh     = shift;
+    my $node   = shift;
+    my $level  = shift;
+    my $format = shift;
+
+    if ($node->nodeType() == XML_ELEMENT_NODE) {
+        $self->__write_element($fh, $node, $level, $format);
+    } else {
+        print { $fh } $node->toString();
+    }
+
+    return;
+}
+
+sub __is_text {
+    my $node = shift;
+
+    return unless defined $node;
+
+    my $type = $node->nodeType();
+
+    return $type == XML_TEXT_NODE
+        || $type == XML_CDATA_SECTION_NODE
+        || $type == XML_ENTITY_REF_NODE;
+}
+
+## A run of whitespace that XML::Twig would have thrown away:
+## whitespace only, containing a newline and not part of a longer run
+## of text.
+
+sub __is_discardable {
+    my $node = shift;
+
+    return unless $node->nodeType() == XML_TEXT_NODE;
+
+    my $data = $node->data();
+
+    return unless $data =~ m{\A [ \t\r\n]* \z}smx && $data =~ m{\n};
+
+    return ! __is_text($node->previousSibling())
+        && ! __is_text($node->nextSibling());
+}
+
+## XML::Twig leaves ">" alone in attribute values, so we do too.
+
+sub __escape_attribute {
+    my $value = shift;
+
+    $value =~ s{&}{&amp;}g;
+    $value =~ s{<}{&lt;}g;
+    $value =~ s{"}{&quot;}g;
+    $value =~ s{\n}{&#10;}g;
+    $value =~ s{\r}{&#13;}g;
+    $value =~ s{\t}{&#9;}g;
+
+    return $value;
+}
+
+sub __start_tag {
+    my $element = shift;
+
+    my $tag = "<" . $element->nodeName();
+
+    ## Namespace declarations come first, as in libxml2.
+
+    for my $ns ($element->getNamespaces()) {
+        my $prefix = $ns->declaredPrefix();
+
+        my $name = defined $prefix && length $prefix ? "xmlns:$prefix" : "xmlns";
+
+        $tag .= qq{ $name="} . __escape_attribute($ns->declaredURI()) . qq{"};
+    }
+
+    for my $attr ($element->attributes()) {
+        next unless $attr->nodeType() == XML_ATTRIBUTE_NODE;
+
+        $tag .= " " . $attr->nodeName() . q{="} . __escape_attribute($attr->getValue()) . q{"};
+    }
+
+    return $tag;
+}
+
+sub __write_element {
+    no warnings 'recursion';
+
+    my $self = shift;
+
+    my $fh      = shift;
+    my $element = shift;
+    my $level   = shift;
+    my $format  = shift;
+
+    my @children = $element->childNodes();
+
+    my $discard = $self->get_discard_spaces_in($element->nodeName());
+
+    ## As in libxml2, the decision not to indent is made before any
+    ## whitespace is discarded.
+
+    my $child_format = $format && ! any { __is_text($_) } @children;
+
+    if ($discard) {
+        @children = grep { ! __is_discardable($_) } @children;
+    }
+
+    print { $fh } __start_tag($element);
+
+    if (! @children) {
+        print { $fh } "/>";
+
+        return;
+    }
+
+    print { $fh } ">";
+
+    if ($child_format && ! $discard) {
+        my $indent = INDENT x min($level + 1, MAX_INDENT);
+
+        print { $fh } "\n";
+
+        for my $child (@children) {
+            print { $fh } $indent;
+
+            $self->__write_node($fh, $child, $level + 1, 1);
+
+            print { $fh } "\n";
+        }
+
+        print { $fh } INDENT x min($level, MAX_INDENT);
+    } else {
+        for my $child (@children) {
+            $self->__write_node($fh, $child, $level + 1, $child_format);
+        }
+    }
+
+    print { $fh } "</", $element->nodeName(), ">";
+
+    return;
+}
+
+1;
+
+__END__
@@ -0,0 +1,698 @@
+package TeX::Output::XML::Stream;
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use warnings;
+
+## TeX::Output::XML::Stream is an output module for very long
+## documents.  Select it with
+##
+##     texml -output_module TeX::Output::XML::Stream ...
+##
+## (or $tex->set_output_module()).  Instead of keeping the whole
+## document in memory until the end, it writes each top-level sec, app
+## and ref-list to a spool file as soon as pop_element() closes it.  The
+## subtree is replaced by a <texml-chunk n="N"/> placeholder.  What
+## stays in memory is
+##
+##     * the document outside those subtrees;
+##
+##     * the "patch" elements (xref, xref-group, cite-group, cref,
+##       natbibref, tag, graphic, inline-graphic) that the output
+##       hooks can only resolve once the whole document has been
+##       read.  Each one is moved into a <texml-patches> holding area
+##       at the end of the root element, where the hooks find it as
+##       usual, and leaves a <texml-patch n="N"/> placeholder behind;
+##
+##     * the id maps used by normalize_ids(), the id counts used by
+##       flag_duplicate_ids(), and a copy of the title of every
+##       spooled element that has an id, for get_element_by_id().
+##
+## When the subtree is spooled, the hooks whose selectors (see
+## TeX::Output::XML::run_hooks()) name none of the patch elements run
+## on it, then its empty paragraphs are deleted and its ids
+## normalized.  Hooks without selectors only see what's in memory.  If
+## one of those hooks would have to run before a hook that's ready to
+## run on the subtree, the subtree isn't spooled after all (see
+## __can_run_hooks_locally()).
+##
+## finalize_document() works on what's left.  After it runs, the patch
+## elements are serialized and the holding area is removed.  Once
+## TeX::Interpreter::finish_output_file() has written the skeleton,
+## complete_output_file() copies each spooled subtree back in place of
+## its placeholder, filling in the patches on the way.
+##
+## Known differences from TeX::Output::XML:
+##
+##     * The texmlidN names assigned to invalid ids may come out in a
+##       different order.
+##
+##     * XSL stylesheets aren't supported.
+##
+##     * Code that searches the DOM during the run (rather than in an
+##       output hook) doesn't see subtrees that have already been
+##       spooled, except that get_element_by_id() finds the stand-in
+##       for a spooled element with a title.
+
+use base qw(TeX::Output::XML);
+
+use Encode qw(decode_utf8);
+
+use File::Basename;
+use File::Temp;
+
+use TeX::Utils::Misc;
+
+use TeX::Output::XML::PrettyPrinter;
+
+use XML::LibXML qw(:libxml);
+
+use constant DEFAULT_STREAMED_ELEMENTS => qw(sec app ref-list);
+
+use constant DEFAULT_PATCH_ELEMENTS => qw(xref xref-group cite-group cref
+                                          natbibref tag
+                                          graphic inline-graphic);
+
+my %streamed_element_of :HASH(:name<streamed_element>);
+my %patch_element_of    :HASH(:name<patch_element>);
+
+my %spool_of   :ATTR(:name<spool>);
+my %chunks_of  :ARRAY(:name<chunk>);    # [ offset, length ]
+my %num_kept_of :COUNTER(:name<num_kept>); # subtrees kept in memory
+
+my %patch_area_of :ATTR(:name<patch_area>);
+my %patches_of    :ARRAY(:name<patch_point>); # [ wrapper, level, format ]
+my %patch_text_of :ARRAY(:name<patch_text>);
+
+my %title_of    :HASH(:name<title>);    # raw id => stand-in element
+my %id_count_of :HASH(:name<id_count>);
+my %ids_of      :ARRAY(:name<id>);
+
+my %printer_of :ATTR(:name<printer>);
+
+######################################################################
+##                                                                  ##
+##                           CONSTRUCTOR                            ##
+##                                                                  ##
+######################################################################
+
+sub START {
+    my ($self, $ident, $arg_ref) = @_;
+
+    $streamed_element_of{$ident} = { map { $_ => 1 } DEFAULT_STREAMED_ELEMENTS };
+    $patch_element_of{$ident}    = { map { $_ => 1 } DEFAULT_PATCH_ELEMENTS };
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                             METHODS                              ##
+##                                                                  ##
+######################################################################
+
+sub open_document {
+    my $self = shift;
+
+    $self->SUPER::open_document(@_);
+
+    my $tex = $self->get_tex_engine();
+
+    my $spool = File::Temp->new(SUFFIX => ".spool");
+
+    binmode($spool);
+
+    $self->set_spool($spool);
+
+    my %args = $tex->is_pretty_print() ? () : (discard_spaces_in => []);
+
+    $self->set_printer(TeX::Output::XML::PrettyPrinter->new(\%args));
+
+    return;
+}
+
+sub pop_element {
+    my $self = shift;
+
+    my $qName = shift;
+
+    my $element = $self->get_current_element();
+
+    $self->SUPER::pop_element($qName, @_);
+
+    if (defined $element && $element->nodeName() eq $qName) {
+        my $node = $element->get_node();
+
+        if ($self->__is_top_level_stream_element($node)) {
+            $self->__spool_subtree($node);
+        }
+    }
+
+    return;
+}
+
+sub __is_top_level_stream_element {
+    my $self = shift;
+
+    my $node = shift;
+
+    my $streamed = $streamed_element_of{ident $self};
+
+    return unless $streamed->{ $node->nodeName() };
+
+    for (my $parent = $node->parentNode(); defined $parent; $parent = $parent->parentNode()) {
+        return if $parent->nodeType() != XML_ELEMENT_NODE;
+
+        return if $streamed->{ $parent->nodeName() };
+
+        return 1 if $parent->isSameNode($self->get_dom()->documentElement());
+    }
+
+    return;
+}
+
+## Where the pretty printer will find the node: its depth below the
+## root element and whether any of its ancestors has text children.
+
+sub __print_context {
+    my $node = shift;
+
+    my $level = 0;
+
+    my $format = 1;
+
+    for (my $parent = $node->parentNode(); defined $parent; $parent = $parent->parentNode()) {
+        last unless $parent->nodeType() == XML_ELEMENT_NODE;
+
+        $level++;
+
+        if (grep { $_->nodeType() == XML_TEXT_NODE } $parent->childNodes()) {
+            $format = 0;
+        }
+    }
+
+    return ($level, $format);
+}
+
+sub __placeholder {
+    my $self = shift;
+
+    my $name = shift;
+    my $n    = shift;
+
+    my $placeholder = $self->get_dom()->createElement($name);
+
+    $placeholder->setAttribute(n => $n);
+
+    return $placeholder;
+}
+
+sub __get_patch_area {
+    my $self = shift;
+
+    my $area = $self->get_patch_area();
+
+    if (! defined $area) {
+        $area = $self->get_dom()->createElement("texml-patches");
+
+        $self->get_dom()->documentElement()->appendChild($area);
+
+        $self->set_patch_area($area);
+    }
+
+    return $area;
+}
+
+## A hook can run on a subtree when it's spooled if it has selectors
+## and none of them names a patch element.  Any other hook only runs in
+## finalize_document(), where it can still reach the subtree's patch
+## elements, since they stay in memory.
+
+sub __is_local_hook {
+    my $self = shift;
+
+    my $selectors = shift;
+
+    return unless $selectors->@*;
+
+    my $patch = $patch_element_of{ident $self};
+
+    my @names = map { $_->[0] } map { TeX::Output::XML::__parse_selector($_) } $selectors->@*;
+
+    return ! grep { $patch->{$_} } @names;
+}
+
+sub __patch_elements {
+    my $self = shift;
+
+    my $root = shift;
+
+    my $patch = $patch_element_of{ident $self};
+
+    my @found;
+
+    TeX::Output::XML::__walk_elements($root, sub {
+        push @found, $_[0] if $patch->{ $_[0]->nodeName() } && ! $_[0]->isSameNode($root);
+    });
+
+    return @found;
+}
+
+sub __selected_elements {
+    my $self = shift;
+
+    my $root      = shift;
+    my $selectors = shift;
+
+    my $selected = $self->select_subtree_elements($root, $selectors->@*);
+
+    return map { $_->@* } values $selected->%*;
+}
+
+## The hooks have to see the subtree in the same order as they would
+## in TeX::Output::XML::run_hooks().  So a local hook can only run
+## early if no hook in an earlier stage is going to change what it
+## reads in finalize_document().  A hook without selectors is assumed
+## to change every patch element in the subtree, and one with
+## selectors the elements it selects.  A local hook reads the elements
+## it selects, so it has to wait if any of them contains one of those.
+## For example, LTsect's alt-title hook (priority 10), which selects
+## section titles, has to wait for LTref's do_resolve_xrefs()
+## (priority 1) when a title contains a \ref, but not when only the
+## body of the section does.  If a local hook has to wait, the subtree
+## stays in memory and all of its hooks run in finalize_document().
+## (Hooks in the same stage are independent, as in run_hooks(), and
+## the selections are made before any hooks run.)
+
+sub __can_run_hooks_locally {
+    my $self = shift;
+
+    my $root = shift;
+
+    my $patches;
+
+    my %changed; # unique keys of changed elements and their ancestors
+
+    for my $stage ($self->get_hook_stages()) {
+        my @changes;
+
+        for my $hook ($stage->@*) {
+            my (undef, $selectors) = $hook->@*;
+
+            if ($self->__is_local_hook($selectors)) {
+                next unless %changed;
+
+                for my $node ($self->__selected_elements($root, $selectors)) {
+                    return if $changed{ $node->unique_key() };
+                }
+            } elsif ($selectors->@*) {
+                push @changes, $self->__selected_elements($root, $selectors);
+            } else {
+                $patches //= [ $self->__patch_elements($root) ];
+
+                push @changes, $patches->@*;
+            }
+        }
+
+        for my $node (@changes) {
+            for (my $up = $node; defined $up; $up = $up->parentNode()) {
+                last if $changed{ $up->unique_key() }++;
+
+                last if $up->isSameNode($root);
+            }
+        }
+    }
+
+    return 1;
+}
+
+## Returns false, without running any hooks, if the subtree has to
+## stay in memory.
+
+sub __run_local_hooks {
+    my $self = shift;
+
+    my $root = shift;
+
+    return unless $self->__can_run_hooks_locally($root);
+
+    for my $stage ($self->get_hook_stages()) {
+        my @hooks = grep { $self->__is_local_hook($_->[1]) } $stage->@*;
+
+        my $selected = $self->select_subtree_elements($root, map { $_->[1]->@* } @hooks);
+
+        for my $hook (@hooks) {
+            my ($sub, $selectors) = $hook->@*;
+
+            my %nodes = map { $_ => [ grep { TeX::Output::XML::__is_attached($_) } $selected->{$_}->@* ] } $selectors->@*;
+
+            $sub->($self, \%nodes);
+        }
+    }
+
+    return 1;
+}
+
+sub __extract_patches {
+    my $self = shift;
+
+    my $root = shift;
+
+    my $patch = $patch_element_of{ident $self};
+
+    my @found;
+
+    my @stack = ($root);
+
+    while (defined(my $node = pop @stack)) {
+        next unless $node->nodeType() == XML_ELEMENT_NODE;
+
+        if ($patch->{ $node->nodeName() } && ! $node->isSameNode($root)) {
+            push @found, $node;
+
+            next;
+        }
+
+        push @stack, reverse $node->childNodes();
+    }
+
+    return unless @found;
+
+    my $area = $self->__get_patch_area();
+
+    for my $node (@found) {
+        my $n = $self->num_patch_points();
+
+        my ($level, $format) = __print_context($node);
+
+        $node->replaceNode($self->__placeholder("texml-patch", $n));
+
+        my $wrapper = $self->get_dom()->createElement("texml-patch");
+
+        $wrapper->setAttribute(n => $n);
+
+        $wrapper->appendChild($node);
+
+        $area->appendChild($wrapper);
+
+        $self->push_patch_point([ $wrapper, $level, $format ]);
+    }
+
+    return;
+}
+
+## Stand-ins for get_element_by_id(): an empty copy of each element
+## with an id and a title, with its attributes and a copy of the title
+## inside it.
+
+sub __save_titles {
+    my $self = shift;
+
+    my $index = shift;
+
+    for my $node ($index->{id}->@*) {
+        my ($title) = $node->getChildrenByTagName("title");
+
+        next unless defined $title;
+
+        my $id = $node->getAttribute('id');
+
+        next if defined $self->get_title($id);
+
+        my $stand_in = $self->get_dom()->createElement($node->nodeName());
+
+        for my $attribute ($node->attributes()) {
+            next unless $attribute->nodeType() == XML_ATTRIBUTE_NODE;
+
+            $stand_in->setAttribute($attribute->nodeName(), $attribute->value());
+        }
+
+        $stand_in->appendChild($title->cloneNode(1));
+
+        $self->set_title($id, $stand_in);
+    }
+
+    return;
+}
+
+sub __spool_subtree {
+    my $self = shift;
+
+    my $node = shift;
+
+    my $ident = ident $self;
+
+    if (! $self->__run_local_hooks($node)) {
+        $self->incr_num_kept();
+
+        return;
+    }
+
+    $self->__extract_patches($node);
+
+    my $index = $self->index_document($node);
+
+    ## The ids and rids the subtree had before normalize_ids(), for
+    ## prune_live_index() once it's gone.
+
+    my @ids = (map({ $_->getAttribute('id') } $index->{id}->@*),
+               map({ split ' ', $_->getAttribute('rid') } $index->{rid}->@*));
+
+    $self->__save_titles($index);
+
+    $self->normalize_ids($index);
+
+    for my $id ($index->{ids}->@*) {
+        $self->push_id($id) unless exists $id_count_of{$ident}->{$id};
+
+        $id_count_of{$ident}->{$id} += $index->{id_count}->{$id};
+    }
+
+    my ($level, $format) = __print_context($node);
+
+    open(my $buffer, ">:encoding(UTF-8)", \my $bytes) or die "Can't open buffer: $!\n";
+
+    $self->get_printer()->write_node($buffer, $node, $level, $format);
+
+    close($buffer);
+
+    my $spool = $self->get_spool();
+
+    my $offset = tell($spool);
+
+    print { $spool } $bytes;
+
+    my $n = $self->num_chunks();
+
+    $self->push_chunk([ $offset, length($bytes) ]);
+
+    $node->replaceNode($self->__placeholder("texml-chunk", $n));
+
+    $self->prune_live_index(@ids);
+
+    $self->delete_id_index();
+
+    return;
+}
+
+sub get_elements_by_id {
+    my $self = shift;
+
+    my $id = shift;
+
+    my @elements = $self->SUPER::get_elements_by_id($id);
+
+    return @elements if @elements;
+
+    my $stand_in = $self->get_title($id);
+
+    return defined $stand_in ? $stand_in : ();
+}
+
+sub flag_duplicate_ids {
+    my $self = shift;
+
+    my $index = shift;
+
+    my $ident = ident $self;
+
+    my %id_count = %{ $id_count_of{$ident} };
+
+    my @ids = $self->get_ids();
+
+    for my $id ($index->{ids}->@*) {
+        push @ids, $id unless exists $id_count{$id};
+
+        $id_count{$id} += $index->{id_count}->{$id};
+    }
+
+    $self->SUPER::flag_duplicate_ids({ id_count => \%id_count, ids => \@ids });
+
+    return;
+}
+
+sub finalize_document {
+    my $self = shift;
+
+    my $tex = $self->get_tex_engine();
+
+    my $spooled = $self->num_chunks();
+
+    my $total = $spooled + $self->num_kept();
+
+    $tex->wlog_cr();
+    $tex->wlog_ln("Streamed output: $spooled of $total subtrees written to the spool file");
+
+    $self->SUPER::finalize_document();
+
+    my $printer = $self->get_printer();
+
+    for my $patch ($self->get_patch_points()) {
+        my ($wrapper, $level, $format) = $patch->@*;
+
+        open(my $buffer, ">:encoding(UTF-8)", \my $bytes) or die "Can't open buffer: $!\n";
+
+        my $separator = $format ? "\n" . ("  " x $level) : "";
+
+        my $first = 1;
+
+        for my $child ($wrapper->childNodes()) {
+            print { $buffer } $separator unless $first;
+
+            $printer->write_node($buffer, $child, $level, $format);
+
+            $first = 0;
+        }
+
+        close($buffer);
+
+        $self->push_patch_text(decode_utf8($bytes));
+    }
+
+    if (defined(my $area = $self->get_patch_area())) {
+        $area->unbindNode();
+
+        $self->delete_patch_area();
+    }
+
+    $self->delete_patch_points();
+
+    return;
+}
+
+sub close_document {
+    my $self = shift;
+
+    my $tex = $self->get_tex_engine();
+
+    if (nonempty(my $name = $tex->get_xsl_file())) {
+        $tex->print_err("Can't apply XSL file '$name' to streamed output");
+
+        $tex->error();
+
+        $tex->set_xsl_file("");
+    }
+
+    return $self->SUPER::close_document(@_);
+}
+
+sub __read_chunk {
+    my $self = shift;
+
+    my $n = shift;
+
+    my $spool = $self->get_spool();
+
+    my ($offset, $length) = $self->get_chunk($n)->@*;
+
+    seek($spool, $offset, 0) or die "Can't seek in spool file: $!\n";
+
+    read($spool, my $bytes, $length) == $length or die "Short read from spool file\n";
+
+    my $text = decode_utf8($bytes);
+
+    my $patches = $self->get_patch_texts();
+
+    $text =~ s{<texml-patch n="(\d+)"/>}{$patches->[$1]}g;
+
+    return $text;
+}
+
+sub complete_output_file {
+    my $self = shift;
+
+    my $file_name = shift;
+
+    return unless $self->num_chunks();
+
+    my $tmp = File::Temp->new(DIR    => dirname($file_name),
+                              UNLINK => 0,
+                              SUFFIX => ".tmp");
+
+    my $tmp_file = $tmp->filename();
+
+    eval {
+        binmode($tmp, ":encoding(UTF-8)");
+
+        open(my $in, "<:encoding(UTF-8)", $file_name) or die "Can't read $file_name: $!\n";
+
+        while (my $line = <$in>) {
+            while ($line =~ s{\A(.*?)<texml-chunk n="(\d+)"/>}{}s) {
+                print { $tmp } $1, $self->__read_chunk($2);
+            }
+
+            print { $tmp } $line;
+        }
+
+        close($in);
+
+        close($tmp) or die "Can't write $tmp_file: $!\n";
+
+        chmod(0666 & ~umask(), $tmp_file);
+
+        rename($tmp_file, $file_name) or die "Can't rename $tmp_file to $file_name: $!\n";
+    };
+
+    if (my $error = $@) {
+        unlink $tmp_file;
+
+        die $error;
+    }
+
+    $self->delete_chunks();
+
+    return;
+}
+
+1;
+
+__END__
@@ -48,7 +48,7 @@ use File::Basename;
 
 use TeX::Class;
 
-use Scalar::Util qw(blessed reftype);
+use Scalar::Util qw(blessed);
 
 use TeX::Utils::Misc;
 
@@ -1349,7 +1349,7 @@ sub read_macro_parameters {
     my @parameter_text;
 
     while (my $arg = shift) {
-        if (reftype($arg) eq 'ARRAY') {
+        if (ref($arg) eq 'ARRAY') {
             push @parameter_text, @{ $arg};
         } elsif (blessed($arg) && $arg->isa('TeX::TokenList')) {
             push @parameter_text, $arg->get_tokens();
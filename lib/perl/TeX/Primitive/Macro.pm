@@ -76,14 +76,18 @@ sub expand {
     my $tex     = shift;
     my $cur_tok = shift;
 
-    my $token_list = $self->macro_call($tex, $cur_tok);
+    my $args = $self->scan_arguments($tex, $cur_tok);
 
-    $tex->begin_token_list($token_list, macro) if defined $token_list;
+    $tex->begin_macro_body($self->get_replacement_text(), $args);
 
     return;
 }
 
-sub macro_call {
+## Scans the arguments of the macro and returns them as an array
+## indexed by parameter number.  Slot 0 holds the token that called the
+## macro, for error messages.
+
+sub scan_arguments {
     my $self = shift;
 
     my $tex     = shift;
@@ -123,6 +127,27 @@ sub macro_call {
         $tex->end_diagnostic(true);
     }
 
+    $tex->set_scanner_status($save_scanner_status);
+
+    $args[0] = $cur_tok;
+
+    return \@args;
+}
+
+## Returns a copy of the replacement text with the arguments
+## substituted.  expand() doesn't need this, since the interpreter
+## reads the replacement text in place (see begin_macro_body()).
+
+sub macro_call {
+    my $self = shift;
+
+    my $tex     = shift;
+    my $cur_tok = shift;
+
+    my $macro_text = $self->get_replacement_text();
+
+    my @args = @{ $self->scan_arguments($tex, $cur_tok) };
+
     my @expansion;
 
     for my $token (@{ $macro_text }) {
@@ -139,8 +164,6 @@ sub macro_call {
         }        
     }
 
-    $tex->set_scanner_status($save_scanner_status);
-
     return TeX::TokenList->new({ tokens => \@expansion });
 }
 
@@ -207,6 +230,14 @@ sub print_cmd_chr {
 ##                                                                  ##
 ######################################################################
 
+## Returns the Perl code behind an anonymous macro (see below), which
+## is how TeX::Interpreter::Profiler figures out which package defined
+## it.
+
+sub get_anonymous_code {
+    return;
+}
+
 my $PACKAGE_COUNTER = 0;
 
 ## NOTE: These do *not* act like macros as far as \meaning, \ifx,
@@ -234,6 +265,8 @@ sub make_anonymous_macro( $ ) {
         $tex->begin_token_list($token_list, macro) if defined $token_list;
     };
 
+    *{ "${subclass}::get_anonymous_code" } = sub { return $code };
+
     return $macro;
 }
 
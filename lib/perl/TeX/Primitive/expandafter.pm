@@ -53,6 +53,8 @@ sub expand {
     my $expandable = $tex->get_expandable_meaning($token_2);
 
     if (defined($expandable)) {
+        $tex->note_perl_command($expandable);
+
         $expandable->expand($tex, $token_2);
     } else {
         $tex->back_input($token_2);
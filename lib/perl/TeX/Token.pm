@@ -87,12 +87,21 @@ use UNIVERSAL;
 ##                                                                  ##
 ######################################################################
 
-use TeX::Class;
+## Tokens are array-backed (see TeX::Class), since we make so many of
+## them and look at their catcodes so often.
 
-my %catcode_of :ATTR(:init_arg => 'catcode' :get<catcode>);
-my %datum_of   :ATTR(:init_arg => 'datum'   :get<datum>);
+use TeX::Class qw(:array_backed);
 
-my %frozen_name_of :ATTR(:name<frozen_name>);
+use constant {
+    SLOT_CATCODE     => 0,
+    SLOT_DATUM       => 1,
+    SLOT_FROZEN_NAME => 2,
+};
+
+my %catcode_of :ATTR(:init_arg => 'catcode' :get<catcode> :slot<SLOT_CATCODE>);
+my %datum_of   :ATTR(:init_arg => 'datum'   :get<datum>   :slot<SLOT_DATUM>);
+
+my %frozen_name_of :ATTR(:name<frozen_name> :slot<SLOT_FROZEN_NAME>);
 
 ######################################################################
 ##                                                                  ##
@@ -193,6 +202,13 @@ END {
     undef @CACHE;
 }
 
+## The number of tokens asked for so far and the number that had to be
+## created, for benchmarks (see tests/bench/corpus.pl).
+
+sub get_token_counts {
+    return ($TOTAL_TOKENS, $DISTINCT_TOKENS);
+}
+
 sub __make_token {
     my $catcode = shift;
     my $datum   = shift;
@@ -294,31 +310,31 @@ sub make_comment_token {
 sub is_character {
     my $self = shift;
 
-    return $self->get_catcode() < CATCODE_CSNAME;
+    return $self->[SLOT_CATCODE] < CATCODE_CSNAME;
 }
 
 sub is_letter {
     my $self = shift;
 
-    return $self->get_catcode() == CATCODE_LETTER;
+    return $self->[SLOT_CATCODE] == CATCODE_LETTER;
 }
 
 sub is_csname {
     my $self = shift;
 
-    return $self->get_catcode() == CATCODE_CSNAME;
+    return $self->[SLOT_CATCODE] == CATCODE_CSNAME;
 }
 
 sub is_comment {
     my $self = shift;
 
-    return $self->get_catcode() == CATCODE_COMMENT;
+    return $self->[SLOT_CATCODE] == CATCODE_COMMENT;
 }
 
 sub is_definable {
     my $self = shift;
 
-    my $catcode = $self->get_catcode();
+    my $catcode = $self->[SLOT_CATCODE];
 
     return $catcode == CATCODE_CSNAME || $catcode == CATCODE_ACTIVE;
 }
@@ -326,7 +342,7 @@ sub is_definable {
 sub is_param_ref {
     my $self = shift;
 
-    return $self->get_catcode() == CATCODE_PARAM_REF;
+    return $self->[SLOT_CATCODE] == CATCODE_PARAM_REF;
 }
 
 sub get_char {
@@ -386,7 +402,7 @@ sub token_equal {
 
     ## Otherwise,
 
-    return $catcode_of{$ident_self} == $other;
+    return $self->[SLOT_CATCODE] == $other;
 }
 
 sub catcode_compare {
@@ -46,27 +46,30 @@ our @EXPORT = ();
 
 use Carp;
 
-use TeX::Class;
+use TeX::Class qw(:array_backed);
 
 use TeX::Token qw(:catcodes :factories);
 
 use constant EOL => make_character_token("\n", CATCODE_END_OF_LINE);
 
-my %tokens_of :ATTR();
+use constant SLOT_TOKENS => 0;
+
+my %tokens_of :ATTR(:slot<SLOT_TOKENS>);
 
 use overload
     q{==} => \&tokenlist_equal;
 
+## The tokens can be given as either an array reference or another
+## TeX::TokenList.
+
 sub BUILD {
     my ($self, $ident, $arg_ref) = @_;
 
-    if (defined $arg_ref->{tokens}) {
-        my @tokens = @{ $arg_ref->{tokens} };
+    my @tokens = defined $arg_ref->{tokens} ? @{ $arg_ref->{tokens} } : ();
 
-        $tokens_of{$ident} = \@tokens;
-    } else {
-        $tokens_of{$ident} = [];
-    }
+    no overloading '@{}';
+
+    $self->[SLOT_TOKENS] = \@tokens;
 
     return;
 }
@@ -75,10 +78,15 @@ sub new_token_list {
     return __PACKAGE__->new({ tokens => [ @_ ] });
 }
 
+## Token lists are array-backed, so from here on @{} has to mean the
+## object itself, not the overloaded get_tokens().
+
+no overloading '@{}';
+
 sub get_tokens :ARRAYIFY {
     my $self = CORE::shift;
 
-    my $tokens_r = $tokens_of{ident $self};
+    my $tokens_r = $self->[SLOT_TOKENS];
 
     return wantarray ? @{ $tokens_r } : $tokens_r;
 }
@@ -86,7 +94,7 @@ sub get_tokens :ARRAYIFY {
 sub clear {
     my $self = CORE::shift;
 
-    $tokens_of{ident $self} = [];
+    $self->[SLOT_TOKENS] = [];
 
     return;
 }
@@ -94,32 +102,32 @@ sub clear {
 sub length {
     my $self = CORE::shift;
 
-    return scalar @{ $tokens_of{ident $self} };
+    return scalar @{ $self->[SLOT_TOKENS] };
 }
 
 sub index {
     my $self  = CORE::shift;
     my $index = CORE::shift;
 
-    return $tokens_of{ident $self}->[$index];
+    return $self->[SLOT_TOKENS]->[$index];
 }
 
 sub tail {
     my $self  = CORE::shift;
 
-    return $tokens_of{ident $self}->[-1];
+    return $self->[SLOT_TOKENS]->[-1];
 }
 
 sub head {
     my $self  = CORE::shift;
 
-    return $tokens_of{ident $self}->[0];
+    return $self->[SLOT_TOKENS]->[0];
 }
 
 sub shift {
     my $self = CORE::shift;
 
-    return CORE::shift @{ $tokens_of{ident $self} };
+    return CORE::shift @{ $self->[SLOT_TOKENS] };
 }
 
 sub unshift {
@@ -141,7 +149,7 @@ sub unshift {
         }
     }
 
-    CORE::unshift @{ $tokens_of{ident $self} }, @tokens;
+    CORE::unshift @{ $self->[SLOT_TOKENS] }, @tokens;
 
     return;
 }
@@ -149,7 +157,7 @@ sub unshift {
 sub pop {
     my $self = CORE::shift;
 
-    return CORE::pop @{ $tokens_of{ident $self} };
+    return CORE::pop @{ $self->[SLOT_TOKENS] };
 }
 
 sub push {
@@ -161,7 +169,7 @@ sub push {
         if (eval { $item->isa(__PACKAGE__) }) {
             $self->push($item->get_tokens());
         } elsif (eval { $item->isa("TeX::Token") }) {
-            CORE::push @{ $tokens_of{ident $self} }, $item;
+            CORE::push @{ $self->[SLOT_TOKENS] }, $item;
         } elsif (defined $item) {
             croak "Can't append '$item' (", ref($item), ") to a ", __PACKAGE__;
         } else {
@@ -35,10 +35,19 @@ use warnings;
 
 use Cwd;
 
+use Digest::MD5 qw(md5_hex);
+
+use Encode qw(encode_utf8);
+
 use File::Basename;
+use File::Copy;
 use File::Spec::Functions qw(catdir rel2abs);
 use File::Temp qw(tempdir);
 
+use IO::Select;
+
+use POSIX ();
+
 ## Convert HUP, INT, PIPE and TERM into regular exits so that
 ## File::Temp's END block will run to clean up temporary files.
 
@@ -48,8 +57,12 @@ use TeX::Class;
 
 use TeX::Arithmetic qw(sprint_scaled);
 
+use TeX::KPSE qw(kpse_lookup);
+
 use TeX::Utils::Misc;
 
+use TeX::Utils::SVG::Cache;
+
 use TeXML::CFG;
 
 my $CFG;
@@ -64,6 +77,8 @@ sub PDF2SVG() { $CFG->val(__PACKAGE__, 'pdf2svg',       'pdf2svg') }
 sub PS2PDF () { $CFG->val(__PACKAGE__, 'ps2pdf',        'ps2pdf') }
 sub MATH_SF_FONT () { $CFG->val(__PACKAGE__, 'math_sf_font', 'SourceSansPro-Regular.otf') }
 
+sub BATCH () { $CFG->val(__PACKAGE__, 'batch', 1) }
+
 ######################################################################
 ##                                                                  ##
 ##                            ATTRIBUTES                            ##
@@ -82,6 +97,24 @@ my %debug_of :BOOLEAN(:name<debug> :default<0>);
 
 my %use_xetex_of :BOOLEAN(:name<use_xetex> :default<0>);
 
+## Deferred rendering: the jobs that haven't been handed to a worker
+## yet, in document order, all unfinished jobs indexed by output file,
+## and the outcome for each file once it is finished.
+
+my %jobs_of    :ARRAY(:name<job>);
+my %pending_of :HASH(:name<pending>);
+my %results_of :HASH(:name<result>);
+
+my %workers_of :HASH(:name<worker>); # pid => { reader => FH, jobs => [ ... ] }
+
+## Don't report failed commands, just die (used by the workers).
+
+my %quiet_of :BOOLEAN(:name<quiet> :default<0>);
+
+## A TeX::Utils::SVG::Cache, or undef if caching is turned off.
+
+my %cache_of :ATTR(:name<cache>);
+
 ######################################################################
 ##                                                                  ##
 ##                           CONSTRUCTOR                            ##
@@ -101,6 +134,8 @@ sub START {
         $self->extract_preamble();
     }
 
+    $self->set_cache(TeX::Utils::SVG::Cache->from_cfg());
+
     return;
 }
 
@@ -204,6 +239,8 @@ sub system {
     my $status = CORE::system qq{$command @args};
 
     if ($status) {
+        die "'$command' failed\n" if $self->is_quiet();
+
         my $dirname = basename(getcwd());
 
         my $tex = $self->get_interpreter();
@@ -222,13 +259,13 @@ sub system {
     return;
 }
 
-sub generate_svg {
+## Runs the TeX file through LaTeX and pdfcrop and returns the name
+## of the cropped PDF.
+
+sub __make_cropped_pdf {
     my $self = shift;
 
     my $tex_file  = shift;
-    my $svg_title = shift;
-    my $id = shift;
-    my $data_src  = shift;
     my $use_xetex = shift;
 
     my $base = basename($tex_file, '.tex');
@@ -243,13 +280,25 @@ sub generate_svg {
         $self->system(PS2PDF, "$base.ps");
     }
 
-    my $svg_file;
-
     $self->system(PDFCROP, "$base.pdf");
 
-    my $cropped_pdf = "$base-crop.pdf";
+    return "$base-crop.pdf";
+}
+
+sub generate_svg {
+    my $self = shift;
 
-    $svg_file = "$base.svg";
+    my $tex_file  = shift;
+    my $svg_title = shift;
+    my $id = shift;
+    my $data_src  = shift;
+    my $use_xetex = shift;
+
+    my $base = basename($tex_file, '.tex');
+
+    my $cropped_pdf = $self->__make_cropped_pdf($tex_file, $use_xetex);
+
+    my $svg_file = "$base.svg";
 
     if (-e $cropped_pdf) {
         $self->system(PDF2SVG, $cropped_pdf, $svg_file);
@@ -283,57 +332,66 @@ sub __scratch_dir {
     return $tmp_dir;
 }
 
-sub convert_tex {
+## Fragments that contain \psfrag or pull in .pstex_t files have to
+## go through dvips.
+
+sub __use_xetex {
     my $self = shift;
 
     my $tex_fragment = shift;
-    my $id = shift;
-
-    my $tex = shift;
-
-    my $starred = shift;
-
-    $CFG = TeXML::CFG->get_cfg();
 
     ## The use_xetex flag needs to be a lot more sophisticated.
 
     my $use_xetex = $self->use_xetex();
 
-    # if ($use_xetex) {
-        my $is_external_graphic = $tex_fragment =~ m{\\input};
+    my $is_external_graphic = $tex_fragment =~ m{\\input};
 
-        if ($is_external_graphic && $tex_fragment =~ m{\.pstex_t}) {
-            $use_xetex = 0;
-        }
+    if ($is_external_graphic && $tex_fragment =~ m{\.pstex_t}) {
+        $use_xetex = 0;
+    }
 
-        if ($tex_fragment =~ m{\\psfrag}) {
-            $use_xetex = 0;
-        }
-    # }
+    if ($tex_fragment =~ m{\\psfrag}) {
+        $use_xetex = 0;
+    }
 
-    # if (! $use_xetex) {
-    #     my $is_external_graphic = $tex_fragment =~ m{\\includegraphics};
-    #
-    #     $use_xetex = (! $is_external_graphic) && $tex_fragment !~ m{\.pstex_t};
-    # }
+    return $use_xetex;
+}
 
-    my $tmp_dir = $self->__scratch_dir();
+## A job describes one fragment.  Everything that depends on the state
+## of the interpreter is captured when the job is created, since
+## batched jobs aren't rendered until the end of the run.
 
-    my $cwd = getcwd();
+sub __make_job {
+    my $self = shift;
 
-    chdir($tmp_dir) or do {
-        die "Can't connect to $tmp_dir: $!\n";
-    };
+    my $tex_fragment = shift;
+    my $id = shift;
 
-    my $base = "tex2svg";
+    my $tex = shift;
 
-    my $tex_file = "$base.tex";
+    my $starred  = shift;
+    my $out_file = shift;
+
+    return { fragment    => "$tex_fragment",
+             id          => $id,
+             starred     => $starred,
+             out_file    => $out_file,
+             use_xetex   => $self->__use_xetex($tex_fragment),
+             unicode     => $tex->is_unicode_input(),
+             paper_width => sprint_scaled($tex->TeXML_SVG_paperwidth()),
+             data_src    => sprintf(qq{%s, l. %s},
+                                    $tex->get_file_name(),
+                                    $tex->input_line_no()),
+    };
+}
 
-    my $mode = $tex->is_unicode_input() ? ">:utf8" : ">";
+sub __write_preamble {
+    my $self = shift;
 
-    open(my $fh, $mode, $tex_file) or do {
-        die "Can't open $tex_file\n";
-    };
+    my $fh  = shift;
+    my $job = shift;
+
+    my $use_xetex = $job->{use_xetex};
 
     # Avoid loading the amsfonts package to keep from using up math
     # symbol fonts that we might need later for the stix2 package.
@@ -407,7 +465,7 @@ sub convert_tex {
 
     print { $fh } qq{\\expandafter\\let\\csname enddoc\@text\\endcsname\\relax\n\n};
 
-    my $paper_width = sprint_scaled($tex->TeXML_SVG_paperwidth());
+    my $paper_width = $job->{paper_width};
 
     # if ($is_external_graphic) {
         print { $fh } qq{\\TeXMLrealhsize\\textwidth\n};
@@ -421,16 +479,21 @@ sub convert_tex {
 
     print { $fh } qq{\\makeatletter\\providecommand{\\KV\@Gin\@alt}[1]{}\\makeatother\n\n};
 
-    print { $fh } qq{\\begin{document}\n\n};
+    return;
+}
+
+sub __write_fragment {
+    my $self = shift;
 
-    my $data_src = sprintf qq{%s, l. %s}, $tex->get_file_name(), $tex->input_line_no();
+    my $fh  = shift;
+    my $job = shift;
 
-    print { $fh } qq{%% SOURCE: $data_src\n\n};
+    print { $fh } qq{%% SOURCE: $job->{data_src}\n\n};
 
-    print { $fh } qq{\\begin{equation*}\n} if $starred;
+    print { $fh } qq{\\begin{equation*}\n} if $job->{starred};
 
     # if ($is_external_graphic) {
-        (my $fragment = $tex_fragment) =~ s{\\hsize\b}{\\TeXMLrealhsize}g;
+        (my $fragment = $job->{fragment}) =~ s{\\hsize\b}{\\TeXMLrealhsize}g;
         $fragment =~ s{\\textwidth\b}{\\TeXMLrealhsize}g;
         $fragment =~ s{\\linewidth\b}{\\TeXMLrealhsize}g;
 
@@ -439,15 +502,15 @@ sub convert_tex {
     #     print { $fh } $tex_fragment, "\n\n";
     # }
 
-    print { $fh } qq{\\end{equation*}\n} if $starred;
+    print { $fh } qq{\\end{equation*}\n} if $job->{starred};
 
     print { $fh } "\n";
 
-    print { $fh } qq{\\end{document}\n};
-
-    close($fh);
+    return;
+}
 
-    local $ENV{TEXMFCNF} = undef;
+sub __texinputs {
+    my $self = shift;
 
     my @texinputs = ($self->get_texinputs(), "");
 
@@ -461,12 +524,73 @@ sub convert_tex {
 
     unshift @texinputs, ".";
 
-    local $ENV{TEXINPUTS} = join(":", @texinputs);
+    return join(":", @texinputs);
+}
+
+sub convert_tex {
+    my $self = shift;
+
+    my $tex_fragment = shift;
+    my $id = shift;
+
+    my $tex = shift;
+
+    my $starred = shift;
+
+    $CFG = TeXML::CFG->get_cfg();
+
+    my $job = $self->__make_job($tex_fragment, $id, $tex, $starred);
+
+    my ($svg_file, $error) = $self->__convert_job($job);
+
+    $self->__publish($job, $svg_file) if defined $svg_file;
+
+    return wantarray ? ($svg_file, $error) : $svg_file;
+}
+
+sub __convert_job {
+    my $self = shift;
+
+    my $job = shift;
+
+    my $tmp_dir = $self->__scratch_dir();
+
+    my $cwd = getcwd();
+
+    chdir($tmp_dir) or do {
+        die "Can't connect to $tmp_dir: $!\n";
+    };
+
+    my $base = "tex2svg";
+
+    my $tex_file = "$base.tex";
+
+    my $mode = $job->{unicode} ? ">:utf8" : ">";
+
+    open(my $fh, $mode, $tex_file) or do {
+        die "Can't open $tex_file\n";
+    };
+
+    $self->__write_preamble($fh, $job);
+
+    print { $fh } qq{\\begin{document}\n\n};
+
+    $self->__write_fragment($fh, $job);
+
+    print { $fh } qq{\\end{document}\n};
+
+    close($fh);
+
+    local $ENV{TEXMFCNF} = undef;
+
+    local $ENV{TEXINPUTS} = $self->__texinputs();
 
     my $svg_file = eval {
-        $self->generate_svg($tex_file, $tex_fragment, $id, $data_src, $use_xetex);
+        $self->generate_svg($tex_file, @{ $job }{qw(fragment id data_src use_xetex)});
     };
 
+    my $error = $@;
+
     chdir($cwd) or do {
         warn "Can't reconnect to $cwd: $!\n";
     };
@@ -476,12 +600,711 @@ sub convert_tex {
             CORE::system qq{/bin/cp -r $tmp_dir $cwd};
         }
 
-        return;
+        $error = trim($error) || "no SVG produced";
+
+        $error .= sprintf " (working files left in %s)", basename($tmp_dir);
+
+        return wantarray ? (undef, $error) : undef;
     }
 
     $svg_file = catdir($tmp_dir, $svg_file);
 
-    return -e $svg_file ? $svg_file : undef;
+    return $svg_file if -e $svg_file;
+
+    return wantarray ? (undef, "no SVG produced") : undef;
+}
+
+######################################################################
+##                                                                  ##
+##                              CACHE                               ##
+##                                                                  ##
+######################################################################
+
+## The cache key covers everything that goes into the LaTeX document
+## we generate for a fragment (see __write_preamble() and
+## __write_fragment()) and the programs that render it.  Bump
+## SVG_CACHE_VERSION whenever either of those functions changes in a
+## way that affects the output.
+##
+## Files that the fragment reads (external graphics, \input files) are
+## included by content, since the same fragment can refer to different
+## files in different articles.
+
+use constant SVG_CACHE_VERSION => 1;
+
+use constant DEPENDENCY_EXTENSIONS => qw(.eps .ps .pdf .mps .png .jpg .pstex_t .tex);
+
+sub use_cache {
+    my $self = shift;
+
+    return defined $self->get_cache();
+}
+
+{
+    my %TOOLCHAIN_VERSION;
+
+    sub __toolchain_version {
+        my $self = shift;
+
+        my $use_xetex = shift ? 1 : 0;
+
+        return $TOOLCHAIN_VERSION{$use_xetex} //= do {
+            my @commands = $use_xetex ? (PDF_ENGINE) : (DVI_ENGINE, DVIPS, PS2PDF);
+
+            push @commands, PDFCROP, PDF2SVG;
+
+            my ($engine) = split ' ', $commands[0];
+
+            my ($version) = split /\n/, qx{$engine --version 2>/dev/null} // "";
+
+            join "\n", $version // "", @commands,
+                $CFG->val(__PACKAGE__, 'stix_dvi_pkg', 'stix2'),
+                MATH_SF_FONT,
+                $self->__texinputs();
+        };
+    }
+}
+
+sub __dependency_digest {
+    my $self = shift;
+
+    my $fragment = shift;
+
+    my @names = $fragment =~ m{\\(?:includegraphics|input) \*? \s* (?:\[[^\]]*\] \s*)* \{([^{}]+)\}}gsmx;
+
+    return "" unless @names;
+
+    local $ENV{TEXINPUTS} = $self->__texinputs();
+
+    my $digest = Digest::MD5->new();
+
+    for my $name (@names) {
+        $name = trim($name);
+
+        my @candidates = ($name);
+
+        if (fileparse($name, qr{\.[^./]*}) eq $name) {
+            push @candidates, map { "$name$_" } DEPENDENCY_EXTENSIONS;
+        }
+
+        for my $candidate (@candidates) {
+            my $path = kpse_lookup($candidate);
+
+            next unless defined $path && open(my $fh, "<:raw", $path);
+
+            $digest->add(encode_utf8($candidate), "\0");
+            $digest->addfile($fh);
+
+            close($fh);
+        }
+    }
+
+    return $digest->hexdigest();
+}
+
+sub __cache_key {
+    my $self = shift;
+
+    my $job = shift;
+
+    return $job->{cache_key} //= md5_hex(encode_utf8(join "\0",
+        SVG_CACHE_VERSION,
+        $self->__toolchain_version($job->{use_xetex}),
+        $self->get_preamble() // "",
+        $job->{use_xetex} ? 1 : 0,
+        $job->{paper_width},
+        $job->{starred} ? 1 : 0,
+        $job->{unicode} ? 1 : 0,
+        $job->{fragment},
+        $self->__dependency_digest($job->{fragment})));
+}
+
+## If the cache has an SVG for this fragment, copies it to $out_file
+## and returns true.
+
+sub fetch_cached {
+    my $self = shift;
+
+    my $tex_fragment = shift;
+    my $id = shift;
+
+    my $tex = shift;
+
+    my $starred  = shift;
+    my $out_file = shift;
+
+    my $cache = $self->get_cache();
+
+    return unless defined $cache;
+
+    $CFG = TeXML::CFG->get_cfg();
+
+    my $job = $self->__make_job($tex_fragment, $id, $tex, $starred, $out_file);
+
+    return unless $cache->fetch($self->__cache_key($job), $out_file);
+
+    $self->__set_title_source($out_file, $job->{data_src});
+
+    return 1;
+}
+
+sub __publish {
+    my $self = shift;
+
+    my $job      = shift;
+    my $svg_file = shift;
+
+    my $cache = $self->get_cache();
+
+    return unless defined $cache;
+
+    $cache->store($self->__cache_key($job), $svg_file);
+
+    return;
+}
+
+## The SVG we got from the cache may have been made for a different
+## article, or for an earlier version of this one, so update the
+## source location recorded by add_title().
+
+sub __set_title_source {
+    my $self = shift;
+
+    my $svg_file = shift;
+    my $data_src = shift;
+
+    my $dom = eval { XML::LibXML->load_xml(location => $svg_file, huge => 1) };
+
+    return unless defined $dom;
+
+    my $title = $dom->documentElement()->firstChild();
+
+    return unless defined $title && $title->nodeName() eq 'title';
+
+    my $old_src = $title->getAttribute('data-texml-source');
+
+    return if defined $old_src && $old_src eq $data_src;
+
+    $title->setAttribute('data-texml-source', $data_src);
+
+    $dom->toFile($svg_file, 1);
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                         DEFERRED RENDERING                       ##
+##                                                                  ##
+######################################################################
+
+## Running LaTeX, pdfcrop and pdf2svg for every fragment while the
+## interpreter waits is where most of the time goes in a document
+## with many SVGs.  So instead of calling convert_tex(),
+## TeXMLCreateSVG can hand a fragment to queue_tex(), which records it
+## and returns immediately.  The fragments are rendered by a pool of
+## up to WORKERS child processes while the interpreter carries on, and
+## flush_queue(), called from close_files_and_terminate(), waits for
+## the stragglers.  With workers=0 everything is rendered by the
+## interpreter itself in flush_queue().
+##
+## In batch mode a worker takes every queued fragment that can share a
+## document (same engine and paper width) and sets each on its own
+## page, so one LaTeX run and one pdfcrop yield one cropped page per
+## fragment, which pdf2svg converts page by page.  If anything goes
+## wrong with a batch (including a fragment that doesn't produce
+## exactly one page), its fragments are rendered one at a time, so
+## that errors are reported against the right fragment.
+##
+## Failures are reported by the interpreter (never by the workers),
+## through print_err(), with the id of the fragment.
+
+sub __num_cores {
+    chomp(my $num_cores = qx{getconf _NPROCESSORS_ONLN 2>/dev/null} // "");
+
+    return $num_cores =~ m{\A \d+ \z}smx && $num_cores > 0 ? $num_cores : 1;
+}
+
+{
+    my $NUM_WORKERS;
+
+    sub num_workers {
+        my $self = shift;
+
+        return $NUM_WORKERS if defined $NUM_WORKERS;
+
+        $CFG = TeXML::CFG->get_cfg();
+
+        my $num_workers = $CFG->val(__PACKAGE__, 'workers');
+
+        if (! defined $num_workers || $num_workers !~ m{\A \d+ \z}smx) {
+            $num_workers = __num_cores();
+        }
+
+        return $NUM_WORKERS = $num_workers;
+    }
+}
+
+sub is_batch {
+    my $self = shift;
+
+    $CFG = TeXML::CFG->get_cfg();
+
+    return BATCH;
+}
+
+## True if TeXMLCreateSVG should use queue_tex() rather than
+## convert_tex().
+
+sub is_deferred {
+    my $self = shift;
+
+    return $self->is_batch() || $self->num_workers() > 0;
+}
+
+sub queue_tex {
+    my $self = shift;
+
+    my $tex_fragment = shift;
+    my $id = shift;
+
+    my $tex = shift;
+
+    my $starred  = shift;
+    my $out_file = shift;
+
+    $CFG = TeXML::CFG->get_cfg();
+
+    return if defined $self->get_pending($out_file);
+
+    my $job = $self->__make_job($tex_fragment, $id, $tex, $starred, $out_file);
+
+    $self->set_pending($out_file, $job);
+
+    $self->push_job($job);
+
+    $self->__reap_workers(0);
+
+    $self->__dispatch(0);
+
+    return;
+}
+
+sub is_pending {
+    my $self = shift;
+
+    my $file = shift;
+
+    return defined $self->get_pending($file);
+}
+
+## After flush_queue(), the result for each queued file is 1 if the
+## SVG was written and 0 if not.
+
+sub get_status {
+    my $self = shift;
+
+    my $file = shift;
+
+    return $self->get_result($file);
+}
+
+sub flush_queue {
+    my $self = shift;
+
+    if ($self->num_workers() == 0) {
+        while (my @task = $self->__next_task(1)) {
+            $self->__record_results($self->__run_task(\@task));
+        }
+    } else {
+        while (@{ $self->get_jobs() } || %{ $self->get_workers() }) {
+            $self->__dispatch(1);
+
+            $self->__reap_workers(1);
+        }
+    }
+
+    if (defined(my $cache = $self->get_cache())) {
+        if (%{ $self->get_results() } || $cache->get_num_stored()) {
+            $cache->prune();
+        }
+    }
+
+    return;
+}
+
+## Removes the next task (a list of jobs to be rendered together) from
+## the queue.  If $final is true, no more jobs are coming, so a batch
+## is spread over the idle workers rather than handed to one of them.
+
+sub __next_task {
+    my $self = shift;
+
+    my $final = shift;
+
+    my @jobs = $self->get_jobs();
+
+    return unless @jobs;
+
+    my $key = __batch_key($jobs[0]);
+
+    my @task;
+    my @rest;
+
+    if ($self->is_batch()) {
+        my @candidates = grep { __batch_key($_) eq $key } @jobs;
+
+        my $size = @candidates;
+
+        if ($final) {
+            my $idle = $self->num_workers() - keys %{ $self->get_workers() };
+
+            $idle = 1 if $idle < 1;
+
+            $size = int((@candidates + $idle - 1) / $idle);
+        }
+
+        for my $job (@jobs) {
+            if (@task < $size && __batch_key($job) eq $key) {
+                push @task, $job;
+            } else {
+                push @rest, $job;
+            }
+        }
+    } else {
+        @task = shift @jobs;
+        @rest = @jobs;
+    }
+
+    $self->delete_jobs();
+
+    $self->push_job(@rest) if @rest;
+
+    return @task;
+}
+
+sub __batch_key {
+    my $job = shift;
+
+    return join ":", @{ $job }{qw(use_xetex paper_width unicode)};
+}
+
+sub __dispatch {
+    my $self = shift;
+
+    my $final = shift;
+
+    my $max_workers = $self->num_workers();
+
+    while (keys %{ $self->get_workers() } < $max_workers) {
+        my @task = $self->__next_task($final);
+
+        last unless @task;
+
+        $self->__start_worker(\@task);
+    }
+
+    return;
+}
+
+sub __start_worker {
+    my $self = shift;
+
+    my $task = shift;
+
+    pipe(my $reader, my $writer) or do {
+        ## No more processes for us; do it ourselves.
+
+        $self->__record_results($self->__run_task($task));
+
+        return;
+    };
+
+    my $pid = fork();
+
+    if (! defined $pid) {
+        close($reader);
+        close($writer);
+
+        $self->__record_results($self->__run_task($task));
+
+        return;
+    }
+
+    if ($pid == 0) {
+        close($reader);
+
+        my @results = eval { $self->__run_task($task) };
+
+        if (my $error = $@) {
+            $error = trim($error);
+
+            @results = map { [ $_, 0, $error ] } @{ $task };
+        }
+
+        binmode($writer, ":utf8");
+
+        for my $result (@results) {
+            my ($job, $ok, $msg) = @{ $result };
+
+            ($msg //= "") =~ s{\s+}{ }g;
+
+            print { $writer } join("\t", $job->{out_file}, $ok, $msg), "\n";
+        }
+
+        close($writer);
+
+        ## Skip END blocks and buffered output that belong to the
+        ## interpreter, but clean up our own scratch directories.
+
+        File::Temp::cleanup();
+
+        POSIX::_exit(0);
+    }
+
+    close($writer);
+
+    $self->set_worker($pid, { reader => $reader, jobs => $task });
+
+    return;
+}
+
+## Collects finished workers.  If $block is true, waits until at least
+## one has finished.
+
+sub __reap_workers {
+    my $self = shift;
+
+    my $block = shift;
+
+    my $workers = $self->get_workers();
+
+    return unless %{ $workers };
+
+    my $select = IO::Select->new(map { $_->{reader} } values %{ $workers });
+
+    my %pid_of = map { ($workers->{$_}->{reader}, $_) } keys %{ $workers };
+
+    ## A worker's pipe only becomes readable when it writes its
+    ## results, just before it exits.
+
+    for my $reader ($select->can_read($block ? undef : 0)) {
+        my $pid = $pid_of{$reader};
+
+        my $worker = delete $workers_of{ident $self}->{$pid};
+
+        binmode($reader, ":utf8");
+
+        my %reported;
+
+        while (my $line = <$reader>) {
+            chomp($line);
+
+            my ($out_file, $ok, $msg) = split /\t/, $line, 3;
+
+            $reported{$out_file} = [ $ok, $msg ];
+        }
+
+        close($reader);
+
+        waitpid($pid, 0);
+
+        my @results;
+
+        for my $job (@{ $worker->{jobs} }) {
+            my ($ok, $msg) = @{ $reported{ $job->{out_file} } || [ 0, "SVG worker died" ] };
+
+            push @results, [ $job, $ok, $msg ];
+        }
+
+        $self->__record_results(@results);
+    }
+
+    return;
+}
+
+sub __record_results {
+    my $self = shift;
+
+    my $tex = $self->get_interpreter();
+
+    for my $result (@_) {
+        my ($job, $ok, $msg) = @{ $result };
+
+        my $out_file = $job->{out_file};
+
+        if ($ok) {
+            $tex->print_nl("Wrote SVG file $out_file");
+            $tex->print_ln();
+        } else {
+            $tex->print_err("Could not generate SVG $job->{id} ($job->{data_src}): $msg");
+
+            $tex->set_help("Skipping this graphic.");
+
+            $tex->error();
+        }
+
+        $self->set_result($out_file, $ok ? 1 : 0);
+
+        delete $pending_of{ident $self}->{$out_file};
+    }
+
+    return;
+}
+
+## Renders a list of jobs and copies the SVGs to their final
+## destinations.  Returns a list of [ job, ok, message ] triples.
+## This runs in a worker, so it mustn't talk to the interpreter.
+
+sub __run_task {
+    my $self = shift;
+
+    my $jobs = shift;
+
+    $self->set_quiet(1);
+
+    my @svg_files = @{ $jobs } > 1 ? $self->__convert_batch($jobs) : ();
+
+    my @results;
+
+    for (my $i = 0; $i < @{ $jobs }; $i++) {
+        my $job = $jobs->[$i];
+
+        my ($svg_file, $error) = defined $svg_files[$i] ? ($svg_files[$i])
+                                                        : $self->__convert_job($job);
+
+        my $out_file = $job->{out_file};
+
+        if (nonempty($svg_file)) {
+            if (copy($svg_file, $out_file)) {
+                $self->__publish($job, $svg_file);
+
+                push @results, [ $job, 1 ];
+            } else {
+                push @results, [ $job, 0, "Couldn't copy $svg_file to $out_file: $!" ];
+            }
+        } else {
+            push @results, [ $job, 0, $error ];
+        }
+    }
+
+    $self->set_quiet(0);
+
+    return @results;
+}
+
+## Returns a list of SVG files, one per job, or the empty list if the
+## batch failed.
+
+sub __convert_batch {
+    my $self = shift;
+
+    my $jobs = shift;
+
+    my $first = $jobs->[0];
+
+    my $tmp_dir = $self->__scratch_dir();
+
+    my $cwd = getcwd();
+
+    chdir($tmp_dir) or do {
+        die "Can't connect to $tmp_dir: $!\n";
+    };
+
+    my $base = "tex2svg";
+
+    my $tex_file = "$base.tex";
+
+    my $mode = $first->{unicode} ? ">:utf8" : ">";
+
+    open(my $fh, $mode, $tex_file) or do {
+        die "Can't open $tex_file\n";
+    };
+
+    $self->__write_preamble($fh, $first);
+
+    ## Record the page each fragment starts on so we can make sure
+    ## that the pages line up with the fragments.
+
+    print { $fh } qq{\\newwrite\\TeXMLpagelog\n};
+    print { $fh } qq{\\immediate\\openout\\TeXMLpagelog=$base.pages\n\n};
+
+    print { $fh } qq{\\begin{document}\n\n};
+
+    for my $job (@{ $jobs }) {
+        print { $fh } qq{\\clearpage\\thispagestyle{empty}\n};
+        print { $fh } qq{\\immediate\\write\\TeXMLpagelog{\\the\\value{page}}\n\n};
+
+        $self->__write_fragment($fh, $job);
+    }
+
+    print { $fh } qq{\\clearpage\n};
+    print { $fh } qq{\\immediate\\write\\TeXMLpagelog{\\the\\value{page}}\n};
+    print { $fh } qq{\\immediate\\closeout\\TeXMLpagelog\n\n};
+
+    print { $fh } qq{\\end{document}\n};
+
+    close($fh);
+
+    local $ENV{TEXMFCNF} = undef;
+
+    local $ENV{TEXINPUTS} = $self->__texinputs();
+
+    my $quiet = $self->is_quiet();
+
+    $self->set_quiet(1);
+
+    my @svg_files = eval {
+        my $cropped_pdf = $self->__make_cropped_pdf($tex_file, $first->{use_xetex});
+
+        die "No cropped PDF\n" unless -e $cropped_pdf;
+
+        my @pages = __read_page_log("$base.pages");
+
+        my $num_jobs = @{ $jobs };
+
+        for (my $i = 0; $i <= $num_jobs; $i++) {
+            die "Pages don't match fragments\n" unless ($pages[$i] // -1) == $pages[0] + $i;
+        }
+
+        my @files;
+
+        for (my $i = 0; $i < $num_jobs; $i++) {
+            my $job = $jobs->[$i];
+
+            my $svg_file = sprintf "%s-%d.svg", $base, $i + 1;
+
+            $self->system(PDF2SVG, $cropped_pdf, $svg_file, $i + 1);
+
+            $self->add_title($svg_file, @{ $job }{qw(fragment id data_src)});
+
+            die "Missing $svg_file\n" unless -e $svg_file;
+
+            push @files, catdir($tmp_dir, $svg_file);
+        }
+
+        @files;
+    };
+
+    $self->set_quiet($quiet);
+
+    chdir($cwd) or do {
+        warn "Can't reconnect to $cwd: $!\n";
+    };
+
+    return @svg_files;
+}
+
+sub __read_page_log {
+    my $file = shift;
+
+    open(my $fh, "<", $file) or return;
+
+    my @pages = map { m{(\d+)} ? $1 : () } <$fh>;
+
+    close($fh);
+
+    return @pages;
 }
 
 1;
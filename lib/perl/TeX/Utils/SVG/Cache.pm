@@ -0,0 +1,245 @@
+package TeX::Utils::SVG::Cache;
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use warnings;
+
+## A TeX::Utils::SVG::Cache is a directory of rendered SVGs named by a
+## key that TeX::Utils::SVG computes from everything that goes into
+## rendering a fragment.  The directory can be shared by any number of
+## concurrent jobs:
+##
+##     * Entries are written to a temporary file in the same directory
+##       and renamed into place, so readers see either the whole SVG or
+##       nothing.
+##
+##     * A hit updates the entry's mtime, so mtime order is LRU order.
+##
+##     * prune() deletes the least recently used entries until the
+##       cache is under max_size.  Deleting an entry that another job
+##       is about to read just turns that job's hit into a miss.
+
+use File::Basename;
+use File::Copy;
+use File::Find;
+use File::Path qw(make_path);
+use File::Spec::Functions qw(catdir catfile tmpdir);
+use File::Temp;
+
+use TeX::Class;
+
+use TeXML::CFG;
+
+my %dir_of      :ATTR(:name<dir>);
+my %max_size_of :ATTR(:name<max_size>); # bytes
+
+my %num_stored_of :COUNTER(:name<num_stored> :default<0>);
+
+######################################################################
+##                                                                  ##
+##                           CONSTRUCTOR                            ##
+##                                                                  ##
+######################################################################
+
+## Returns undef if caching has been turned off (cache=0 in the
+## [TeX::Utils::SVG] section of the config file).
+
+sub from_cfg {
+    my $class = shift;
+
+    my $CFG = TeXML::CFG->get_cfg();
+
+    my $section = 'TeX::Utils::SVG';
+
+    return unless $CFG->val($section, 'cache', 1);
+
+    my $dir = $CFG->val($section, 'cache_dir');
+
+    if (! defined $dir || $dir !~ /\S/) {
+        if (defined $ENV{XDG_CACHE_HOME} && $ENV{XDG_CACHE_HOME} =~ /\S/) {
+            $dir = catdir($ENV{XDG_CACHE_HOME}, "texml", "svg");
+        } elsif (defined $ENV{HOME} && -d $ENV{HOME}) {
+            $dir = catdir($ENV{HOME}, ".cache", "texml", "svg");
+        } else {
+            $dir = catdir(tmpdir(), "texml-$<", "svg");
+        }
+    }
+
+    ## The size cap is given in megabytes.
+
+    my $max_size = $CFG->val($section, 'cache_max_size', 256);
+
+    $max_size = 256 unless $max_size =~ m{\A \d+ (?:\.\d*)? \z}smx;
+
+    return $class->new({ dir => $dir, max_size => $max_size * 1024 * 1024 });
+}
+
+######################################################################
+##                                                                  ##
+##                             ENTRIES                              ##
+##                                                                  ##
+######################################################################
+
+sub entry_file {
+    my $self = shift;
+
+    my $key = shift;
+
+    return catfile($self->get_dir(), substr($key, 0, 2), "$key.svg");
+}
+
+## Copies the entry for $key (if any) to $out_file.
+
+sub fetch {
+    my $self = shift;
+
+    my $key      = shift;
+    my $out_file = shift;
+
+    my $entry = $self->entry_file($key);
+
+    return unless -e $entry;
+
+    ## The entry might be pruned by another job at any moment.
+
+    copy($entry, $out_file) or return;
+
+    my $now = time();
+
+    utime($now, $now, $entry);
+
+    return 1;
+}
+
+sub store {
+    my $self = shift;
+
+    my $key      = shift;
+    my $svg_file = shift;
+
+    my $entry = $self->entry_file($key);
+
+    my $dir = dirname($entry);
+
+    eval { make_path($dir) };
+
+    return unless -d $dir;
+
+    my $tmp = eval { File::Temp->new(DIR => $dir, UNLINK => 0, SUFFIX => ".tmp") };
+
+    return unless defined $tmp;
+
+    my $tmp_file = $tmp->filename();
+
+    close($tmp);
+
+    if (copy($svg_file, $tmp_file)) {
+        chmod(0666 & ~umask(), $tmp_file);
+
+        if (rename($tmp_file, $entry)) {
+            $self->incr_num_stored();
+
+            return 1;
+        }
+    }
+
+    unlink($tmp_file);
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                             PRUNING                              ##
+##                                                                  ##
+######################################################################
+
+## Leftover temporary files older than this are fair game.
+
+use constant STALE_TMP_AGE => 3600;
+
+sub prune {
+    my $self = shift;
+
+    my $dir = $self->get_dir();
+
+    return unless -d $dir;
+
+    my $max_size = $self->get_max_size();
+
+    my @entries;
+
+    my $total = 0;
+
+    my $now = time();
+
+    find({ no_chdir => 1,
+           wanted   => sub {
+               return unless -f $_;
+
+               my ($size, $mtime) = (stat(_))[7, 9];
+
+               if (m{\.tmp\z}) {
+                   unlink($_) if $now - $mtime > STALE_TMP_AGE;
+
+                   return;
+               }
+
+               return unless m{\.svg\z};
+
+               push @entries, [ $_, $size, $mtime ];
+
+               $total += $size;
+           },
+         }, $dir);
+
+    return if $total <= $max_size;
+
+    ## Go a bit below the limit so that we don't have to prune after
+    ## every job.
+
+    my $target = int(0.9 * $max_size);
+
+    for my $entry (sort { $a->[2] <=> $b->[2] } @entries) {
+        last if $total <= $target;
+
+        if (unlink($entry->[0])) {
+            $total -= $entry->[1];
+        }
+    }
+
+    return;
+}
+
+1;
+
+__END__
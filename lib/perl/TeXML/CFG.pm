@@ -91,18 +91,9 @@ GET_CFG: {
 
         return $CFG if defined $CFG;
 
-        my $config = Config::IniFiles->new(-default => 'DEFAULTS',
-                                           -allowcontinue => 1);
+        $CFG = __PACKAGE__->new($arg_ref);
 
-        $CFG = __PACKAGE__->new({ $arg_ref->%*, config => $config });
-
-        my $cfg_file = catfile($CFG->get_cfg_dir(), $CFG->get_cfg_file());
-
-        if (-e $cfg_file) {
-            $CFG->SetFileName($cfg_file);
-
-            $CFG->ReadConfig();
-        }
+        $CFG->read_cfg_file($CFG->get_cfg_file());
 
         return $CFG;
     }
@@ -111,6 +102,33 @@ GET_CFG: {
     END { undef $CFG; }
 }
 
+## Replaces the configuration with the contents of $cfg_file (relative
+## to cfg_dir).  Since everybody shares the object returned by
+## get_cfg(), this is how a different config file is put into effect
+## after the modules have been loaded.
+
+sub read_cfg_file {
+    my $self = shift;
+
+    my $cfg_file = shift;
+
+    my $config = Config::IniFiles->new(-default => 'DEFAULTS',
+                                       -allowcontinue => 1);
+
+    $self->set_cfg_file($cfg_file);
+    $self->set_config($config);
+
+    my $path = catfile($self->get_cfg_dir(), $cfg_file);
+
+    if (-e $path) {
+        $config->SetFileName($path);
+
+        $config->ReadConfig();
+    }
+
+    return;
+}
+
 sub val {
     my $self = shift;
 
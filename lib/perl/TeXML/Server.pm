@@ -0,0 +1,421 @@
+package TeXML::Server;
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+# This code is experimental and is provided completely without warranty
+# or without any promise of support.  However, it is under active
+# development and we welcome any comments you may have on it.
+
+# American Mathematical Society
+# Technical Support
+# Publications Technical Group
+# 201 Charles Street
+# Providence, RI 02904
+# USA
+# email: tech-support@ams.org
+
+use warnings;
+
+## A TeXML::Server listens on a local Unix socket and runs one job per
+## connection.  Whatever the preload callback builds (for texml, a
+## TeX::Interpreter::LaTeX that has already loaded its format and
+## installed the LaTeX kernel) is built once, before the first
+## connection is accepted, and each job runs in a forked child, so
+## every job starts from a pristine copy-on-write copy of it.
+##
+## The protocol is deliberately dumb.  The client sends a single line
+## containing a JSON object
+##
+##     { "cwd" : "...", "args" : [ ... ], "env" : { ... } }
+##
+## and the server copies everything the job writes to STDOUT and
+## STDERR back over the socket.  When the job is over, the server
+## sends STATUS_MARKER followed by a JSON object containing the job's
+## exit status and a newline.  Since the job's output needn't end with
+## a newline (e.g., if it was killed), the marker can turn up in the
+## middle of the last line.
+
+use Cwd;
+
+use File::Spec::Functions qw(catfile tmpdir);
+
+use IO::Handle;
+use IO::Socket::UNIX;
+
+use JSON::PP;
+
+use POSIX qw(:sys_wait_h _exit);
+
+use Socket qw(SOCK_STREAM SOMAXCONN);
+
+use TeX::Class;
+
+use TeXML::CFG;
+
+use constant STATUS_MARKER => "\0TEXML-STATUS ";
+
+my %socket_path_of :ATTR(:name<socket_path>);
+
+my %preload_of :ATTR(:name<preload>);
+my %handler_of :ATTR(:name<handler>);
+
+my %listener_of :ATTR(:name<listener>);
+
+my %num_jobs_of :COUNTER(:name<num_jobs> :default<0>);
+
+######################################################################
+##                                                                  ##
+##                           CONSTRUCTOR                            ##
+##                                                                  ##
+######################################################################
+
+sub default_socket_path {
+    my $class = shift;
+
+    my $program_name = shift || 'texml';
+
+    my $CFG = TeXML::CFG->get_cfg();
+
+    if (defined (my $path = $CFG->val($program_name, 'server_socket'))) {
+        return $path if $path =~ /\S/;
+    }
+
+    return catfile(tmpdir(), "$program_name-$<.sock");
+}
+
+sub START {
+    my ($self, $ident, $arg_ref) = @_;
+
+    if (! defined $self->get_socket_path()) {
+        $self->set_socket_path(__PACKAGE__->default_socket_path());
+    }
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                              SERVER                              ##
+##                                                                  ##
+######################################################################
+
+sub __log {
+    my $self = shift;
+
+    my $msg = join '', @_;
+
+    my $time = localtime;
+
+    print STDERR "[$time] texml server ($$): $msg\n";
+
+    return;
+}
+
+sub open_socket {
+    my $self = shift;
+
+    my $path = $self->get_socket_path();
+
+    if (-S $path) {
+        ## Refuse to steal the socket from a live server.
+
+        if (IO::Socket::UNIX->new(Type => SOCK_STREAM, Peer => $path)) {
+            die "A server is already listening on $path\n";
+        }
+
+        unlink $path or die "Can't remove stale socket $path: $!\n";
+    }
+
+    my $old_umask = umask(0077);
+
+    my $listener = IO::Socket::UNIX->new(Type   => SOCK_STREAM,
+                                         Local  => $path,
+                                         Listen => SOMAXCONN);
+
+    umask($old_umask);
+
+    die "Can't listen on $path: $!\n" unless defined $listener;
+
+    $self->set_listener($listener);
+
+    return $listener;
+}
+
+sub serve {
+    my $self = shift;
+
+    if (defined(my $preload = $self->get_preload())) {
+        $self->__log("preloading");
+
+        $preload->();
+    }
+
+    my $listener = $self->open_socket();
+
+    my $path = $self->get_socket_path();
+
+    my $parent = $$;
+
+    my $shutdown = sub {
+        unlink $path if $$ == $parent;
+
+        exit 0;
+    };
+
+    local $SIG{INT}  = $shutdown;
+    local $SIG{TERM} = $shutdown;
+    local $SIG{HUP}  = $shutdown;
+
+    local $SIG{CHLD} = sub {
+        1 while waitpid(-1, WNOHANG) > 0;
+    };
+
+    $self->__log("listening on $path");
+
+    while (1) {
+        my $client = $listener->accept();
+
+        if (! defined $client) {
+            next if $!{EINTR};
+
+            die "accept failed on $path: $!\n";
+        }
+
+        my $pid = fork();
+
+        if (! defined $pid) {
+            $self->__log("fork failed: $!");
+
+            close($client);
+
+            next;
+        }
+
+        if ($pid == 0) {
+            close($listener);
+
+            $self->__supervise($client);
+
+            _exit(0);
+        }
+
+        $self->incr_num_jobs();
+
+        close($client);
+    }
+
+    return;
+}
+
+## The supervisor reads the request, forks the worker that actually
+## runs the job and reports the worker's exit status to the client.
+## Keeping the two separate means the client gets a status even if
+## the job dies horribly.
+
+sub __supervise {
+    my $self = shift;
+
+    my $client = shift;
+
+    local $SIG{CHLD} = 'DEFAULT';
+
+    my $json = JSON::PP->new()->utf8()->canonical();
+
+    my $line = <$client>;
+
+    my $request = eval { $json->decode($line // '') };
+
+    if (ref($request) ne 'HASH' || ref($request->{args}) ne 'ARRAY') {
+        $self->__log("malformed request");
+
+        $self->__send_status($client, { status => 2,
+                                        error  => "malformed request" });
+
+        return;
+    }
+
+    my $cwd = $request->{cwd} // '';
+
+    $self->__log("job in '$cwd': @{ $request->{args} }");
+
+    my $pid = fork();
+
+    if (! defined $pid) {
+        $self->__send_status($client, { status => 2,
+                                        error  => "fork failed: $!" });
+
+        return;
+    }
+
+    if ($pid == 0) {
+        $self->__run_job($client, $request);
+
+        ## NOT REACHED
+    }
+
+    waitpid($pid, 0);
+
+    my $wait_status = $?;
+
+    my %status = (status => $wait_status >> 8);
+
+    if (my $signal = $wait_status & 127) {
+        $status{status} = 128 + $signal;
+        $status{error}  = "job killed by signal $signal";
+    }
+
+    $self->__log("job in '$cwd' finished with status $status{status}");
+
+    $self->__send_status($client, \%status);
+
+    return;
+}
+
+sub __send_status {
+    my $self = shift;
+
+    my $client = shift;
+    my $status = shift;
+
+    my $json = JSON::PP->new()->utf8()->canonical();
+
+    binmode($client, ":raw");
+
+    print { $client } STATUS_MARKER, $json->encode($status), "\n";
+
+    close($client);
+
+    return;
+}
+
+sub __run_job {
+    my $self = shift;
+
+    my $client  = shift;
+    my $request = shift;
+
+    my $status = 2;
+
+    eval {
+        if (ref(my $env = $request->{env}) eq 'HASH') {
+            %ENV = %{ $env };
+        }
+
+        if (defined(my $cwd = $request->{cwd})) {
+            chdir($cwd) or die "Can't chdir to $cwd: $!\n";
+        }
+
+        open(STDOUT, ">&", $client) or die "Can't dup STDOUT: $!\n";
+        open(STDERR, ">&", $client) or die "Can't dup STDERR: $!\n";
+
+        close($client);
+
+        binmode(STDOUT, ":encoding(UTF-8)");
+        binmode(STDERR, ":encoding(UTF-8)");
+
+        STDOUT->autoflush(1);
+        STDERR->autoflush(1);
+
+        $status = $self->get_handler()->(@{ $request->{args} }) // 0;
+    };
+
+    if ($@) {
+        print STDERR $@;
+    }
+
+    STDOUT->flush();
+    STDERR->flush();
+
+    ## Use exit() rather than _exit() so that File::Temp and friends
+    ## can clean up after the job.
+
+    exit($status);
+}
+
+######################################################################
+##                                                                  ##
+##                              CLIENT                              ##
+##                                                                  ##
+######################################################################
+
+## submit() sends a job to the server and copies the job's output to
+## STDOUT.  It returns the job's exit status and the status record
+## sent by the server (or undef if we lost contact with the server).
+
+sub submit {
+    my $self = shift;
+
+    my @args = @_;
+
+    my $path = $self->get_socket_path();
+
+    my $socket = IO::Socket::UNIX->new(Type => SOCK_STREAM, Peer => $path) or do {
+        die "Can't connect to texml server on $path: $!\n";
+    };
+
+    binmode($socket, ":raw");
+
+    my $json = JSON::PP->new()->utf8()->canonical();
+
+    my $request = { cwd  => getcwd(),
+                    args => \@args,
+                    env  => { %ENV },
+    };
+
+    print { $socket } $json->encode($request), "\n";
+
+    $socket->flush();
+
+    binmode(STDOUT, ":raw");
+
+    STDOUT->autoflush(1);
+
+    my $status;
+
+    while (my $line = <$socket>) {
+        if ($line =~ m{\A (.*?) \Q${\ STATUS_MARKER}\E (.*) \z}smx) {
+            print $1;
+
+            $status = eval { $json->decode($2) };
+
+            last;
+        }
+
+        print $line;
+    }
+
+    close($socket);
+
+    if (! defined $status) {
+        print STDERR "Lost contact with texml server on $path\n";
+
+        return wantarray ? (2, undef) : 2;
+    }
+
+    if (defined $status->{error}) {
+        print STDERR "texml server: $status->{error}\n";
+    }
+
+    return wantarray ? ($status->{status}, $status) : $status->{status};
+}
+
+1;
+
+__END__
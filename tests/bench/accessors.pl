@@ -0,0 +1,78 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Compares the cost of reading and writing interpreter parameters
+## through the installed named accessors with the old route, in which
+## every call fell through to TeX::Class::AUTOLOAD and AUTOMETHOD
+## built a fresh closure.
+##
+## Usage: perl tests/bench/accessors.pl [seconds]
+
+use FindBin;
+
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Benchmark qw(cmpthese);
+
+use Scalar::Util qw(refaddr);
+
+use TeX::Interpreter;
+
+my $seconds = shift // 3;
+
+my $tex = TeX::Interpreter->new();
+
+## Reproduces what a parameter access cost when it went through
+## AUTOLOAD: walk the class hierarchy and build the accessor.
+
+sub autoload_call {
+    my $tex    = shift;
+    my $method = shift;
+
+    local $_ = $method;
+
+    my $code = TeX::Interpreter::AUTOMETHOD($tex, refaddr($tex));
+
+    return $code->($tex, @_);
+}
+
+my @params = qw(end_line_char escape_char TeXML_SVG_mag);
+
+cmpthese(-$seconds, {
+    autoload => sub {
+        for my $param (@params) {
+            autoload_call($tex, $param);
+        }
+
+        autoload_call($tex, "set_end_line_char", 13);
+    },
+    named => sub {
+        for my $param (@params) {
+            $tex->$param();
+        }
+
+        $tex->set_end_line_char(13);
+    },
+});
+
+__END__
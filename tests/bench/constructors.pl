@@ -0,0 +1,130 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Measures how many objects per second TeX::Class can construct (and
+## destroy) for the classes the interpreter creates most often.
+##
+## Usage: perl tests/bench/constructors.pl [seconds] [baseline_lib]
+##
+## If baseline_lib is given (e.g., the lib/perl directory of a
+## checkout of an older version), the same measurements are also made
+## with the modules in that directory and the two are compared.
+
+use lib;
+
+use FindBin;
+
+BEGIN {
+    lib->import($ENV{TEXML_BENCH_LIB} // "$FindBin::RealBin/../../lib/perl");
+}
+
+use Benchmark qw(countit);
+
+use TeX::Interpreter;
+use TeX::Node::CharNode;
+use TeX::Token qw(:catcodes :factories :constants);
+use TeX::TokenList;
+
+my $seconds      = shift // 3;
+my $baseline_lib = shift;
+
+my @tokens = map { make_character_token($_, CATCODE_LETTER) } qw(a b c d e);
+
+my $token_list = TeX::TokenList->new({ tokens => \@tokens });
+
+my @CASES = (
+    [ "TeX::Token" => sub {
+          make_csname_token("foo", UNIQUE_TOKEN);
+      } ],
+    [ "TeX::TokenList" => sub {
+          TeX::TokenList->new({ tokens => \@tokens });
+      } ],
+    [ "TeX::Node::CharNode" => sub {
+          TeX::Node::CharNode->new({ char_code => 65 });
+      } ],
+    [ "TeX::Interpreter::InStateRecord" => sub {
+          TeX::Interpreter::InStateRecord->new({ token_list => $token_list,
+                                                 token_type => 3,
+                                                 token_loc  => 0 });
+      } ],
+);
+
+sub measure {
+    my %rate;
+
+    for my $case (@CASES) {
+        my ($class, $code) = @{ $case };
+
+        my $result = countit($seconds, $code);
+
+        my $cpu = $result->cpu_p();
+
+        $rate{$class} = $cpu > 0 ? $result->iters() / $cpu : 0;
+    }
+
+    return \%rate;
+}
+
+if (defined $ENV{TEXML_BENCH_LIB}) {
+    my $rate = measure();
+
+    print "$_ $rate->{$_}\n" for sort keys %{ $rate };
+
+    exit 0;
+}
+
+my %baseline;
+
+if (defined $baseline_lib) {
+    local $ENV{TEXML_BENCH_LIB} = $baseline_lib;
+
+    open(my $fh, "-|", $^X, $0, $seconds) or die "Can't run $0: $!\n";
+
+    while (<$fh>) {
+        $baseline{$1} = $2 if m{\A (\S+) \s+ (\S+) \s* \z}smx;
+    }
+
+    close($fh);
+}
+
+my $rate = measure();
+
+printf "%-34s %14s", "class", "objects/sec";
+
+printf " %14s %8s", "baseline", "speedup" if %baseline;
+
+print "\n";
+
+for my $case (@CASES) {
+    my $class = $case->[0];
+
+    printf "%-34s %14.0f", $class, $rate->{$class};
+
+    if (my $old = $baseline{$class}) {
+        printf " %14.0f %7.2fx", $old, $rate->{$class} / $old;
+    }
+
+    print "\n";
+}
+
+__END__
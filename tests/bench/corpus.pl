@@ -0,0 +1,559 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Runs bin/texml over the regression tests and records how long each
+## one takes, so that we notice when a change makes conversion slower.
+## Each test runs in a forked child of this process, which runs
+## bin/texml with -nosvg as if it had been invoked from the command
+## line.  For each test we record
+##
+##     wall, cpu : wall clock and CPU (user + system) seconds
+##     rss_kb    : peak resident set size (from /proc, so Linux only)
+##     tokens    : tokens asked for and tokens created (see
+##                 TeX::Token::get_token_counts())
+##     phases    : wall clock seconds spent in each phase of the run:
+##
+##         format       : loading the format (load_fmt_file())
+##         install      : installing the LaTeX kernel and the Perl
+##                        emulations of classes and packages
+##         main_control : everything else between \documentclass and
+##                        \end{document}
+##         finalize     : the output hooks and the rest of
+##                        TeX::Output::XML::finalize_document()
+##         pretty_print : writing the XML file
+##         other        : startup, shutdown and anything not covered
+##                        by the above
+##
+## Phase times are exclusive: installing a package from main_control
+## counts as install time, not main_control time.
+##
+## The results are written as JSON.  Given a baseline (an earlier
+## results file), the times are compared and any test that got slower
+## by more than the threshold is flagged.  The exit status is 1 if
+## anything regressed.
+##
+## Usage: perl tests/bench/corpus.pl [options] [test ...]
+##
+##     -output file     Write the results to file.
+##     -compare file    Compare the results with the baseline in file.
+##     -threshold pct   Percentage slowdown that counts as a regression
+##                      (default 10).
+##     -min_seconds s   Ignore differences smaller than this (default
+##                      0.1), since short phases are noisy.
+##     -repeat n        Run each test n times and keep the fastest run
+##                      (default 1).
+##     -texml option    Pass an option to bin/texml (e.g., -texml -nopp
+##                      or -texml -output_module=TeX::Output::XML::Stream).
+##                      May be repeated.
+##
+## The tests are named without the .tex extension and default to every
+## tests/*.tex that has a .xml.ref file.  They run in the tests
+## directory, and their output replaces what's there, as with
+## 00regress.sh.  Since class and package data is cached between runs
+## (see TeX::Interpreter::PackageData), the first run after a change to
+## a __DATA__ section is slower than the ones after it.
+
+use FindBin;
+
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Cwd qw(abs_path);
+
+use File::Basename;
+use File::Find;
+
+use Getopt::Long qw(:config no_ignore_case);
+
+use JSON::PP;
+
+use POSIX qw(strftime);
+
+use Scalar::Util qw(set_prototype);
+
+use Time::HiRes;
+
+use TeX::Interpreter::LaTeX;
+use TeX::Output::XML;
+use TeX::Output::XML::Stream;
+use TeX::Output::XML::PrettyPrinter;
+use TeX::Token;
+
+my $TESTS_DIR = abs_path("$FindBin::RealBin/..");
+my $LIB_DIR   = abs_path("$FindBin::RealBin/../../lib/perl");
+my $TEXML     = abs_path("$FindBin::RealBin/../../bin/texml");
+
+my @PHASES = qw(format install main_control finalize pretty_print other);
+
+my @METRICS = (qw(wall cpu), map { "phases.$_" } @PHASES);
+
+my %BENCH_OPT = (output      => undef,
+                 compare     => undef,
+                 threshold   => 10,
+                 min_seconds => 0.1,
+                 repeat      => 1,
+                 texml       => [],
+    );
+
+######################################################################
+##                                                                  ##
+##                          PHASE TIMING                            ##
+##                                                                  ##
+######################################################################
+
+## The phase we're in is the one on top of @PHASE_STACK; everything
+## since $PHASE_MARK is charged to it.
+
+my @PHASE_STACK = ('other');
+
+my $PHASE_MARK;
+
+my %PHASE_TIME;
+
+sub __switch_phase {
+    my $now = Time::HiRes::time();
+
+    $PHASE_TIME{ $PHASE_STACK[-1] } += $now - $PHASE_MARK;
+
+    $PHASE_MARK = $now;
+
+    return;
+}
+
+sub time_phase {
+    my $sub_name = shift;
+    my $phase    = shift;
+
+    no strict 'refs';
+    no warnings 'redefine';
+
+    my $orig = \&{ $sub_name };
+
+    my $wrapper = sub {
+        __switch_phase();
+
+        push @PHASE_STACK, $phase;
+
+        my @result;
+
+        my $ok = eval {
+            if (wantarray) {
+                @result = $orig->(@_);
+            } elsif (defined wantarray) {
+                $result[0] = $orig->(@_);
+            } else {
+                $orig->(@_);
+            }
+
+            1;
+        };
+
+        my $error = $@;
+
+        __switch_phase();
+
+        pop @PHASE_STACK;
+
+        die $error unless $ok;
+
+        return wantarray ? @result : $result[0];
+    };
+
+    ## Some of the install() methods have prototypes.
+
+    set_prototype(\&{ $wrapper }, prototype($orig));
+
+    *{ $sub_name } = $wrapper;
+
+    return;
+}
+
+## The class and package modules are loaded on demand, so we load them
+## all up front (as texml -server does) to be able to time their
+## install() methods.
+
+sub load_all_modules {
+    my @modules;
+
+    find(sub {
+             push @modules, $File::Find::name if m{\.pm\z};
+         }, "$LIB_DIR/TeX/Interpreter/LaTeX");
+
+    local $SIG{__WARN__} = sub {};
+
+    for my $path (sort @modules) {
+        (my $module_file = $path) =~ s{\A\Q$LIB_DIR\E/}{};
+
+        next if exists $INC{$module_file};
+
+        if (! eval { require $module_file }) {
+            delete $INC{$module_file};
+        }
+    }
+
+    return;
+}
+
+sub install_phase_timers {
+    time_phase('TeX::Interpreter::load_fmt_file' => 'format');
+
+    time_phase('TeX::Interpreter::main_control' => 'main_control');
+
+    for my $module_file (sort keys %INC) {
+        next unless $module_file =~ m{\A TeX/Interpreter/LaTeX (/ .*)? \.pm \z}smx;
+
+        (my $package = $module_file) =~ s{\.pm\z}{};
+
+        $package =~ s{/}{::}g;
+
+        no strict 'refs';
+
+        next unless defined &{ "${package}::install" };
+
+        time_phase("${package}::install" => 'install');
+    }
+
+    time_phase('TeX::Output::XML::finalize_document'         => 'finalize');
+    time_phase('TeX::Output::XML::Stream::finalize_document' => 'finalize');
+
+    time_phase('TeX::Output::XML::PrettyPrinter::write_document' => 'pretty_print');
+
+    return;
+}
+
+######################################################################
+##                                                                  ##
+##                          RUNNING TESTS                           ##
+##                                                                  ##
+######################################################################
+
+sub __peak_rss {
+    open(my $fh, "<", "/proc/self/status") or return;
+
+    while (<$fh>) {
+        return $1 if m{\A VmHWM: \s+ (\d+) \s+ kB}smx;
+    }
+
+    return;
+}
+
+sub __seconds {
+    my $seconds = shift;
+
+    return 0 + sprintf("%.4f", $seconds);
+}
+
+## Runs in the child.  bin/texml may exit() on its own, so the results
+## are reported from an END block.
+
+my $REPORT_FH;
+
+my %START;
+
+END {
+    if (defined $REPORT_FH) {
+        my $status = $?;
+
+        __switch_phase();
+
+        my $end = Time::HiRes::time();
+
+        my ($user, $system) = times();
+
+        my ($total_tokens, $distinct_tokens) = TeX::Token->get_token_counts();
+
+        my %result = (status => $status >> 8,
+                      wall   => __seconds($end - $START{wall}),
+                      cpu    => __seconds($user + $system - $START{cpu}),
+                      rss_kb => __peak_rss(),
+                      tokens => { total    => $total_tokens    - $START{total_tokens},
+                                  distinct => $distinct_tokens - $START{distinct_tokens},
+                      },
+                      phases => { map { $_ => __seconds($PHASE_TIME{$_} // 0) } @PHASES },
+            );
+
+        print { $REPORT_FH } encode_json(\%result);
+
+        close($REPORT_FH);
+
+        $? = $status;
+    }
+}
+
+sub run_texml {
+    my $test = shift;
+
+    pipe(my $reader, my $writer) or die "Can't create pipe: $!\n";
+
+    my $pid = fork();
+
+    die "Can't fork: $!\n" unless defined $pid;
+
+    if ($pid == 0) {
+        close($reader);
+
+        open(STDOUT, ">", "/dev/null");
+        open(STDERR, ">", "/dev/null");
+
+        $REPORT_FH = $writer;
+
+        my ($user, $system) = times();
+
+        @START{qw(total_tokens distinct_tokens)} = TeX::Token->get_token_counts();
+
+        $START{cpu} = $user + $system;
+
+        $START{wall} = $PHASE_MARK = Time::HiRes::time();
+
+        ## bin/texml finds its files relative to $FindBin::RealBin.
+
+        $0 = $TEXML;
+
+        FindBin::again();
+
+        @ARGV = ("-nosvg", @{ $BENCH_OPT{texml} }, "$test.tex");
+
+        do $TEXML;
+
+        exit($@ ? 255 : 0);
+    }
+
+    close($writer);
+
+    my $json = do { local $/; <$reader> };
+
+    close($reader);
+
+    waitpid($pid, 0);
+
+    ## Nothing to report if the child died before its END block ran.
+
+    return { status => $? >> 8 || 255 } unless defined $json && $json =~ m{\S};
+
+    return decode_json($json);
+}
+
+sub run_tests {
+    my @tests = @_;
+
+    my %results;
+
+    for my $test (@tests) {
+        printf "%-24s", $test;
+
+        my $best;
+
+        for (1..$BENCH_OPT{repeat}) {
+            my $result = run_texml($test);
+
+            if (! defined $best || ($result->{wall} // 0) < ($best->{wall} // 0)) {
+                $best = $result;
+            }
+        }
+
+        $results{$test} = $best;
+
+        if ($best->{status} || ! defined $best->{wall}) {
+            print " FAILED (status $best->{status})\n";
+        } else {
+            printf " %7.2fs wall %7.2fs cpu %8d kB %10d tokens\n",
+                @{ $best }{qw(wall cpu rss_kb)}, $best->{tokens}{total};
+        }
+    }
+
+    return \%results;
+}
+
+######################################################################
+##                                                                  ##
+##                            COMPARISON                            ##
+##                                                                  ##
+######################################################################
+
+sub __metric {
+    my $result = shift;
+    my $metric = shift;
+
+    my $value = $result;
+
+    for my $key (split /\./, $metric) {
+        return unless ref($value) eq 'HASH';
+
+        $value = $value->{$key};
+    }
+
+    return $value;
+}
+
+## Returns the number of regressions.
+
+sub compare_results {
+    my $results  = shift;
+    my $baseline = shift;
+
+    my $threshold   = $BENCH_OPT{threshold} / 100;
+    my $min_seconds = $BENCH_OPT{min_seconds};
+
+    my $num_regressions = 0;
+
+    print "\nComparison with $BENCH_OPT{compare}:\n\n";
+
+    for my $test (sort keys %{ $results->{tests} }) {
+        my $new = $results->{tests}{$test};
+        my $old = $baseline->{tests}{$test};
+
+        next unless defined $old && defined $old->{wall} && defined $new->{wall};
+
+        my @flagged;
+
+        for my $metric (@METRICS) {
+            my $old_value = __metric($old, $metric) // next;
+            my $new_value = __metric($new, $metric) // next;
+
+            my $delta = $new_value - $old_value;
+
+            next if $delta < $min_seconds;
+
+            next if $delta <= $threshold * $old_value;
+
+            push @flagged, sprintf "%s %.2fs -> %.2fs (%+.0f%%)",
+                $metric, $old_value, $new_value,
+                $old_value > 0 ? 100 * $delta / $old_value : 100;
+        }
+
+        my $old_rss = $old->{rss_kb};
+        my $new_rss = $new->{rss_kb};
+
+        if (defined $old_rss && defined $new_rss && $new_rss > (1 + $threshold) * $old_rss) {
+            push @flagged, sprintf "rss %d kB -> %d kB", $old_rss, $new_rss;
+        }
+
+        my $old_tokens = __metric($old, "tokens.total");
+        my $new_tokens = __metric($new, "tokens.total");
+
+        if (defined $old_tokens && defined $new_tokens && $new_tokens > (1 + $threshold) * $old_tokens) {
+            push @flagged, sprintf "tokens %d -> %d", $old_tokens, $new_tokens;
+        }
+
+        my $change = $old->{wall} > 0 ? 100 * ($new->{wall} - $old->{wall}) / $old->{wall} : 0;
+
+        printf "%-24s %7.2fs -> %7.2fs %+5.0f%%%s\n", $test,
+            $old->{wall}, $new->{wall}, $change, @flagged ? "  REGRESSION" : "";
+
+        print "    $_\n" for @flagged;
+
+        $num_regressions++ if @flagged;
+    }
+
+    print "\n$num_regressions regression(s)\n";
+
+    return $num_regressions;
+}
+
+######################################################################
+##                                                                  ##
+##                               MAIN                               ##
+##                                                                  ##
+######################################################################
+
+GetOptions("output=s"      => \$BENCH_OPT{output},
+           "compare=s"     => \$BENCH_OPT{compare},
+           "threshold=f"   => \$BENCH_OPT{threshold},
+           "min_seconds=f" => \$BENCH_OPT{min_seconds},
+           "repeat=i"      => \$BENCH_OPT{repeat},
+           "texml=s"       => $BENCH_OPT{texml},
+    ) or die "Usage: $0 [-output file] [-compare file] [-threshold pct] [-min_seconds s] [-repeat n] [-texml option] [test ...]\n";
+
+my $baseline;
+
+if (defined $BENCH_OPT{compare}) {
+    open(my $fh, "<", $BENCH_OPT{compare}) or die "Can't open $BENCH_OPT{compare}: $!\n";
+
+    $baseline = decode_json(do { local $/; <$fh> });
+
+    close($fh);
+}
+
+my $output_file = defined $BENCH_OPT{output} ? abs_path(dirname($BENCH_OPT{output})) . "/" . basename($BENCH_OPT{output}) : undef;
+
+chdir($TESTS_DIR) or die "Can't chdir to $TESTS_DIR: $!\n";
+
+my @tests = map { s{\.tex\z}{}r } @ARGV;
+
+if (! @tests) {
+    @tests = map { s{\.xml\.ref\z}{}r } sort glob("*.xml.ref");
+
+    @tests = grep { -e "$_.tex" } @tests;
+}
+
+load_all_modules();
+
+install_phase_timers();
+
+my $started = time();
+
+my %results = (date    => strftime("%Y-%m-%d %H:%M:%S", localtime($started)),
+               perl    => sprintf("%vd", $^V),
+               options => { texml => [ "-nosvg", @{ $BENCH_OPT{texml} } ],
+                            repeat => $BENCH_OPT{repeat} },
+               tests   => run_tests(@tests),
+    );
+
+my %total;
+
+for my $result (values %{ $results{tests} }) {
+    next unless defined $result->{wall};
+
+    $total{$_} += $result->{$_} for qw(wall cpu);
+
+    $total{phases}{$_} += $result->{phases}{$_} for @PHASES;
+
+    $total{tokens}{$_} += $result->{tokens}{$_} for qw(total distinct);
+}
+
+$total{$_} = __seconds($total{$_}) for qw(wall cpu);
+
+$total{phases}{$_} = __seconds($total{phases}{$_}) for keys %{ $total{phases} };
+
+$results{total} = \%total;
+
+printf "\n%-24s %7.2fs wall %7.2fs cpu\n", "total", @total{qw(wall cpu)};
+
+printf "    %-12s %7.2fs\n", $_, $total{phases}{$_} // 0 for @PHASES;
+
+if (defined $output_file) {
+    open(my $fh, ">", $output_file) or die "Can't open $output_file: $!\n";
+
+    print { $fh } JSON::PP->new()->canonical()->pretty()->encode(\%results);
+
+    close($fh);
+
+    print "\nResults written to $output_file\n";
+}
+
+if (defined $baseline) {
+    exit(compare_results(\%results, $baseline) ? 1 : 0);
+}
+
+exit 0;
+
+__END__
@@ -0,0 +1,96 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Measures the output stage on a long prose article: a few hundred
+## paragraphs of text, written one character at a time the way
+## hlist_out() sees it.  Compares adding each character to the DOM as
+## it arrives (what TeX::Output::XML::append_text() used to do) with
+## the pending text buffer, which adds one text node per run.
+##
+## Usage: perl tests/bench/xml_text.pl [seconds] [paragraphs]
+
+use FindBin;
+
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Benchmark qw(cmpthese);
+
+use TeX::Interpreter;
+use TeX::Output::XML;
+
+my $seconds    = shift // 3;
+my $paragraphs = shift // 300;
+
+my $tex = TeX::Interpreter->new();
+
+my @WORDS = qw(the of a theorem we let be then is proof and for any
+               space group which finite there exists such that module
+               follows from lemma above in particular it suffices to
+               show where denotes ring map exact sequence);
+
+## Deterministic paragraphs of 100-200 words.
+
+my @article;
+
+for my $i (1..$paragraphs) {
+    my $num_words = 100 + ($i * 37) % 101;
+
+    push @article, join " ", map { $WORDS[($i * 7 + $_ * 13) % @WORDS] } 1..$num_words;
+}
+
+my $num_chars = 0;
+
+$num_chars += length($_) for @article;
+
+print "$paragraphs paragraphs, $num_chars characters\n\n";
+
+sub write_article {
+    my $append = shift;
+
+    my $xml = TeX::Output::XML->new({ tex_engine => $tex });
+
+    $xml->open_document();
+
+    for my $paragraph (@article) {
+        $xml->open_element("p");
+
+        $append->($xml, $_) for split //, $paragraph;
+
+        $xml->close_element("p");
+    }
+
+    $xml->flush_pending_text();
+
+    return $xml->get_dom();
+}
+
+cmpthese(-$seconds, {
+    per_char => sub {
+        write_article(sub { $_[0]->get_current_element()->appendText($_[1]) });
+    },
+    buffered => sub {
+        write_article(sub { $_[0]->append_text($_[1]) });
+    },
+});
+
+__END__
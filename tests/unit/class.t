@@ -0,0 +1,152 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks the constructors and destructors that TeX::Class compiles.
+## Run with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Test::More;
+
+my @calls;
+
+package Base {
+    use TeX::Class;
+
+    my %name_of  :ATTR(:name<name> :default<"base">);
+    my %items_of :ARRAY(:name<item>);
+
+    sub BUILD { push @calls, "Base::BUILD" }
+    sub START { push @calls, "Base::START" }
+
+    sub DEMOLISH { push @calls, "Base::DEMOLISH" }
+}
+
+package Derived {
+    use TeX::Class;
+
+    use parent -norequire, 'Base';
+
+    my %size_of :COUNTER(:name<size> :default<3>);
+
+    sub BUILD {
+        my ($self, $ident, $args) = @_;
+
+        push @calls, "Derived::BUILD";
+
+        $args->{name} = "changed";
+    }
+}
+
+my %args = (name => "given", Derived => { size => 7 });
+
+my $obj = Derived->new(\%args);
+
+is($obj->get_name(), "given", "init_arg");
+is($obj->size(), 7, "class-specific init_arg");
+is($obj->num_items(), 0, "arrays start out empty");
+
+is_deeply(\%args, { name => "given", Derived => { size => 7 } },
+          "BUILD() gets a copy of the arguments");
+
+is_deeply(\@calls, [ qw(Base::BUILD Derived::BUILD Base::START) ],
+          "BUILD() and START() run in order");
+
+@calls = ();
+
+undef $obj;
+
+is_deeply(\@calls, [ "Base::DEMOLISH" ], "DEMOLISH() runs");
+
+$obj = Base->new();
+
+is($obj->get_name(), "base", "default");
+
+## Methods defined after the first object is created are still seen.
+
+{
+    no warnings 'redefine';
+
+    *Base::BUILD    = sub { push @calls, "new Base::BUILD" };
+    *Base::DEMOLISH = sub { push @calls, "new Base::DEMOLISH" };
+}
+
+@calls = ();
+
+Base->new();
+
+is_deeply(\@calls, [ "new Base::BUILD", "Base::START", "new Base::DEMOLISH" ],
+          "redefined methods are used");
+
+@calls = ();
+
+Derived->new();
+
+is_deeply(\@calls, [ "new Base::BUILD", "Derived::BUILD", "Base::START", "new Base::DEMOLISH" ],
+          "including by subclasses");
+
+## So are changes to @ISA.
+
+package Mixin {
+    sub START { push @calls, "Mixin::START" }
+}
+
+push @Derived::ISA, 'Mixin';
+
+@calls = ();
+
+Derived->new();
+
+is_deeply(\@calls, [ "new Base::BUILD", "Derived::BUILD", "Base::START", "Mixin::START", "new Base::DEMOLISH" ],
+          "new parents are used");
+
+## Type checks name the method
+
+package Hashed {
+    use TeX::Class;
+
+    my %things_of :ARRAY(:name<thing> :type<Base>);
+}
+
+package Arrayed {
+    use TeX::Class qw(:array_backed);
+
+    my %things_of :ARRAY(:name<thing> :type<Base>);
+}
+
+for my $class (qw(Hashed Arrayed)) {
+    my $obj = $class->new();
+
+    $obj->add_thing(Base->new());
+
+    is($obj->num_things(), 1, "$class: add_thing() adds");
+
+    eval { $obj->add_thing("not a Base") };
+
+    like($@, qr{\AIncorrect value type in add_thing\b}, "$class: add_thing() checks the type");
+}
+
+done_testing();
+
+__END__
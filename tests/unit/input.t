@@ -0,0 +1,168 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks how back_input() and friends manage the input stack.  Run
+## with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Scalar::Util qw(refaddr);
+
+use Test::More;
+
+use TeX::Interpreter;
+use TeX::Token qw(:factories :catcodes);
+use TeX::TokenList;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+my ($x, $y, $z) = map { make_character_token($_, CATCODE_LETTER) } qw(x y z);
+
+sub list {
+    return TeX::TokenList->new({ tokens => [ @_ ] });
+}
+
+sub read_all {
+    my $n = shift;
+
+    return join "", map { $tex->get_next() } 1..$n;
+}
+
+## Starts a backed-up list (by default just $x) on top of a level that still
+## has a $z in it, since back_input() doesn't reuse a level if it
+## would have discarded the one below it too.  Returns the depth of
+## the input stack.
+
+sub start_list {
+    my $tokens = shift // list($x);
+
+    $tex->back_list(list($z));
+    $tex->back_list($tokens);
+
+    return $tex->num_input_stacks();
+}
+
+## Backing up a token after reading the last one in a backed-up list
+## reuses its level.
+
+my $tokens = list($x);
+
+my $depth = start_list($tokens);
+
+my $first = $tex->get_next();
+
+$tex->back_input($first);
+
+is($tex->num_input_stacks(), $depth, "back_input() doesn't push a level");
+
+is(refaddr($tex->get_token_list()), refaddr($tokens), "it reuses the old one");
+
+is(read_all(2), "xz", "and the token comes back first");
+
+## Including a different token.
+
+$depth = start_list();
+
+$tex->get_next();
+
+$tex->back_input($z);
+
+is($tex->num_input_stacks(), $depth, "a different token reuses it too");
+
+is(read_all(2), "zz", "and it replaces the one that was read");
+
+## The list belongs to the input stack once back_list() has it.
+
+$tokens = list($x);
+
+start_list($tokens);
+
+$tex->get_next();
+
+$tex->back_input($z);
+
+is(read_all(2), "zz", "backing up into an adopted list");
+
+is(join("", map { $_->get_char() } $tokens->get_tokens()), "z",
+   "which is read in place");
+
+## A level that hasn't been read to the end isn't reused.
+
+$depth = start_list(list($x, $y));
+
+$tex->get_next();
+
+$tex->back_input($z);
+
+is($tex->num_input_stacks(), $depth + 1, "backing up in the middle of a list");
+
+is(read_all(3), "zyz", "pushes a new level");
+
+## Delimited parameters back up partial matches of the delimiter.
+
+$tex->convert_fragment("\\global\\catcode123=1 \\global\\catcode125=2 \\global\\catcode35=6\\relax");
+
+my $fragment = $tex->convert_fragment("\\def\\a#1ab{(#1)}\\a xaaxbayab.");
+
+is($fragment->textContent(), "(xaaxbay).", "partial delimiters are put back");
+
+## A macro that calls itself at the end of its body doesn't make the
+## input stack deeper, since the levels it has finished reading are
+## discarded first (tex.web §390).
+
+{
+    my $begin_macro_body = \&TeX::Interpreter::begin_macro_body;
+
+    my $deepest = 0;
+
+    no warnings 'redefine';
+
+    local *TeX::Interpreter::begin_macro_body = sub {
+        $begin_macro_body->(@_);
+
+        my $depth = $_[0]->num_input_stacks();
+
+        $deepest = $depth if $depth > $deepest;
+    };
+
+    $tex->convert_fragment('\gdef\a{\advance\count1 by 1 '
+                           . '\ifnum\count1<200 \let\next\a \else \let\next\relax \fi '
+                           . '\next}');
+
+    $fragment = $tex->convert_fragment('\count1=0 \a\the\count1');
+
+    is($fragment->textContent(), "200", "a tail-recursive macro");
+
+    cmp_ok($deepest, '<', 10, "doesn't make the input stack deeper");
+}
+
+done_testing();
+
+__END__
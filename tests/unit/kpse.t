@@ -0,0 +1,125 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks TeX::KPSE's in-process resolver against what kpsewhich
+## would do.  Run with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Cwd;
+use File::Path qw(make_path);
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::KPSE;
+
+sub touch {
+    my $file = shift;
+
+    open(my $fh, ">", $file) or die "Can't write $file: $!\n";
+
+    close($fh);
+
+    return;
+}
+
+my $tmp = tempdir(CLEANUP => 1);
+
+my $texmf = "$tmp/texmf";   # an absolute path element
+my $cwd   = "$tmp/job";     # the current directory (".//")
+my $bin   = "$tmp/bin";
+
+make_path($texmf, "$texmf/amsmath", "$cwd/sub", "$cwd/dir.tex", "$tmp/other", $bin);
+
+touch("$texmf/$_") for qw(shadow.tex dir.tex font.tfm amsmath/sub.sty);
+
+touch("$tmp/other/relative.tex");
+
+## A kpsewhich that only knows about fonts and one file outside of
+## TEXINPUTS, so we can tell whether it was asked.
+
+open(my $fh, ">", "$bin/kpsewhich") or die "Can't write $bin/kpsewhich: $!\n";
+
+print { $fh } qq{#!/bin/sh\ncase "\$*" in *font.tfm*) echo /fonts/font.tfm ;; *relative.tex*) echo ../other/relative.tex ;; esac\n};
+
+close($fh);
+
+chmod 0755, "$bin/kpsewhich";
+
+local $ENV{PATH}      = "$bin:$ENV{PATH}";
+local $ENV{TEXINPUTS} = ".//:$texmf";
+
+my $old_cwd = getcwd();
+
+chdir($cwd) or die "Can't chdir to $cwd: $!\n";
+
+ok(! main->can('kpse_statistics'), "kpse_statistics isn't exported by default");
+ok(! main->can('kpse_reset_cache'), "kpse_reset_cache isn't exported by default");
+
+is(kpse_lookup("dir.tex"), "$texmf/dir.tex", "directories aren't files");
+
+is(kpse_lookup("shadow.tex"), "$texmf/shadow.tex", "found along TEXINPUTS");
+
+touch("$cwd/sub/shadow.tex");
+
+is(kpse_lookup("shadow.tex"), "./sub/shadow.tex",
+   "a new file in .// shadows a remembered hit");
+
+is(kpse_lookup("font.tfm"), "/fonts/font.tfm",
+   "non-TeX formats aren't looked for along TEXINPUTS");
+
+is(kpse_lookup("missing.tex"), undef, "misses are misses");
+
+touch("$cwd/missing.tex");
+
+is(kpse_lookup("missing.tex"), "./missing.tex", "a new file in .// ends a miss");
+
+is(kpse_lookup("amsmath/sub.sty"), "$texmf/amsmath/sub.sty",
+   "subdirectories of non-recursive path elements");
+
+is(kpse_lookup("relative.tex"), "../other/relative.tex", "relative answers from kpsewhich");
+
+my $forks = TeX::KPSE::kpse_statistics()->{forks};
+
+is(kpse_lookup("relative.tex"), "../other/relative.tex", "are remembered");
+
+is(TeX::KPSE::kpse_statistics()->{forks}, $forks, "without asking kpsewhich again");
+
+chdir("$cwd/sub") or die "Can't chdir to $cwd/sub: $!\n";
+
+is(kpse_lookup("relative.tex"), "$tmp/other/relative.tex",
+   "and made absolute when the current directory changes");
+
+is_deeply([ TeX::KPSE::kpse_tex_file_names("foo") ], [ "foo.tex", "foo" ],
+          "\\input tries .tex first");
+
+is_deeply([ TeX::KPSE::kpse_tex_file_names("foo.sty") ], [ "foo.sty" ],
+          "unless the name has a TeX suffix");
+
+chdir($old_cwd);
+
+done_testing();
+
+__END__
@@ -0,0 +1,91 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks how macro bodies are read in place.  Run with "prove
+## tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::Interpreter;
+use TeX::Primitive::Macro;
+use TeX::Token qw(:factories :catcodes);
+use TeX::TokenList;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+my $foo = make_csname_token("foo");
+
+sub body {
+    return TeX::TokenList->new({ tokens => [ @_ ] });
+}
+
+## Arguments are read where the #n's are.
+
+my $x = make_character_token("x", CATCODE_LETTER);
+my $y = make_character_token("y", CATCODE_LETTER);
+
+$tex->begin_macro_body(body($x, make_param_ref_token(1), $x),
+                       [ $foo, body($y, $y) ]);
+
+is(join("", map { $tex->get_next() } 1..4), "xyyx", "arguments are substituted");
+
+## A #n without an argument is fatal, and the error says which macro
+## it was.
+
+my $error;
+
+{
+    no warnings 'redefine';
+
+    local *TeX::Interpreter::fatal_error = sub { die "$_[1]\n" };
+
+    $tex->begin_macro_body(body(make_param_ref_token(2)), [ $foo, body($y) ]);
+
+    eval { $tex->get_next() };
+
+    $error = $@;
+}
+
+like($error, qr{Undefined parameter 2 while expanding \\foo},
+     "the error names the macro");
+
+## scan_arguments() puts the calling token in slot 0.
+
+my $macro = TeX::Primitive::Macro->new({ replacement_text => body($x) });
+
+my $args = $macro->scan_arguments($tex, $foo);
+
+is($args->[0], $foo, "the calling token is kept with the arguments");
+
+done_testing();
+
+__END__
@@ -0,0 +1,82 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks which conversions memoize_fragments caches.  Run with "prove
+## tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::Interpreter;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new({ memoize_fragments => 1 });
+
+sub convert_twice {
+    my $string = shift;
+
+    my $hits = $tex->fragment_cache_hits();
+
+    $tex->convert_fragment($string) for 1..2;
+
+    return $tex->fragment_cache_hits() - $hits;
+}
+
+is(convert_twice('plain text'), 1, "plain text is cached");
+
+my %calls;
+
+$tex->define_csname(command => sub { $calls{command}++ });
+
+is(convert_twice('a \command b'), 0, "Perl commands aren't cached");
+is($calls{command}, 2, "so they run every time");
+
+$tex->define_pseudo_macro(pseudo => sub { $calls{pseudo}++; return });
+
+is(convert_twice('a \pseudo b'), 0, "Perl pseudo-macros aren't cached");
+is($calls{pseudo}, 2, "so they run every time");
+
+my $safe = sub { $calls{safe}++ };
+
+$tex->define_csname(safe => $safe);
+
+$tex->allow_memoization($safe);
+
+is(convert_twice('a \safe b'), 1, "unless they're declared safe");
+is($calls{safe}, 1, "in which case they only run once");
+
+$tex->define_csname(alsosafe => $safe);
+
+is(convert_twice('a \alsosafe b'), 1,
+   "it's the code that's safe, whatever it's called");
+
+done_testing();
+
+__END__
@@ -0,0 +1,275 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks what the package data cache keys on, and that a warm cache
+## gives the same results as a cold one.  Run with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::Interpreter;
+use TeX::Interpreter::PackageData;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+my $data = "\\def\\foo{bar}";
+
+my %NEW_VALUE = (catcode  => 12,
+                 lccode   => 122,
+                 uccode   => 122,
+                 sfcode   => 1234,
+                 mathcode => 1234,
+                 delcode  => 1234);
+
+for my $code (sort keys %NEW_VALUE) {
+    my $before = $tex->__eqtb_signature($data);
+
+    $tex->convert_fragment("\\global\\$code 65=$NEW_VALUE{$code}\\relax");
+
+    isnt($tex->__eqtb_signature($data), $before, "\\$code is part of the key");
+}
+
+my $alpha = ord("\x{3B1}");
+
+my $before = $tex->__eqtb_signature($data);
+
+$tex->convert_fragment("\\global\\lccode\"3B1=\"3B2\\relax");
+
+is($tex->__eqtb_signature($data), $before,
+   "other characters' codes aren't part of the key");
+
+isnt($tex->__eqtb_signature("$data\x{3B1}"), $tex->__eqtb_signature("$data\x{3B2}"),
+     "unless they appear in the data");
+
+sub new_recording {
+    return TeX::Interpreter::PackageData->new({
+        key          => "test",
+        base_level   => 0,
+        signed_chars => { map { $_ => 1 } 0..255 },
+    });
+}
+
+my $recording = new_recording();
+
+$tex->set_package_data($recording);
+
+$tex->get_lccode(ord("A"));
+$tex->get_sfcode(ord("A"));
+
+$tex->set_package_data(undef);
+
+ok(! $recording->is_opaque(), "reading a signed character's codes is fine");
+
+for my $getter (qw(get_lccode get_uccode get_tccode get_sfcode get_mathcode get_delcode)) {
+    my $recording = new_recording();
+
+    $tex->set_package_data($recording);
+
+    $tex->$getter($alpha);
+
+    $tex->set_package_data(undef);
+
+    ok($recording->is_opaque(), "$getter of another character can't be replayed");
+}
+
+$tex->convert_fragment("\\global\\catcode123=1 \\global\\catcode125=2\\relax");
+
+$recording = new_recording();
+
+$tex->set_package_data($recording);
+
+$tex->convert_fragment("\\lowercase{\x{3B1}}");
+
+$tex->set_package_data(undef);
+
+ok($recording->is_opaque(), "neither can \\lowercase");
+
+## End to end: convert a document with a cold cache and again with a
+## warm one, and check that replaying the recordings leaves the same
+## meanings and eqtb values behind and produces the same XML.  This
+## runs texml twice, so it takes a while.
+
+my $texml = "$FindBin::RealBin/../../bin/texml";
+
+my $lib = "$FindBin::RealBin/../../lib/perl";
+
+my $tmp = tempdir(CLEANUP => 1);
+
+open(my $doc, ">", "$tmp/pkgdata.tex") or die "Can't write pkgdata.tex: $!\n";
+
+print { $doc } <<'EOF';
+\documentclass{amsart}
+
+\usepackage{amssymb}
+\usepackage{amsthm}
+\usepackage{graphicx}
+\usepackage{xcolor}
+\usepackage{hyperref}
+\usepackage{cleveref}
+
+\newtheorem{theorem}{Theorem}[section]
+
+\title{Package data}
+
+\begin{document}
+
+\maketitle
+
+\section{Results}\label{S:results}
+
+\begin{theorem}\label{T:main}
+For all $x \in \mathbb{R}$, $\textcolor{red}{x^2} \geq 0$.
+\end{theorem}
+
+\begin{equation}\label{E:one}
+a \leqslant b
+\end{equation}
+
+By \cref{T:main} and \eqref{E:one}; see \href{https://www.ams.org/}{the AMS}
+and Section~\ref{S:results}.
+
+\end{document}
+EOF
+
+close($doc);
+
+## Loaded into texml with -M: turns the cache on, counts the
+## recordings that are replayed and writes the fingerprint of every
+## control sequence and of eqtb to pkgdata.eqtb at the end.
+
+open(my $pm, ">", "$tmp/DumpEqtb.pm") or die "Can't write DumpEqtb.pm: $!\n";
+
+print { $pm } <<'EOF';
+package DumpEqtb;
+
+use TeXML::CFG;
+use TeX::Interpreter;
+
+TeXML::CFG->get_cfg()->get_config()->newval('TeX::Interpreter::PackageData', 'cache', 1);
+
+my $replayed = 0;
+
+my $replay = \&TeX::Interpreter::replay_package_data;
+my $finish = \&TeX::Interpreter::close_files_and_terminate;
+
+no warnings 'redefine';
+
+*TeX::Interpreter::replay_package_data = sub {
+    my $ok = $replay->(@_);
+
+    $replayed++ if $ok;
+
+    return $ok;
+};
+
+*TeX::Interpreter::close_files_and_terminate = sub {
+    my $tex = $_[0];
+
+    open(my $fh, ">:utf8", "pkgdata.eqtb") or die "Can't write pkgdata.eqtb: $!\n";
+
+    print { $fh } "replayed $replayed\n";
+
+    my $csnames = $tex->get_csnames();
+
+    for my $name (sort keys %{ $csnames }) {
+        my $eqvt = $tex->get_csname($name);
+
+        my $meaning = defined $eqvt ? $eqvt->get_equiv() : undef;
+
+        print { $fh } "$name\t", $tex->fingerprint_meaning($meaning), "\n";
+    }
+
+    print { $fh } "eqtb\t", $tex->__eqtb_signature(""), "\n";
+
+    close($fh);
+
+    goto &{ $finish };
+};
+
+1;
+EOF
+
+close($pm);
+
+chdir($tmp) or die "Can't chdir to $tmp: $!\n";
+
+local $ENV{XDG_CACHE_HOME} = "$tmp/cache";
+
+sub convert {
+    unlink "pkgdata.xml", "pkgdata.eqtb";
+
+    system("$^X -I$lib -I$tmp -MDumpEqtb $texml -nosvg pkgdata.tex > pkgdata.stdout 2>&1");
+
+    is($?, 0, "texml succeeded");
+
+    my %result;
+
+    for my $ext (qw(xml eqtb)) {
+        open(my $fh, "<:raw", "pkgdata.$ext") or next;
+
+        local $/;
+
+        $result{$ext} = <$fh>;
+    }
+
+    ## Apart from when it was made.
+
+    $result{xml} =~ s{(date-type="xml-last-modified" iso-8601-date=")[^"]*}{$1}g
+        if defined $result{xml};
+
+    $result{replayed} = $1 if defined $result{eqtb} && $result{eqtb} =~ s{\A replayed \s (\d+) \n}{}smx;
+
+    return \%result;
+}
+
+my $cold = convert();
+
+my @recordings = glob("$tmp/cache/texml/pkgdata/*.dat");
+
+ok(@recordings > 0, "the cold run records package data");
+
+is($cold->{replayed}, 0, "the cold run replays nothing");
+
+my $warm = convert();
+
+is($warm->{replayed}, scalar @recordings, "the warm run replays every recording");
+
+ok(length($cold->{eqtb} // ""), "the meanings were dumped");
+
+is($warm->{eqtb}, $cold->{eqtb}, "the meanings and eqtb are the same");
+
+isnt($cold->{xml} // "", "", "there is some XML output");
+
+is($warm->{xml}, $cold->{xml}, "the XML output is the same");
+
+done_testing();
+
+__END__
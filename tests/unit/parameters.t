@@ -0,0 +1,79 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks the parameter accessors that TeX::Interpreter installs.  Run
+## with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::Interpreter;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+ok(defined &TeX::Interpreter::tracing_online, "getters are named subs");
+ok(defined &TeX::Interpreter::set_tracing_online, "so are setters");
+
+$tex->set_tracing_online(3);
+
+is($tex->tracing_online(), 3, "the getter sees the setter's value");
+
+$tex->convert_fragment("\\global\\tracingonline=5\\relax");
+
+is($tex->tracing_online(), 5, "and assignments made by TeX code");
+
+my $other = TeX::Interpreter->new();
+
+$other->set_tracing_online(7);
+
+is($tex->tracing_online(), 5, "each interpreter has its own parameters");
+
+## Real methods take precedence, including in subclasses.
+
+package My::Interpreter {
+    use parent -norequire, 'TeX::Interpreter';
+
+    sub tracing_macros { return "mine" }
+}
+
+my $mine = My::Interpreter->new();
+
+is($mine->tracing_macros(), "mine", "methods aren't overridden");
+
+$mine->set_tracing_online(2);
+
+is($mine->tracing_online(), 2, "subclasses get accessors too");
+
+is($tex->tracing_macros(), 0, "without affecting the base class");
+
+done_testing();
+
+__END__
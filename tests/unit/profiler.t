@@ -0,0 +1,115 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Drives a TeX::Interpreter::Profiler the way the interpreter does and
+## checks what it records.  Run with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Time::HiRes qw(sleep);
+
+use Test::More;
+
+use TeX::Interpreter::Profiler;
+
+## A macro's time includes the commands in its body.
+
+my $profiler = TeX::Interpreter::Profiler->new();
+
+my $macro = $profiler->enter('\\macro', undef);
+
+$profiler->leave_at_end_of_level($macro, 1);
+
+my $command = $profiler->enter('\\command', undef);
+
+sleep(0.05);
+
+$profiler->leave($command);
+
+is($profiler->num_frames(), 1, "the macro is still running while its body is read");
+
+$profiler->end_level(1);
+
+is($profiler->num_frames(), 0, "the macro is finished at the end of its body");
+
+cmp_ok($profiler->get_stat('\\macro')->{inclusive}, '>=', 0.05,
+       "the macro's inclusive time covers its body");
+
+cmp_ok($profiler->get_stat('\\macro')->{exclusive}, '<', 0.05,
+       "the macro's exclusive time doesn't");
+
+## A macro that calls itself at the end of its body, like \loop.
+
+$profiler = TeX::Interpreter::Profiler->new();
+
+my $outer = $profiler->enter('\\outer', undef);
+
+my $loop = $profiler->enter('\\loop', undef);
+
+$profiler->leave_at_end_of_level($loop, 2);
+
+for (1..100) {
+    my $again = $profiler->enter('\\loop', undef);
+
+    ## The old body is discarded before the new one is started.
+
+    $profiler->end_level(2);
+
+    $profiler->leave_at_end_of_level($again, 2);
+}
+
+is($profiler->num_frames(), 2, "tail calls don't make the stack deeper");
+
+$profiler->end_level(2);
+
+$profiler->leave($outer);
+
+my %collapsed = $profiler->get_collapseds();
+
+is_deeply([ sort keys %collapsed ], [ '\\outer', '\\outer;\\loop' ],
+          "tail calls don't make the call stacks longer");
+
+is($profiler->get_stat('\\loop')->{calls}, 101, "every call is counted");
+
+## A frame that has already been closed is left alone.
+
+$profiler = TeX::Interpreter::Profiler->new();
+
+my $command_frame = $profiler->enter('\\command', undef);
+
+$macro = $profiler->enter('\\macro', undef);
+
+$profiler->leave_at_end_of_level($macro, 1);
+
+$profiler->leave($command_frame);
+
+$profiler->end_level(1);
+
+$profiler->leave($macro);
+
+is($profiler->num_frames(), 0, "closing a closed frame is harmless");
+
+done_testing();
+
+__END__
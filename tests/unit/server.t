@@ -0,0 +1,130 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Runs jobs through a TeXML::Server and checks what the client sees.
+## Run with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeXML::Server;
+
+my $tmp = tempdir(CLEANUP => 1);
+
+my $socket = "$tmp/texml.sock";
+
+my %JOBS = (
+    lines => sub {
+        print "one\ntwo\n";
+
+        return 0;
+    },
+    partial => sub {
+        print "one\ntwo";
+
+        return 3;
+    },
+    killed => sub {
+        print "half a li";
+
+        kill KILL => $$;
+    },
+);
+
+my $pid = fork() // die "fork failed: $!\n";
+
+if ($pid == 0) {
+    open(STDERR, ">", "/dev/null");
+
+    my $handler = sub { $JOBS{ $_[0] }->() };
+
+    TeXML::Server->new({ socket_path => $socket,
+                         handler     => $handler })->serve();
+
+    exit 0;
+}
+
+for (1..50) {
+    last if -S $socket;
+
+    select(undef, undef, undef, 0.1);
+}
+
+sub run_job {
+    my $job = shift;
+
+    my $client = TeXML::Server->new({ socket_path => $socket });
+
+    open(my $saved, ">&", \*STDOUT) or die "Can't dup STDOUT: $!\n";
+
+    my $output = "$tmp/$job.out";
+
+    open(STDOUT, ">", $output) or die "Can't write $output: $!\n";
+
+    my ($status, $record) = $client->submit($job);
+
+    open(STDOUT, ">&", $saved) or die "Can't restore STDOUT: $!\n";
+
+    open(my $fh, "<:raw", $output) or die "Can't read $output: $!\n";
+
+    local $/;
+
+    return ($status, $record, scalar <$fh>);
+}
+
+my ($status, $record, $output) = run_job("lines");
+
+is($status, 0, "status of a job that succeeds");
+is($output, "one\ntwo\n", "output of a job that succeeds");
+
+($status, $record, $output) = run_job("partial");
+
+is($status, 3, "status of a job whose output doesn't end with a newline");
+is($output, "one\ntwo", "output of a job whose output doesn't end with a newline");
+
+{
+    local $SIG{__WARN__} = sub {};
+
+    open(my $saved, ">&", \*STDERR);
+    open(STDERR, ">", "/dev/null");
+
+    ($status, $record, $output) = run_job("killed");
+
+    open(STDERR, ">&", $saved);
+}
+
+is($status, 128 + 9, "status of a job killed in the middle of a line");
+is($output, "half a li", "output of a job killed in the middle of a line");
+like($record->{error} // '', qr{signal 9}, "a killed job is reported as such");
+
+kill TERM => $pid;
+
+waitpid($pid, 0);
+
+done_testing();
+
+__END__
@@ -0,0 +1,91 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks how format snapshots are made and installed.  Run with
+## "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::FMT::Snapshot;
+use TeX::Interpreter;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+## Lazily installed control sequences
+
+my $relax = $tex->pack_meaning($tex->get_primitive('relax'));
+
+my $snapshot = TeX::FMT::Snapshot->new();
+
+$snapshot->add_csname($_, $relax) for qw(lazyA lazyB lazyC);
+
+$tex->install_snapshot($snapshot, 1);
+
+ok(defined $tex->get_csname('lazyA'), "looking a control sequence up installs it");
+
+my $csnames = $tex->get_csnames();
+
+ok(exists $csnames->{$_}, "get_csnames() sees $_") for qw(lazyA lazyB lazyC);
+
+## Errors while making a snapshot name the control sequence
+
+package Mock {
+    sub new { my $class = shift; return bless { @_ }, $class }
+
+    sub get_params { return $_[0] }
+    sub get_eqtb   { return $_[0] }
+    sub get_word   { return $_[0] }
+
+    sub get_eq_level { return 1 }
+    sub get_eq_type  { return 0 }
+    sub get_equiv    { return 0 }
+
+    sub interpret_cmd_chr { return ("no_such_primitive", undef) }
+}
+
+my @errors;
+
+{
+    no warnings 'redefine';
+
+    local *TeX::Interpreter::print_err = sub { push @errors, $_[1] };
+
+    my $record = $tex->extract_meaning(Mock->new(), 0, "brokenCS");
+
+    is($record, undef, "a primitive that can't be loaded isn't recorded");
+}
+
+ok((grep { m{'brokenCS'} } @errors), "the error names the control sequence");
+
+done_testing();
+
+__END__
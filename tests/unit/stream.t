@@ -0,0 +1,83 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Converts tests/stream.tex with TeX::Output::XML and with
+## TeX::Output::XML::Stream and checks that the results are the same.
+## This runs texml twice, so it takes a while.  Run with "prove
+## tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Copy;
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+my $texml = "$FindBin::RealBin/../../bin/texml";
+
+my $tmp = tempdir(CLEANUP => 1);
+
+copy("$FindBin::RealBin/../stream.tex", "$tmp/stream.tex")
+    or die "Can't copy stream.tex: $!\n";
+
+chdir($tmp) or die "Can't chdir to $tmp: $!\n";
+
+sub texml {
+    my @options = @_;
+
+    unlink "stream.xml";
+
+    system("$^X $texml -nosvg @options stream.tex > stream.stdout 2>&1");
+
+    is($?, 0, "texml @options succeeded");
+
+    open(my $fh, "<:raw", "stream.xml") or return "";
+
+    local $/;
+
+    return scalar <$fh>;
+}
+
+my $expected = texml();
+
+my $streamed = texml("-output_module", "TeX::Output::XML::Stream");
+
+isnt($expected, "", "there is some output");
+
+is($streamed, $expected, "the streamed output is the same");
+
+like($streamed, qr{<alt-title>[^<]*Section 5</alt-title>},
+     "alt-titles are made after xrefs are resolved");
+
+## Only the section with a \ref in its title has to stay in memory.
+
+open(my $log, "<", "stream.log") or die "Can't read stream.log: $!\n";
+
+my ($summary) = grep { m{^Streamed output:} } <$log>;
+
+like($summary, qr{\b4 of 5 subtrees}, "sections with xrefs and tags are spooled");
+
+done_testing();
+
+__END__
@@ -0,0 +1,52 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks the token counts that tests/bench/corpus.pl reports.  Run
+## with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use Test::More;
+
+use TeX::Token qw(:factories :catcodes :constants);
+
+my ($total, $distinct) = TeX::Token::get_token_counts();
+
+make_character_token("q", CATCODE_LETTER) for 1..3;
+
+my ($new_total, $new_distinct) = TeX::Token::get_token_counts();
+
+is($new_total - $total, 3, "every token asked for is counted");
+is($new_distinct - $distinct, 1, "cached tokens are only created once");
+
+make_csname_token("foo", UNIQUE_TOKEN) for 1..2;
+
+($total, $distinct) = TeX::Token::get_token_counts();
+
+is($total - $new_total, 2, "unique tokens are counted");
+is($distinct - $new_distinct, 2, "and created every time");
+
+done_testing();
+
+__END__
@@ -0,0 +1,137 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks TeX::Output::XML's id and rid lookups.  Run with "prove
+## tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Scalar::Util qw(refaddr);
+
+use Test::More;
+
+use TeX::Interpreter;
+use TeX::Output::XML;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+my $xml = TeX::Output::XML->new({ tex_engine => $tex });
+
+$xml->open_document();
+
+sub element {
+    my $name = shift;
+    my $atts = shift;
+
+    $xml->open_element($name, undef, $atts);
+
+    my $node = $xml->get_current_element()->get_node();
+
+    $xml->close_element($name);
+
+    return $node;
+}
+
+my $first  = element(sec => {});
+my $second = element(sec => { id => "dup" });
+
+ok($xml->get_element_by_id("dup")->isSameNode($second), "ids set by open_element()");
+
+$xml->set_element_attribute($first, id => "dup");
+
+my @found = $xml->get_elements_by_id("dup");
+
+is(scalar @found, 2, "collisions are counted");
+
+ok($found[0]->isSameNode($first) && $found[1]->isSameNode($second),
+   "in document order");
+
+ok($xml->get_element_by_id("dup")->isSameNode($first),
+   "the first one in the document wins");
+
+$first->unbindNode();
+
+ok($xml->get_element_by_id("dup")->isSameNode($second),
+   "elements that are gone don't count");
+
+$first->removeAttribute('id');
+
+## Ids set behind our back are found by searching the document, but
+## only once until it changes.
+
+my $hidden = $xml->get_dom()->createElement("fig");
+
+$hidden->setAttribute(id => "hidden");
+
+$xml->get_dom()->documentElement()->appendChild($hidden);
+
+is($xml->get_element_by_id("missing"), undef, "a miss");
+
+my $index = refaddr($xml->get_id_index());
+
+is($xml->get_element_by_id("missing"), undef, "another miss");
+
+is(refaddr($xml->get_id_index()), $index, "doesn't search the document again");
+
+ok($xml->get_element_by_id("hidden")->isSameNode($hidden),
+   "ids set with setAttribute() are found");
+
+element(p => {});
+
+is($xml->get_element_by_id("missing"), undef, "a miss after a change");
+
+isnt(refaddr($xml->get_id_index()), $index, "searches again");
+
+## Referrers
+
+my $later   = element(xref => { rid => "dup other" });
+my $earlier = $xml->get_dom()->createElement("xref");
+
+$xml->get_dom()->documentElement()->insertBefore($earlier, $second);
+
+$xml->set_element_attribute($earlier, rid => "dup");
+
+my @referrers = $xml->get_referrers("dup");
+
+is(scalar @referrers, 2, "rids set by open_element() and set_element_attribute()");
+
+ok($referrers[0]->isSameNode($earlier) && $referrers[1]->isSameNode($later),
+   "in document order");
+
+$earlier->setAttribute(rid => "other");
+
+@referrers = $xml->get_referrers("dup");
+
+ok(@referrers == 1 && $referrers[0]->isSameNode($later),
+   "elements whose rid has changed are left out");
+
+done_testing();
+
+__END__
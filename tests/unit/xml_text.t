@@ -0,0 +1,69 @@
+#!/usr/bin/env perl
+
+use v5.26.0;
+
+# Copyright (C) 2026 American Mathematical Society
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Affero General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# For more details see, https://github.com/AmerMathSoc/texml
+
+use warnings;
+
+## Checks that text buffered by TeX::Output::XML::append_text() ends
+## up where it belongs.  Run with "prove tests/unit".
+
+use FindBin;
+use lib "$FindBin::RealBin/../../lib/perl";
+
+use File::Temp qw(tempdir);
+
+use Test::More;
+
+use TeX::Interpreter;
+
+## Keep texput.log out of the way.
+
+chdir(tempdir(CLEANUP => 1));
+
+my $tex = TeX::Interpreter->new();
+
+$tex->convert_fragment("\\global\\catcode123=1 \\global\\catcode125=2\\relax");
+
+sub convert {
+    my $string = shift;
+
+    return $tex->convert_fragment($string)->toString();
+}
+
+is(convert("plain text"), "plain text", "text at the end of a fragment");
+
+is(convert("ab\\startXMLelement{i}cd\\endXMLelement{i}ef"), "ab<i>cd</i>ef",
+   "text around an element");
+
+is(convert("\\startXMLelement{i}ab\\setXMLattribute{x}{1}cd\\endXMLelement{i}"),
+   q{<i x="1">abcd</i>},
+   "text on both sides of an attribute");
+
+my ($i) = $tex->convert_fragment("\\startXMLelement{i}abc\\endXMLelement{i}")->childNodes();
+
+is(scalar(() = $i->childNodes()), 1, "a run of text is a single text node");
+
+is(convert("a\\startXMLelement{i}\\startXMLelement{b}b\\endXMLelement{b}c\\endXMLelement{i}d"),
+   "a<i><b>b</b>c</i>d",
+   "nested elements");
+
+done_testing();
+
+__END__